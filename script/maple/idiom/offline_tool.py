@@ -25,6 +25,7 @@ class MemoTool(offline_tool.OfflineTool):
         self.register_knob('debug_out', 'string', 'stdout', 'the output file for the debug messages')
         self.register_knob('sinfo_in', 'string', 'sinfo.db', 'the input static info database path', 'PATH')
         self.register_knob('sinfo_out', 'string', 'sinfo.db', 'the output static info database path', 'PATH')
+        self.register_knob('sinfo_indexed', 'bool', False, 'whether save the static info database in the indexed (memory mapped) format')
         self.register_knob('iroot_in', 'string', 'iroot.db', 'the input iroot database path', 'PATH')
         self.register_knob('iroot_out', 'string', 'iroot.db', 'the output iroot database path', 'PATH')
         self.register_knob('memo_in', 'string', 'memo.db', 'the input memoization database path', 'PATH')
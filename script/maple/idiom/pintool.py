@@ -26,6 +26,7 @@ class SinstAnalyzer(analyzer.Analyzer):
         analyzer.Analyzer.__init__(self, 'sinst_analyzer')
         self.register_knob('enable_sinst', 'bool', False, 'whether enable the shared inst analyzer')
         self.register_knob('unit_size', 'int', 4, 'the monitoring granularity in bytes', 'SIZE')
+        self.register_knob('sinst_batch', 'bool', False, 'whether process memory accesses in batches')
 
 class Observer(analyzer.Analyzer):
     def __init__(self):
@@ -78,9 +79,14 @@ class Profiler(pintool.Pintool):
         self.register_knob('ignore_lib', 'bool', False, 'whether ignore accesses from common libraries')
         self.register_knob('memo_failed', 'bool', True, 'whether memoize fail-to-expose iroots')
         self.register_knob('debug_out', 'string', 'stdout', 'the output file for the debug messages')
+        self.register_knob('debug_async', 'bool', False, 'whether write the debug messages to the debug output file asynchronously')
         self.register_knob('stat_out', 'string', 'stat.out', 'the statistics output file', 'PATH')
         self.register_knob('sinfo_in', 'string', 'sinfo.db', 'the input static info database path', 'PATH')
         self.register_knob('sinfo_out', 'string', 'sinfo.db', 'the output static info database path', 'PATH')
+        self.register_knob('sinfo_indexed', 'bool', False, 'whether save the static info database in the indexed (memory mapped) format')
+        self.register_knob('mem_batch_size', 'int', 1024, 'the number of memory accesses buffered per thread for the batch analyzers', 'SIZE')
+        self.register_knob('bbl_inst_count', 'bool', False, 'whether count insts at bbl entries only (memory hooks adjust the clock)')
+        self.register_knob('sinst_prune', 'bool', False, 'whether skip instrumenting the memory accesses of the known thread local insts')
         self.register_knob('iroot_in', 'string', 'iroot.db', 'the input iroot database path', 'PATH')
         self.register_knob('iroot_out', 'string', 'iroot.db', 'the output iroot database path', 'PATH')
         self.register_knob('memo_in', 'string', 'memo.db', 'the input memoization database path', 'PATH')
@@ -156,9 +162,14 @@ class Scheduler(pintool.Pintool):
         self.register_knob('yield_with_delay', 'bool', True, 'whether inject delays for async iroots')
         self.register_knob('test_history', 'string', 'test.histo', 'the test history file path', 'PATH')
         self.register_knob('debug_out', 'string', 'stdout', 'the output file for the debug messages')
+        self.register_knob('debug_async', 'bool', False, 'whether write the debug messages to the debug output file asynchronously')
         self.register_knob('stat_out', 'string', 'stat.out', 'the statistics output file', 'PATH')
         self.register_knob('sinfo_in', 'string', 'sinfo.db', 'the input static info database path', 'PATH')
         self.register_knob('sinfo_out', 'string', 'sinfo.db', 'the output static info database path', 'PATH')
+        self.register_knob('sinfo_indexed', 'bool', False, 'whether save the static info database in the indexed (memory mapped) format')
+        self.register_knob('mem_batch_size', 'int', 1024, 'the number of memory accesses buffered per thread for the batch analyzers', 'SIZE')
+        self.register_knob('bbl_inst_count', 'bool', False, 'whether count insts at bbl entries only (memory hooks adjust the clock)')
+        self.register_knob('sinst_prune', 'bool', False, 'whether skip instrumenting the memory accesses of the known thread local insts')
         self.register_knob('iroot_in', 'string', 'iroot.db', 'the input iroot database path', 'PATH')
         self.register_knob('iroot_out', 'string', 'iroot.db', 'the output iroot database path', 'PATH')
         self.register_knob('memo_in', 'string', 'memo.db', 'the input memoization database path', 'PATH')
@@ -202,6 +202,31 @@ def __command_djit(argv):
     testcase.run()
     testcase.log_stat()
 
+def __command_fasttrack(argv):
+    pin = pintool.Pin(config.pin_home())
+    profiler = race_pintool.PctProfiler()
+    profiler.knob_defaults['enable_fasttrack'] = True
+    # parse cmdline options
+    usage = 'usage: <script> fasttrack [options] --- program'
+    parser = optparse.OptionParser(usage)
+    register_race_cmdline_options(parser)
+    profiler.register_cmdline_options(parser)
+    (opt_argv, prog_argv) = separate_opt_prog(argv)
+    if len(prog_argv) == 0:
+        parser.print_help()
+        sys.exit(0)
+    (options, args) = parser.parse_args(opt_argv)
+    profiler.set_cmdline_options(options, args)
+    # run fasttrack race detector
+    test = testing.InteractiveTest(prog_argv)
+    test.set_prefix(get_prefix(pin, profiler))
+    testcase = race_testing.TestCase(test,
+                                     options.mode,
+                                     options.threshold,
+                                     profiler)
+    testcase.run()
+    testcase.log_stat()
+
 def valid_command_set():
     result = set()
     for name in dir(sys.modules[__name__]):
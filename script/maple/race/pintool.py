@@ -24,6 +24,12 @@ class Detector(analyzer.Analyzer):
     def __init__(self, name):
         analyzer.Analyzer.__init__(self, name)
         self.register_knob('unit_size', 'int', 4, 'the monitoring granularity in bytes', 'SIZE')
+        self.register_knob('num_stripes', 'int', 256, 'the number of lock stripes for the meta data', 'N')
+        self.register_knob('access_cache', 'bool', True, 'whether skip accesses already checked in the current epoch')
+        self.register_knob('sampling', 'bool', False, 'whether sample memory accesses adaptively per instruction')
+        self.register_knob('sample_burst', 'int', 10, 'the number of consecutive executions sampled in each burst', 'N')
+        self.register_knob('sample_decay', 'int', 10, 'the factor by which the period between bursts grows', 'N')
+        self.register_knob('sample_max_period', 'int', 10000, 'the maximum period between bursts (in executions)', 'N')
 
 class Djit(Detector):
     def __init__(self):
@@ -31,17 +37,32 @@ class Djit(Detector):
         self.register_knob('enable_djit', 'bool', False, 'whether enable the djit data race detector')
         self.register_knob('track_racy_inst', 'bool', False, 'whether track potential racy instructions')
 
+class FastTrack(Detector):
+    def __init__(self):
+        Detector.__init__(self, 'race_fasttrack')
+        self.register_knob('enable_fasttrack', 'bool', False, 'whether enable the fasttrack data race detector')
+        self.register_knob('track_racy_inst', 'bool', False, 'whether track potential racy instructions')
+
 class Profiler(pintool.Pintool):
     def __init__(self, name='race_profiler'):
         pintool.Pintool.__init__(self, name)
         self.register_knob('ignore_lib', 'bool', False, 'whether ignore accesses from common libraries')
         self.register_knob('debug_out', 'string', 'stdout', 'the output file for the debug messages')
+        self.register_knob('debug_async', 'bool', False, 'whether write the debug messages to the debug output file asynchronously')
         self.register_knob('stat_out', 'string', 'stat.out', 'the statistics output file', 'PATH')
         self.register_knob('sinfo_in', 'string', 'sinfo.db', 'the input static info database path', 'PATH')
         self.register_knob('sinfo_out', 'string', 'sinfo.db', 'the output static info database path', 'PATH')
+        self.register_knob('sinfo_indexed', 'bool', False, 'whether save the static info database in the indexed (memory mapped) format')
+        self.register_knob('mem_batch_size', 'int', 1024, 'the number of memory accesses buffered per thread for the batch analyzers', 'SIZE')
+        self.register_knob('bbl_inst_count', 'bool', False, 'whether count insts at bbl entries only (memory hooks adjust the clock)')
+        self.register_knob('sinst_prune', 'bool', False, 'whether skip instrumenting the memory accesses of the known thread local insts')
+        self.register_knob('sinst_in', 'string', 'sinst.db', 'the input shared inst database path', 'PATH')
+        self.register_knob('sinst_out', 'string', 'sinst.db', 'the output shared inst database path', 'PATH')
         self.register_knob('race_in', 'string', 'race.db', 'the input race database path', 'PATH')
         self.register_knob('race_out', 'string', 'race.db', 'the output race database path', 'PATH')
+        self.register_knob('max_races', 'int', 0, 'the maximum number of dynamic races recorded for each static race in an execution (0 means no limit)', 'N')
         self.add_analyzer(Djit())
+        self.add_analyzer(FastTrack())
     def so_path(self):
         return os.path.join(config.build_home(self.debug), 'race_profiler.so')
 
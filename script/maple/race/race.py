@@ -58,9 +58,16 @@ class StaticRace(object):
         return self.db.find_static_event(event_id)
     def num_events(self):
         return len(self.proto.event_id)
+    def count(self):
+        if not self.proto.HasField('count'):
+            return None
+        return self.proto.count
     def __str__(self):
         content = []
-        content.append('Static Race %-4d' % self.id())
+        if self.count() is None:
+            content.append('Static Race %-4d' % self.id())
+        else:
+            content.append('Static Race %-4d (%d dynamic)' % (self.id(), self.count()))
         for idx in range(self.num_events()):
             content.append('  %s' % str(self.event(idx)))
         return '\n'.join(content)
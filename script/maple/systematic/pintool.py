@@ -25,9 +25,16 @@ class Controller(pintool.Pintool):
         pintool.Pintool.__init__(self, 'chess_controller')
         self.schedulers = {}
         self.register_knob('debug_out', 'string', 'stdout', 'the output file for the debug messages')
+        self.register_knob('debug_async', 'bool', False, 'whether write the debug messages to the debug output file asynchronously')
         self.register_knob('stat_out', 'string', 'stat.out', 'the statistics output file', 'PATH')
         self.register_knob('sinfo_in', 'string', 'sinfo.db', 'the input static info database path', 'PATH')
         self.register_knob('sinfo_out', 'string', 'sinfo.db', 'the output static info database path', 'PATH')
+        self.register_knob('sinfo_indexed', 'bool', False, 'whether save the static info database in the indexed (memory mapped) format')
+        self.register_knob('mem_batch_size', 'int', 1024, 'the number of memory accesses buffered per thread for the batch analyzers', 'SIZE')
+        self.register_knob('bbl_inst_count', 'bool', False, 'whether count insts at bbl entries only (memory hooks adjust the clock)')
+        self.register_knob('sinst_prune', 'bool', False, 'whether skip instrumenting the memory accesses of the known thread local insts')
+        self.register_knob('sinst_in', 'string', 'sinst.db', 'the input shared inst database path', 'PATH')
+        self.register_knob('sinst_out', 'string', 'sinst.db', 'the output shared inst database path', 'PATH')
         self.register_knob('sched_app', 'bool', True, 'whether only schedule operations from the application')
         self.register_knob('sched_race', 'bool', False, 'whether schedule racy memory operations (for racy programs)')
         self.register_knob('cpu', 'int', 0, 'which cpu to run on', 'CPU_ID')
@@ -26,12 +26,23 @@
 
 // Forward declarations.
 class CallStackInfo;
+class AccessPredicate;
+
+// A buffered memory access (see Analyzer::MemAccessBatch).
+class MemAccess {
+ public:
+  Inst *inst;
+  address_t addr;
+  size_t size;
+  bool is_write;
+  timestamp_t thd_clk;
+};
 
 // An analyzer is used to profile program behaviors like an observer. It has no
 // control over the execution of the program.
 class Analyzer {
  public:
-  Analyzer() : callstack_info_(NULL) {
+  Analyzer() : callstack_info_(NULL), access_predicate_(NULL) {
     knob_ = Knob::Get();
   }
 
@@ -68,12 +79,17 @@ class Analyzer {
                               Inst *inst, address_t addr, size_t size) {}
   virtual void AfterMemWrite(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
                              Inst *inst, address_t addr, size_t size) {}
+  // memory accesses of a thread delivered in batches, in program order.
+  // a batch is always delivered before the next synchronization or
+  // system call event of the thread.
+  virtual void MemAccessBatch(thread_id_t curr_thd_id, MemAccess *accesses,
+                              size_t num_accesses) {}
   virtual void BeforeAtomicInst(thread_id_t curr_thd_id,
                                 timestamp_t curr_thd_clk, Inst *inst,
-                                std::string type, address_t addr) {}
+                                opcode_type opcode, address_t addr) {}
   virtual void AfterAtomicInst(thread_id_t curr_thd_id,
                                timestamp_t curr_thd_clk, Inst *inst,
-                               std::string type, address_t addr) {}
+                               opcode_type opcode, address_t addr) {}
   virtual void BeforeCall(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
                           Inst *inst, address_t target) {}
   virtual void AfterCall(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
@@ -176,11 +192,13 @@ class Analyzer {
 
   Descriptor *desc() { return &desc_; }
   void set_callstack_info(CallStackInfo *info) { callstack_info_ = info; }
+  void set_access_predicate(AccessPredicate *pred) { access_predicate_ = pred; }
 
  protected:
   Descriptor desc_;
   Knob *knob_;
   CallStackInfo *callstack_info_;
+  AccessPredicate *access_predicate_; // NULL if not used
 
  private:
   DISALLOW_COPY_CONSTRUCTORS(Analyzer);
@@ -51,6 +51,10 @@ typedef uint64 thread_id_t;
 #define UNIT_UP_ALIGN(addr,unit_size) \
     (((addr)+(unit_size)-1) & UNIT_MASK(unit_size))
 
+// Used to avoid false sharing between threads
+#define CACHE_LINE_SIZE 64
+#define CACHE_LINE_ALIGNED __attribute__((aligned(CACHE_LINE_SIZE)))
+
 // Used to calculate timestamp distances
 #define TIME_DISTANCE(start,end) \
     ((end)>=(start) ? (end)-(start) : (((timestamp_t)0)-((start)-(end))))
@@ -18,81 +18,150 @@
 
 #include "core/callstack.h"
 
+#include <cstring>
+
+#include "core/atomic.h"
 #include "core/logging.h"
+#include "core/thread_index.h"
 
-void CallStack::OnCall(Inst *inst, address_t ret) {
-  inst_vec_.push_back(inst);
-  target_vec_.push_back(ret);
+#define INVALID_STACK_ID static_cast<CallStack::stack_id_t>(-1)
 
-  // We want the signature to be unique across runs. Therefore, we should not
-  // use the pointer value. Instead, we should use the inst id.
-  signature_ += (signature_t)inst->id();
+CallStack::CallStack(CallStackInfo *info)
+    : info_(info),
+      signature_(0) {
+  memset(target_filter_, 0, sizeof(target_filter_));
+}
+
+CallStack::stack_id_t CallStack::id() {
+  if (frame_vec_.empty())
+    return 0;
+
+  Frame &top = frame_vec_.back();
+  if (top.id == INVALID_STACK_ID)
+    top.id = info_->Intern(top.signature);
+  return top.id;
+}
+
+void CallStack::OnCall(Inst *inst, address_t ret) {
+  Frame frame;
+  frame.inst = inst;
+  frame.target = ret;
+  frame.signature = Hash(signature_, inst);
+  frame.id = INVALID_STACK_ID;
+  frame_vec_.push_back(frame);
+  target_filter_[FilterSlot(ret)]++;
+  signature_ = frame.signature;
 
   DEBUG_FMT_PRINT_SAFE("(%s)\n", ToString().c_str());
 }
 
 void CallStack::OnReturn(Inst *inst, address_t target) {
-  DEBUG_ASSERT(inst_vec_.size() == target_vec_.size());
-
   // Handle the empty stack case.
-  assert(!inst_vec_.empty());
+  assert(!frame_vec_.empty());
+
+  // Most returns go back to the caller on the top of the stack.
+  if (frame_vec_.back().target == target) {
+    Pop(frame_vec_.size() - 1);
+    DEBUG_FMT_PRINT_SAFE("(%s)\n", ToString().c_str());
+    return;
+  }
+
+  // If the target address is not in the stack, ignore this return. (This is
+  // caused by PIN's non-transparent wrapper implementation. The return address
+  // could be the address in the stub created by PIN.)
+  if (!target_filter_[FilterSlot(target)])
+    return;
 
   // Backward search matching target address, find the first one that matches
-  // and remove the entires after it. If the target address is not found in the
-  // stack, ignore this return. (This is caused by PIN's non-transparent wrapper
-  // implementation. The return address could be the address in the stub created
-  // by PIN.)
-  bool found = false;
-  int size = (int)inst_vec_.size();
-  int new_size = size; // The new stack size after return;
-  signature_t new_signature = signature_; // The new signature after return;
-
-  for (int idx = size - 1; idx >= 0; idx--) {
-    Inst *inst = inst_vec_[idx];
-    address_t addr = target_vec_[idx];
-
-    new_size -= 1;
-    new_signature -= inst->id();
-
-    if (addr == target) {
-      found = true;
+  // and remove the entires after it. The frames searched are removed, so the
+  // cost is paid by the calls that pushed them (except for the false positives
+  // of the filter, which are rare).
+  for (size_t idx = frame_vec_.size(); idx > 0; idx--) {
+    if (frame_vec_[idx - 1].target == target) {
+      Pop(idx - 1);
       break;
     }
   }
 
-  if (found) {
-    inst_vec_.erase(inst_vec_.begin() + new_size, inst_vec_.end());
-    target_vec_.erase(target_vec_.begin() + new_size, target_vec_.end());
-    signature_ = new_signature;
-  }
-
   DEBUG_FMT_PRINT_SAFE("(%s)\n", ToString().c_str());
 }
 
 std::string CallStack::ToString() {
   std::stringstream ss;
   ss << std::hex;
-  size_t size = inst_vec_.size();
+  size_t size = frame_vec_.size();
   for (size_t i = 0; i < size; i++) {
-    ss << "<" << inst_vec_[i]->id() << " ";
-    ss << "0x" << target_vec_[i] << ">";
+    ss << "<" << frame_vec_[i].inst->id() << " ";
+    ss << "0x" << frame_vec_[i].target << ">";
     if (i != size - 1)
       ss << " ";
   }
   return ss.str();
 }
 
+CallStack::signature_t CallStack::Hash(signature_t signature, Inst *inst) {
+  // We want the signature to be unique across runs. Therefore, we should not
+  // use the pointer value. Instead, we should use the inst id. The mixing
+  // function is the 64-bit finalizer of MurmurHash3, so that the signature
+  // depends on the order of the calls and rarely collides.
+  uint64 h = signature ^ ((uint64)inst->id() * 0x9e3779b97f4a7c15ULL);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+void CallStack::Pop(size_t new_size) {
+  for (size_t idx = new_size; idx < frame_vec_.size(); idx++)
+    target_filter_[FilterSlot(frame_vec_[idx].target)]--;
+  frame_vec_.resize(new_size);
+  signature_ = new_size ? frame_vec_[new_size - 1].signature : 0;
+}
+
+CallStackInfo::CallStackInfo(Mutex *lock)
+    : internal_lock_(lock),
+      stack_table_(NULL) {
+  stack_table_ = new ThreadIndexTable<CallStack *>;
+  signature_vec_.push_back(0); // the empty stack
+  stack_id_map_[0] = 0;
+}
+
 CallStack *CallStackInfo::GetCallStack(thread_id_t thd_id) {
+  CallStack **slot = stack_table_->Get(ThreadIndex::Get(thd_id));
+  CallStack *callstack = *slot;
+  if (callstack)
+    return callstack;
+
+  // First access of the thread, publish a new call stack.
   ScopedLock locker(internal_lock_);
+  if (!*slot) {
+    callstack = new CallStack(this);
+    MEMORY_BARRIER();
+    *slot = callstack;
+  }
+  return *slot;
+}
 
-  StackMap::iterator it = stack_map_.find(thd_id);
-  if (it == stack_map_.end()) {
-    CallStack *callstack = new CallStack;
-    stack_map_[thd_id] = callstack;
-    return callstack;
-  } else {
+CallStack::stack_id_t CallStackInfo::Intern(CallStack::signature_t signature) {
+  ScopedLock locker(internal_lock_);
+
+  StackIdMap::iterator it = stack_id_map_.find(signature);
+  if (it != stack_id_map_.end())
     return it->second;
-  }
+
+  CallStack::stack_id_t id = (CallStack::stack_id_t)signature_vec_.size();
+  signature_vec_.push_back(signature);
+  stack_id_map_[signature] = id;
+  return id;
+}
+
+CallStack::signature_t CallStackInfo::Signature(CallStack::stack_id_t id) {
+  ScopedLock locker(internal_lock_);
+
+  DEBUG_ASSERT(id < signature_vec_.size());
+  return signature_vec_[id];
 }
 
 CallStackTracker::CallStackTracker(CallStackInfo *callstack_info) {
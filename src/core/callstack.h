@@ -20,33 +20,60 @@
 #define CORE_CALLSTACK_H_
 
 #include <vector>
-#include <map>
+#include <tr1/unordered_map>
 
 #include "core/basictypes.h"
 #include "core/sync.h"
 #include "core/analyzer.h"
+#include "core/thread_index.h"
+
+// The number of slots in the filter of the return targets on a stack.
+#define CALLSTACK_FILTER_SIZE 256
+
+class CallStackInfo;
 
 // This class represents a runtime call stack of a thread.
 class CallStack {
  public:
   // Define the type for call stack signatures.
   typedef uint64 signature_t;
+  // Define the type for interned call stack ids (see CallStackInfo).
+  typedef uint32 stack_id_t;
 
-  CallStack() : signature_(0) {}
+  explicit CallStack(CallStackInfo *info);
   ~CallStack() {}
 
   signature_t signature() { return signature_; }
+  stack_id_t id();
   void OnCall(Inst *inst, address_t ret);
   void OnReturn(Inst *inst, address_t target);
   std::string ToString();
 
  protected:
-  typedef std::vector<Inst *> InstVec;
-  typedef std::vector<address_t> TargetVec;
-
+  // A frame on the stack. The signature and the id are the ones of the
+  // stack from the bottom up to (and including) this frame.
+  class Frame {
+   public:
+    Inst *inst;
+    address_t target;
+    signature_t signature;
+    stack_id_t id; // lazily interned
+  };
+
+  typedef std::vector<Frame> FrameVec;
+
+  static signature_t Hash(signature_t signature, Inst *inst);
+  static size_t FilterSlot(address_t target) {
+    return (target ^ (target >> 8)) & (CALLSTACK_FILTER_SIZE - 1);
+  }
+  void Pop(size_t new_size);
+
+  CallStackInfo *info_;
   signature_t signature_; // The current call stack signature.
-  InstVec inst_vec_;
-  TargetVec target_vec_;
+  FrameVec frame_vec_;
+  // The number of frames whose return targets fall into each slot. A
+  // zero count means no frame on the stack returns to the target.
+  uint32 target_filter_[CALLSTACK_FILTER_SIZE];
 
  private:
   DISALLOW_COPY_CONSTRUCTORS(CallStack);
@@ -56,17 +83,27 @@ class CallStack {
 // class will be used by all analyzers to get call stack information.
 class CallStackInfo {
  public:
-  explicit CallStackInfo(Mutex *lock) : internal_lock_(lock) {}
+  explicit CallStackInfo(Mutex *lock);
   ~CallStackInfo() {}
 
-  // Return the call stack by its thread id.
+  // Return the call stack by its thread id. The call stack of a thread is
+  // only updated by the thread itself, so no lock is needed to access it.
   CallStack *GetCallStack(thread_id_t thd_id);
+  // Return the compact id of the stack with the given signature. Each
+  // distinct signature gets a new id (0 is the empty stack).
+  CallStack::stack_id_t Intern(CallStack::signature_t signature);
+  // Return the signature of an interned stack.
+  CallStack::signature_t Signature(CallStack::stack_id_t id);
 
  protected:
-  typedef std::map<thread_id_t, CallStack *> StackMap;
+  typedef std::tr1::unordered_map<CallStack::signature_t,
+                                  CallStack::stack_id_t> StackIdMap;
+  typedef std::vector<CallStack::signature_t> SignatureVec;
 
   Mutex *internal_lock_;
-  StackMap stack_map_;
+  ThreadIndexTable<CallStack *> *stack_table_;
+  StackIdMap stack_id_map_;
+  SignatureVec signature_vec_; // indexed by the stack id
 
  private:
   DISALLOW_COPY_CONSTRUCTORS(CallStackInfo);
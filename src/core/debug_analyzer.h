@@ -146,17 +146,17 @@ class DebugAnalyzer : public Analyzer {
   }
 
   void BeforeAtomicInst(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
-                        Inst *inst, std::string type, address_t addr) {
+                        Inst *inst, opcode_type opcode, address_t addr) {
     INFO_FMT_PRINT_SAFE(
         "[T%" PRIx64 "] Before Atomic Inst, inst='%s', type='%s', addr=0x%lx\n",
-        curr_thd_id, inst->ToString().c_str(), type.c_str(), addr);
+        curr_thd_id, inst->ToString().c_str(), OpcodeName(opcode), addr);
   }
 
   void AfterAtomicInst(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
-                       Inst *inst, std::string type, address_t addr) {
+                       Inst *inst, opcode_type opcode, address_t addr) {
     INFO_FMT_PRINT_SAFE(
         "[T%" PRIx64 "] After Atomic Inst, inst='%s', type='%s', addr=0x%lx\n",
-        curr_thd_id, inst->ToString().c_str(), type.c_str(), addr);
+        curr_thd_id, inst->ToString().c_str(), OpcodeName(opcode), addr);
   }
 
   void BeforeCall(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
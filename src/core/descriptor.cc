@@ -22,6 +22,7 @@
 Descriptor::Descriptor()
     : hook_before_mem_(false),
       hook_after_mem_(false),
+      hook_mem_batch_(false),
       hook_atomic_inst_(false),
       hook_pthread_func_(false),
       hook_yield_func_(false),
@@ -32,13 +33,15 @@ Descriptor::Descriptor()
       hook_signal_(false),
       track_inst_count_(false),
       track_call_stack_(false),
-      skip_stack_access_(true) {
+      skip_stack_access_(true),
+      publish_mem_region_(false) {
   // empty
 }
 
 void Descriptor::Merge(Descriptor *desc) {
   hook_before_mem_ = hook_before_mem_ || desc->hook_before_mem_;
   hook_after_mem_ = hook_after_mem_ || desc->hook_after_mem_;
+  hook_mem_batch_ = hook_mem_batch_ || desc->hook_mem_batch_;
   hook_atomic_inst_ = hook_atomic_inst_ || desc->hook_atomic_inst_;
   hook_pthread_func_ = hook_pthread_func_ || desc->hook_pthread_func_;
   hook_yield_func_ = hook_yield_func_ || desc->hook_yield_func_;
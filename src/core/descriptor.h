@@ -29,9 +29,12 @@ class Descriptor {
   ~Descriptor() {}
 
   void Merge(Descriptor *desc);
-  bool HookMem() { return hook_before_mem_ || hook_after_mem_; }
+  bool HookMem() {
+    return hook_before_mem_ || hook_after_mem_ || hook_mem_batch_;
+  }
   bool HookBeforeMem() { return hook_before_mem_; }
   bool HookAfterMem() { return hook_after_mem_; }
+  bool HookMemBatch() { return hook_mem_batch_; }
   bool HookAtomicInst() { return hook_atomic_inst_; }
   bool HookPthreadFunc() { return hook_pthread_func_; }
   bool HookYieldFunc() { return hook_yield_func_; }
@@ -43,9 +46,11 @@ class Descriptor {
   bool TrackInstCount() { return track_inst_count_; }
   bool TrackCallStack() { return track_call_stack_; }
   bool SkipStackAccess() { return skip_stack_access_; }
+  bool PublishMemRegion() { return publish_mem_region_; }
 
   void SetHookBeforeMem() { hook_before_mem_ = true; }
   void SetHookAfterMem() { hook_after_mem_ = true; }
+  void SetHookMemBatch() { hook_mem_batch_ = true; }
   void SetHookPthreadFunc() { hook_pthread_func_ = true; }
   void SetHookYieldFunc() { hook_yield_func_ = true; }
   void SetHookMallocFunc() { hook_malloc_func_ = true; }
@@ -57,10 +62,14 @@ class Descriptor {
   void SetTrackInstCount() { track_inst_count_ = true; }
   void SetTrackCallStack() { track_call_stack_ = true; }
   void SetNoSkipStackAccess() { skip_stack_access_ = false; }
+  // the analyzer publishes the regions it monitors to the access
+  // predicate, and ignores the memory accesses outside them.
+  void SetPublishMemRegion() { publish_mem_region_ = true; }
 
  protected:
   bool hook_before_mem_;
   bool hook_after_mem_;
+  bool hook_mem_batch_;
   bool hook_atomic_inst_;
   bool hook_pthread_func_;
   bool hook_yield_func_;
@@ -72,6 +81,7 @@ class Descriptor {
   bool track_inst_count_;
   bool track_call_stack_;
   bool skip_stack_access_;
+  bool publish_mem_region_;
 
  private:
   DISALLOW_COPY_CONSTRUCTORS(Descriptor);
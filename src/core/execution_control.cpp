@@ -19,9 +19,13 @@
 #include "core/execution_control.hpp"
 
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 
+#include "core/atomic.h"
 #include "core/logging.h"
 #include "core/stat.h"
+#include "core/thread_index.h"
 #include "core/debug_analyzer.h"
 
 ExecutionControl *ExecutionControl::ctrl_ = NULL;
@@ -30,10 +34,25 @@ ExecutionControl::ExecutionControl()
     : kernel_lock_(NULL),
       knob_(NULL),
       debug_file_(NULL),
+      async_debug_file_(NULL),
+      log_drainer_stop_(false),
+      log_drainer_uid_(INVALID_PIN_THREAD_UID),
       sinfo_(NULL),
+      pseudo_image_(NULL),
+      last_image_(NULL),
+      last_low_addr_(0),
+      last_high_addr_(0),
       callstack_info_(NULL),
+      access_predicate_(NULL),
       debug_analyzer_(NULL),
       main_thread_started_(false),
+      thd_ctx_(NULL),
+      mem_batch_size_(0),
+      bbl_inst_count_(false),
+      prune_db_(NULL),
+      prune_owner_(NULL),
+      prune_key_(NULL),
+      trace_group_lock_(NULL),
       main_thd_id_(INVALID_THD_ID) {
   // Empty.
 }
@@ -43,15 +62,24 @@ void ExecutionControl::Initialize() {
   stat_init(CreateMutex());
   Knob::Initialize(new PinKnob);
   kernel_lock_ = CreateMutex();
+  trace_group_lock_ = CreateMutex();
   knob_ = Knob::Get();
   ctrl_ = this;
+  thd_ctx_ = (ThreadContext *)AllocThreadContexts(sizeof(ThreadContext));
 }
 
 void ExecutionControl::PreSetup() {
   knob_->RegisterStr("debug_out", "the output file for the debug messages", "stdout");
+  knob_->RegisterBool("debug_async", "whether write the debug messages to the debug output file asynchronously", "0");
   knob_->RegisterStr("stat_out", "the statistics output file", "stat.out");
   knob_->RegisterStr("sinfo_in", "the input static info database path", "sinfo.db");
   knob_->RegisterStr("sinfo_out", "the output static info database path", "sinfo.db");
+  knob_->RegisterBool("sinfo_indexed", "whether save the static info database in the indexed (memory mapped) format", "0");
+  knob_->RegisterInt("mem_batch_size", "the number of memory accesses buffered per thread for the batch analyzers", "1024");
+  knob_->RegisterBool("bbl_inst_count", "whether count insts at bbl entries only (memory hooks adjust the clock)", "0");
+  knob_->RegisterBool("sinst_prune", "whether skip instrumenting the memory accesses of the known thread local insts", "0");
+  knob_->RegisterStr("sinst_in", "the input shared inst database path", "sinst.db");
+  knob_->RegisterStr("sinst_out", "the output shared inst database path", "sinst.db");
 
   debug_analyzer_ = new DebugAnalyzer;
   debug_analyzer_->Register();
@@ -67,6 +95,22 @@ void ExecutionControl::PostSetup() {
   } else if (knob_->ValueStr("debug_out").compare("stdout") == 0) {
     debug_log->ResetLogFile();
     debug_log->RegisterLogFile(stdout_log_file);
+  } else if (knob_->ValueBool("debug_async")) {
+    // the messages are buffered in lock free rings and drained to the
+    // file by an internal thread
+    AsyncFileLogFile::SetThreadIdFunc(__LogThreadId);
+    async_debug_file_ = new AsyncFileLogFile(knob_->ValueStr("debug_out"),
+                                             CreateMutex());
+    debug_file_ = async_debug_file_;
+    debug_file_->Open();
+    debug_log->ResetLogFile();
+    debug_log->RegisterLogFile(debug_file_);
+    THREADID tid = PIN_SpawnInternalThread(__LogDrainer, NULL, 0,
+                                           &log_drainer_uid_);
+    if (tid == INVALID_THREADID)
+      Abort("fail to create the log drainer thread\n");
+    // the internal thread should be stopped before the fini functions
+    PIN_AddPrepareForFiniFunction(__StopLogDrainer, NULL);
   } else {
     debug_file_ = new FileLogFile(knob_->ValueStr("debug_out"));
     debug_file_->Open();
@@ -74,11 +118,33 @@ void ExecutionControl::PostSetup() {
     debug_log->RegisterLogFile(debug_file_);
   }
 
+  mem_batch_size_ = knob_->ValueInt("mem_batch_size");
+  bbl_inst_count_ = knob_->ValueBool("bbl_inst_count");
+  if (mem_batch_size_ < 1)
+    mem_batch_size_ = 1;
+
   // Load static info.
   sinfo_ = new StaticInfo(CreateMutex());
   sinfo_->Load(knob_->ValueStr("sinfo_in"));
-  if (!sinfo_->FindImage(PSEUDO_IMAGE_NAME))
-    sinfo_->CreateImage(PSEUDO_IMAGE_NAME);
+  if (knob_->ValueBool("sinfo_indexed"))
+    sinfo_->set_indexed(true);
+  pseudo_image_ = sinfo_->FindImage(PSEUDO_IMAGE_NAME);
+  if (!pseudo_image_)
+    pseudo_image_ = sinfo_->CreateImage(PSEUDO_IMAGE_NAME);
+
+  // Load shared inst database if pruning the thread local insts. Only
+  // the insts that the database has profiled can be pruned, others are
+  // unknown and are always instrumented.
+  if (knob_->ValueBool("sinst_prune")) {
+    prune_db_ = CreateInstSharingDB();
+    if (!prune_db_)
+      Abort("sinst_prune is not supported by this tool\n");
+    prune_db_->Load(knob_->ValueStr("sinst_in"), sinfo_);
+    prune_owner_ = new uint32[PRUNE_OWNER_TABLE_SIZE];
+    memset(prune_owner_, 0, sizeof(uint32) * PRUNE_OWNER_TABLE_SIZE);
+    prune_key_ = new uint32[PIN_MAX_THREADS];
+    memset(prune_key_, 0, sizeof(uint32) * PIN_MAX_THREADS);
+  }
 
   // Add debug analyzer if necessary.
   if (debug_analyzer_->Enabled()) {
@@ -103,6 +169,10 @@ void ExecutionControl::PostSetup() {
       = new CallStackTracker(callstack_info_);
     AddAnalyzer(callstack_tracker);
   }
+
+  // All the analyzers have been added, build the dispatch tables.
+  BuildHookTables();
+  SetupAccessPredicate();
 }
 
 void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
@@ -113,14 +183,29 @@ void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
     return;
   }
 
+  // Get the corresponding img of this trace.
+  IMG img = GetImgByTrace(trace);
+
   for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
-    // Get the corresponding img of this trace.
-    IMG img = GetImgByTrace(trace);
+    // Whether the thread clock is ahead of the insts in this bbl. If so,
+    // each hook gets the number of insts following the hooked inst in the
+    // bbl (clk_adj), and subtracts it to see the exact clock. The number
+    // is counted down while walking the insts of the bbl.
+    bool bbl_clk_ahead = false;
 
     // Instrumentation to track the inst count.
     if (desc_.TrackInstCount()) {
       if (!HandleIgnoreInstCount(img)) {
-        if (desc_.HookMem() && BBLContainMemOp(bbl)) {
+        if (desc_.HookMem() && BBLContainMemOp(bbl) && bbl_inst_count_) {
+          // Count the whole bbl at entry, memory hooks adjust the clock.
+          BBL_InsertCall(bbl, IPOINT_BEFORE,
+                         (AFUNPTR)__InstCount2,
+                         IARG_FAST_ANALYSIS_CALL,
+                         IARG_THREAD_ID,
+                         IARG_UINT32, BBL_NumIns(bbl),
+                         IARG_END);
+          bbl_clk_ahead = true;
+        } else if (desc_.HookMem() && BBLContainMemOp(bbl)) {
           // Also instrument memory accesses, so need more accurate ticker.
           for (INS ins = BBL_InsHead(bbl); INS_Valid(ins);ins = INS_Next(ins)) {
             INS_InsertCall(ins, IPOINT_BEFORE,
@@ -143,12 +228,15 @@ void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
 
     // Instrumentation to track atomic inst.
     if (desc_.HookAtomicInst()) {
-      for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+      UINT32 ins_after = BBL_NumIns(bbl) - 1;
+      for (INS ins = BBL_InsHead(bbl); INS_Valid(ins);
+           ins = INS_Next(ins), ins_after--) {
         if (!INS_IsAtomicUpdate(ins))
           continue;
 
         Inst *inst = GetInst(INS_Address(ins));
         UpdateInstOpcode(inst, ins);
+        UINT32 clk_adj = bbl_clk_ahead ? ins_after : 0;
 
         INS_InsertCall(ins, IPOINT_BEFORE,
                        (AFUNPTR)__BeforeAtomicInst,
@@ -156,6 +244,7 @@ void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
                        IARG_PTR, inst,
                        IARG_UINT32, INS_Opcode(ins),
                        IARG_MEMORYREAD_EA,
+                       IARG_UINT32, clk_adj,
                        IARG_END);
 
         if (INS_HasFallThrough(ins)) {
@@ -164,6 +253,7 @@ void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
                          IARG_THREAD_ID,
                          IARG_PTR, inst,
                          IARG_UINT32, INS_Opcode(ins),
+                         IARG_UINT32, clk_adj,
                          IARG_END);
         }
 
@@ -173,6 +263,7 @@ void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
                          IARG_THREAD_ID,
                          IARG_PTR, inst,
                          IARG_UINT32, INS_Opcode(ins),
+                         IARG_UINT32, clk_adj,
                          IARG_END);
         }
       }
@@ -184,7 +275,9 @@ void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
 
     // Instrumentation to track mem accesses.
     if (desc_.HookMem()) {
-      for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+      UINT32 ins_after = BBL_NumIns(bbl) - 1;
+      for (INS ins = BBL_InsHead(bbl); INS_Valid(ins);
+           ins = INS_Next(ins), ins_after--) {
         // Only track memory access instructions.
         if (INS_IsMemoryRead(ins) || INS_IsMemoryWrite(ins)) {
           // Skip stack access if necessary.
@@ -197,36 +290,74 @@ void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
           Inst *inst = GetInst(INS_Address(ins));
           UpdateInstOpcode(inst, ins);
 
+          UINT32 clk_adj = bbl_clk_ahead ? ins_after : 0;
+
+          // Known thread local inst, only verify that the pages it
+          // accesses are not touched by other threads.
+          if (Prunable(inst)) {
+            if (INS_IsMemoryRead(ins))
+              InsertPrunedCheck(ins, inst, IARG_MEMORYREAD_EA,
+                                IARG_MEMORYREAD_SIZE, false, clk_adj);
+            if (INS_IsMemoryWrite(ins))
+              InsertPrunedCheck(ins, inst, IARG_MEMORYWRITE_EA,
+                                IARG_MEMORYWRITE_SIZE, true, clk_adj);
+            if (INS_HasMemoryRead2(ins))
+              InsertPrunedCheck(ins, inst, IARG_MEMORYREAD2_EA,
+                                IARG_MEMORYREAD_SIZE, false, clk_adj);
+            continue;
+          }
+
+          // Record the owners of the pages accessed by the instrumented
+          // insts as well, so that the pruned insts notice the pages
+          // they share with the instrumented ones.
+          if (prune_db_) {
+            if (INS_IsMemoryRead(ins))
+              InsertOwnerCheck(ins, IARG_MEMORYREAD_EA);
+            if (INS_IsMemoryWrite(ins))
+              InsertOwnerCheck(ins, IARG_MEMORYWRITE_EA);
+            if (INS_HasMemoryRead2(ins))
+              InsertOwnerCheck(ins, IARG_MEMORYREAD2_EA);
+          }
+
           // Instrument before mem accesses.
           if (desc_.HookBeforeMem()) {
             if (INS_IsMemoryRead(ins)) {
-              INS_InsertCall(ins, IPOINT_BEFORE,
-                             (AFUNPTR)__BeforeMemRead,
-                             IARG_THREAD_ID,
-                             IARG_PTR, inst,
-                             IARG_MEMORYREAD_EA,
-                             IARG_MEMORYREAD_SIZE,
-                             IARG_END);
+              InsertBeforeMemCall(ins, inst, (AFUNPTR)__BeforeMemRead,
+                                  IARG_MEMORYREAD_EA, IARG_MEMORYREAD_SIZE,
+                                  clk_adj);
             }
 
             if (INS_IsMemoryWrite(ins)) {
-              INS_InsertCall(ins, IPOINT_BEFORE,
-                             (AFUNPTR)__BeforeMemWrite,
-                             IARG_THREAD_ID,
-                             IARG_PTR, inst,
-                             IARG_MEMORYWRITE_EA,
-                             IARG_MEMORYWRITE_SIZE,
-                             IARG_END);
+              InsertBeforeMemCall(ins, inst, (AFUNPTR)__BeforeMemWrite,
+                                  IARG_MEMORYWRITE_EA, IARG_MEMORYWRITE_SIZE,
+                                  clk_adj);
             }
 
             if (INS_HasMemoryRead2(ins)) {
-              INS_InsertCall(ins, IPOINT_BEFORE,
-                             (AFUNPTR)__BeforeMemRead2,
-                             IARG_THREAD_ID,
-                             IARG_PTR, inst,
-                             IARG_MEMORYREAD2_EA,
-                             IARG_MEMORYREAD_SIZE,
-                             IARG_END);
+              InsertBeforeMemCall(ins, inst, (AFUNPTR)__BeforeMemRead2,
+                                  IARG_MEMORYREAD2_EA, IARG_MEMORYREAD_SIZE,
+                                  clk_adj);
+            }
+          }
+
+          // Buffer mem accesses for the batch analyzers.
+          if (desc_.HookMemBatch()) {
+            if (INS_IsMemoryRead(ins)) {
+              InsertBeforeMemCall(ins, inst, (AFUNPTR)__BufferMemRead,
+                                  IARG_MEMORYREAD_EA, IARG_MEMORYREAD_SIZE,
+                                  clk_adj);
+            }
+
+            if (INS_IsMemoryWrite(ins)) {
+              InsertBeforeMemCall(ins, inst, (AFUNPTR)__BufferMemWrite,
+                                  IARG_MEMORYWRITE_EA, IARG_MEMORYWRITE_SIZE,
+                                  clk_adj);
+            }
+
+            if (INS_HasMemoryRead2(ins)) {
+              InsertBeforeMemCall(ins, inst, (AFUNPTR)__BufferMemRead,
+                                  IARG_MEMORYREAD2_EA, IARG_MEMORYREAD_SIZE,
+                                  clk_adj);
             }
           }
 
@@ -238,6 +369,7 @@ void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
                                (AFUNPTR)__AfterMemRead,
                                IARG_THREAD_ID,
                                IARG_PTR, inst,
+                               IARG_UINT32, clk_adj,
                                IARG_END);
               }
 
@@ -246,6 +378,7 @@ void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
                                (AFUNPTR)__AfterMemRead,
                                IARG_THREAD_ID,
                                IARG_PTR, inst,
+                               IARG_UINT32, clk_adj,
                                IARG_END);
               }
             }
@@ -256,6 +389,7 @@ void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
                              (AFUNPTR)__AfterMemWrite,
                              IARG_THREAD_ID,
                              IARG_PTR, inst,
+                             IARG_UINT32, clk_adj,
                              IARG_END);
               }
 
@@ -264,6 +398,7 @@ void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
                              (AFUNPTR)__AfterMemWrite,
                              IARG_THREAD_ID,
                              IARG_PTR, inst,
+                             IARG_UINT32, clk_adj,
                              IARG_END);
               }
             }
@@ -274,6 +409,7 @@ void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
                                (AFUNPTR)__AfterMemRead2,
                                IARG_THREAD_ID,
                                IARG_PTR, inst,
+                               IARG_UINT32, clk_adj,
                                IARG_END);
               }
 
@@ -282,6 +418,7 @@ void ExecutionControl::InstrumentTrace(TRACE trace, VOID *v) {
                                (AFUNPTR)__AfterMemRead2,
                                IARG_THREAD_ID,
                                IARG_PTR, inst,
+                               IARG_UINT32, clk_adj,
                                IARG_END);
               }
             }
@@ -353,22 +490,34 @@ void ExecutionControl::ImageLoad(IMG img, VOID *v) {
   if (desc_.HookMainFunc())
     InstrumentStartupFunc(img);
 
+  PIN_LockClient();
   Image *image = sinfo_->FindImage(IMG_Name(img));
   if (!image)
     image = sinfo_->CreateImage(IMG_Name(img));
+  image->SetupInstTable(IMG_HighAddress(img) - IMG_LowAddress(img) + 1);
+  if (IMG_Id(img) >= img_table_.size())
+    img_table_.resize(IMG_Id(img) + 1, NULL);
+  img_table_[IMG_Id(img)] = image;
+  PIN_UnlockClient();
 
   HandleImageLoad(img, image);
 }
 
 void ExecutionControl::ImageUnload(IMG img, VOID *v) {
-  Image *image = sinfo_->FindImage(IMG_Name(img));
+  PIN_LockClient();
+  Image *image = GetImage(img);
   DEBUG_ASSERT(image);
+  img_table_[IMG_Id(img)] = NULL;
+  if (last_image_ == image)
+    last_image_ = NULL;
+  PIN_UnlockClient();
 
   HandleImageUnload(img, image);
 }
 
 void ExecutionControl::SyscallEntry(THREADID tid, CONTEXT *ctxt,
                                     SYSCALL_STANDARD std, VOID *v) {
+  FlushMemBatch(tid);
   if (desc_.HookSyscall()) {
     HandleSyscallEntry(tid, ctxt, std);
   }
@@ -407,14 +556,25 @@ void ExecutionControl::ProgramStart() {
 }
 
 void ExecutionControl::ProgramExit(INT32 code, VOID *v) {
+  // flush the accesses of the threads that have not exited
+  for (THREADID tid = 0; tid < PIN_MAX_THREADS; tid++)
+    FlushMemBatch(tid);
+
   HandleProgramExit();
 
   // save static info
   sinfo_->Save(knob_->ValueStr("sinfo_out"));
 
+  // save the shared insts found while pruning
+  if (prune_db_)
+    prune_db_->Save(knob_->ValueStr("sinst_out"), sinfo_);
+
   // write statistics
   stat_display(knob_->ValueStr("stat_out"));
 
+  // the log drainer has been stopped (see __StopLogDrainer), the
+  // remaining messages are drained when the debug file is closed
+
   // close debug file if exists
   if (debug_file_)
     debug_file_->Close();
@@ -432,23 +592,30 @@ void ExecutionControl::ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags,
   OS_THREAD_ID parent_os_tid = PIN_GetParentTid();
 
   LockKernel();
-  tls_thd_clock_[tid] = 0; // init thd clock
+  thd_ctx_[tid].thd_clk = 0; // init thd clock
+  thd_ctx_[tid].thd_id = curr_thd_id;
+  if (prune_key_)
+    prune_key_[tid] = ThreadIndex::Get(curr_thd_id) + 1;
+  if (desc_.HookMemBatch() && !thd_ctx_[tid].batch)
+    thd_ctx_[tid].batch = new MemAccess[mem_batch_size_];
   thd_create_sem_map_[os_tid] = CreateSemaphore(0);
   os_tid_map_[os_tid] = curr_thd_id;
-  // notify the parent that the new thread start
+  UnlockKernel();
+
+  // call handler
+  HandleThreadStart();
+
+  // notify the parent that the new thread start. this is done after the
+  // handler, so that the parent cannot create another child before the
+  // analyzers have consumed what the parent saved for this one.
   if (main_thread_started_) {
     //NotifyNewChild();
     DEBUG_ASSERT(parent_os_tid);
+    ScopedLock locker(kernel_lock_);
     child_thd_map_[parent_os_tid] = curr_thd_id;
     if (thd_create_sem_map_[parent_os_tid]->Post())
       Abort("NotifyNewChild: semaphore post returns error\n");
-  }
-  UnlockKernel();
-
-  // call handler
-  HandleThreadStart();
-
-  if (!main_thread_started_) {
+  } else {
     main_thd_id_ = curr_thd_id;
     main_thread_started_ = true;
   }
@@ -456,6 +623,8 @@ void ExecutionControl::ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags,
 
 void ExecutionControl::ThreadExit(THREADID tid, const CONTEXT *ctxt, INT32 code,
                                   VOID *v) {
+  FlushMemBatch(tid);
+
   // call handler
   HandleThreadExit();
 
@@ -543,7 +712,7 @@ void ExecutionControl::HandleSyscallEntry(THREADID tid, CONTEXT *ctxt,
   thread_id_t self = Self();
   timestamp_t curr_thd_clk = GetThdClk(tid);
   int syscall_num = (int)PIN_GetSyscallNumber(ctxt, std);
-  tls_syscall_num_[tid] = syscall_num;
+  thd_ctx_[tid].syscall_num = syscall_num;
   CALL_ANALYSIS_FUNC2(Syscall, SyscallEntry, self, curr_thd_clk, syscall_num);
 }
 
@@ -551,7 +720,7 @@ void ExecutionControl::HandleSyscallExit(THREADID tid, CONTEXT *ctxt,
                                          SYSCALL_STANDARD std) {
   thread_id_t self = Self();
   timestamp_t curr_thd_clk = GetThdClk(tid);
-  int syscall_num = tls_syscall_num_[tid];
+  int syscall_num = thd_ctx_[tid].syscall_num;
   CALL_ANALYSIS_FUNC2(Syscall, SyscallExit, self, curr_thd_clk, syscall_num);
 }
 
@@ -587,54 +756,55 @@ void ExecutionControl::HandleThreadMain(THREADID tid, CONTEXT *ctxt) {
   CALL_ANALYSIS_FUNC2(MainFunc, ThreadMain, self, curr_thd_clk);
 }
 
-void ExecutionControl::HandleBeforeMemRead(THREADID tid, Inst *inst,
+void ExecutionControl::HandleBeforeMemRead(THREADID tid,
+                                           timestamp_t curr_thd_clk, Inst *inst,
                                            address_t addr, size_t size) {
   thread_id_t self = Self();
-  timestamp_t curr_thd_clk = GetThdClk(tid);
   CALL_ANALYSIS_FUNC2(BeforeMem, BeforeMemRead, self, curr_thd_clk,
                       inst, addr, size);
 }
 
-void ExecutionControl::HandleAfterMemRead(THREADID tid, Inst *inst,
+void ExecutionControl::HandleAfterMemRead(THREADID tid,
+                                          timestamp_t curr_thd_clk, Inst *inst,
                                           address_t addr, size_t size) {
   thread_id_t self = Self();
-  timestamp_t curr_thd_clk = GetThdClk(tid);
   CALL_ANALYSIS_FUNC2(AfterMem, AfterMemRead, self, curr_thd_clk,
                       inst, addr, size);
 }
 
-void ExecutionControl::HandleBeforeMemWrite(THREADID tid, Inst *inst,
-                                            address_t addr, size_t size) {
+void ExecutionControl::HandleBeforeMemWrite(THREADID tid,
+                                            timestamp_t curr_thd_clk,
+                                            Inst *inst, address_t addr,
+                                            size_t size) {
   thread_id_t self = Self();
-  timestamp_t curr_thd_clk = GetThdClk(tid);
   CALL_ANALYSIS_FUNC2(BeforeMem, BeforeMemWrite, self, curr_thd_clk,
                       inst, addr, size);
 }
 
-void ExecutionControl::HandleAfterMemWrite(THREADID tid, Inst *inst,
+void ExecutionControl::HandleAfterMemWrite(THREADID tid,
+                                           timestamp_t curr_thd_clk, Inst *inst,
                                            address_t addr, size_t size) {
   thread_id_t self = Self();
-  timestamp_t curr_thd_clk = GetThdClk(tid);
   CALL_ANALYSIS_FUNC2(AfterMem, AfterMemWrite, self, curr_thd_clk,
                       inst, addr, size);
 }
 
-void ExecutionControl::HandleBeforeAtomicInst(THREADID tid, Inst *inst,
-                                              OPCODE opcode, address_t addr) {
+void ExecutionControl::HandleBeforeAtomicInst(THREADID tid,
+                                              timestamp_t curr_thd_clk,
+                                              Inst *inst, OPCODE opcode,
+                                              address_t addr) {
   thread_id_t self = Self();
-  timestamp_t curr_thd_clk = GetThdClk(tid);
-  std::string type = OPCODE_StringShort(opcode);
   CALL_ANALYSIS_FUNC2(AtomicInst, BeforeAtomicInst, self, curr_thd_clk,
-                      inst, type, addr);
+                      inst, opcode, addr);
 }
 
-void ExecutionControl::HandleAfterAtomicInst(THREADID tid, Inst *inst,
-                                             OPCODE opcode, address_t addr) {
+void ExecutionControl::HandleAfterAtomicInst(THREADID tid,
+                                             timestamp_t curr_thd_clk,
+                                             Inst *inst, OPCODE opcode,
+                                             address_t addr) {
   thread_id_t self = Self();
-  timestamp_t curr_thd_clk = GetThdClk(tid);
-  std::string type = OPCODE_StringShort(opcode);
   CALL_ANALYSIS_FUNC2(AtomicInst, AfterAtomicInst, self, curr_thd_clk,
-                      inst, type, addr);
+                      inst, opcode, addr);
 }
 
 void ExecutionControl::HandleBeforeCall(THREADID tid, Inst *inst,
@@ -670,7 +840,8 @@ void ExecutionControl::HandleAfterReturn(THREADID tid, Inst *inst,
 }
 
 void ExecutionControl::HandleBeforeWrapper(WrapperBase *wrapper) {
-  // Nothing.
+  // Deliver the buffered accesses before the synchronization event.
+  FlushMemBatch(wrapper->tid());
 }
 
 void ExecutionControl::HandleAfterWrapper(WrapperBase *wrapper) {
@@ -689,18 +860,49 @@ void ExecutionControl::Abort(const std::string &msg) {
   assert(0);
 }
 
+void ExecutionControl::FlushMemBatch(THREADID tid) {
+  ThreadContext *ctx = GetThreadContext(tid);
+  if (!ctx->batch_size)
+    return;
+  CALL_ANALYSIS_FUNC2(MemBatch, MemAccessBatch, ctx->thd_id, ctx->batch,
+                      ctx->batch_size);
+  ctx->batch_size = 0;
+}
+
+void *ExecutionControl::AllocThreadContexts(size_t ctx_size) {
+  // Allocate zeroed contexts for all the pin threads. The contexts are
+  // aligned to cache lines, so ctx_size should be a multiple of the
+  // cache line size.
+  void *ptr = NULL;
+  size_t size = ctx_size * PIN_MAX_THREADS;
+  if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0)
+    Abort("fail to allocate thread contexts\n");
+  memset(ptr, 0, size);
+  return ptr;
+}
+
 Inst *ExecutionControl::GetInst(ADDRINT pc) {
   Image *image = NULL;
   ADDRINT offset = 0;
 
   PIN_LockClient();
-  IMG img = IMG_FindByAddress(pc);
-  if (!IMG_Valid(img)) {
-    image = sinfo_->FindImage(PSEUDO_IMAGE_NAME);
-    offset = pc;
+  // Consecutive lookups (e.g. the insts in a trace) usually fall into
+  // the same image, so try the image of the last lookup first.
+  if (last_image_ && pc >= last_low_addr_ && pc <= last_high_addr_) {
+    image = last_image_;
+    offset = pc - last_low_addr_;
   } else {
-    image = sinfo_->FindImage(IMG_Name(img));
-    offset = pc - IMG_LowAddress(img);
+    IMG img = IMG_FindByAddress(pc);
+    if (!IMG_Valid(img)) {
+      image = pseudo_image_;
+      offset = pc;
+    } else {
+      image = GetImage(img);
+      offset = pc - IMG_LowAddress(img);
+      last_image_ = image;
+      last_low_addr_ = IMG_LowAddress(img);
+      last_high_addr_ = IMG_HighAddress(img);
+    }
   }
   DEBUG_ASSERT(image);
   Inst *inst = image->Find(offset);
@@ -713,9 +915,21 @@ Inst *ExecutionControl::GetInst(ADDRINT pc) {
   return inst;
 }
 
+Image *ExecutionControl::GetImage(IMG img) {
+  // Assume the client lock is held.
+  UINT32 id = IMG_Id(img);
+  if (id < img_table_.size() && img_table_[id])
+    return img_table_[id];
+  // The image is not seen by ImageLoad yet.
+  return sinfo_->FindImage(IMG_Name(img));
+}
+
 void ExecutionControl::UpdateInstOpcode(Inst *inst, INS ins) {
+  OPCODE opcode = INS_Opcode(ins);
+  if (!*OpcodeName(opcode))
+    RegisterOpcodeName(opcode, OPCODE_StringShort(opcode));
   if (!inst->HasOpcode())
-    inst->SetOpcode(INS_Opcode(ins));
+    inst->SetOpcode(opcode);
 }
 
 void ExecutionControl::UpdateInstDebugInfo(Inst *inst, ADDRINT pc) {
@@ -734,6 +948,210 @@ void ExecutionControl::AddAnalyzer(Analyzer *analyzer) {
   desc_.Merge(analyzer->desc());
 }
 
+void ExecutionControl::BuildHookTables() {
+  for (int type = 0; type < NUM_HOOK_TYPES; type++) {
+    HookTable *table = &hook_tables_[type];
+    delete [] table->analyzers;
+    table->analyzers = new Analyzer *[analyzers_.size()];
+    table->size = 0;
+    for (AnalyzerContainer::iterator it = analyzers_.begin();
+         it != analyzers_.end(); ++it) {
+      if (Subscribed(*it, (HookType)type))
+        table->analyzers[table->size++] = *it;
+    }
+  }
+}
+
+void ExecutionControl::SetupAccessPredicate() {
+  // The access predicate can only be used if all the analyzers that
+  // hook memory accesses publish the regions they monitor. It is not
+  // used if any analyzer hooks after memory accesses, as the after
+  // hooks get the address saved by the before hooks and cannot check
+  // the predicate themselves (the effective address is not available
+  // after the inst).
+  if (!desc_.HookMem() || desc_.HookAfterMem())
+    return;
+  for (AnalyzerContainer::iterator it = analyzers_.begin();
+       it != analyzers_.end(); ++it) {
+    Descriptor *desc = (*it)->desc();
+    if (desc->HookMem() && !desc->PublishMemRegion())
+      return;
+  }
+
+  access_predicate_ = new AccessPredicate;
+  for (AnalyzerContainer::iterator it = analyzers_.begin();
+       it != analyzers_.end(); ++it) {
+    if ((*it)->desc()->HookMem())
+      (*it)->set_access_predicate(access_predicate_);
+  }
+}
+
+void ExecutionControl::InsertBeforeMemCall(INS ins, Inst *inst, AFUNPTR func,
+                                           IARG_TYPE ea_arg,
+                                           IARG_TYPE size_arg,
+                                           UINT32 clk_adj) {
+  if (access_predicate_) {
+    // Only call the handler if the access might be monitored.
+    INS_InsertIfCall(ins, IPOINT_BEFORE,
+                     (AFUNPTR)__CheckAccess,
+                     IARG_FAST_ANALYSIS_CALL,
+                     IARG_PTR, access_predicate_->bitmap(),
+                     ea_arg,
+                     IARG_END);
+    INS_InsertThenCall(ins, IPOINT_BEFORE,
+                       func,
+                       IARG_THREAD_ID,
+                       IARG_PTR, inst,
+                       ea_arg,
+                       size_arg,
+                       IARG_UINT32, clk_adj,
+                       IARG_END);
+  } else {
+    INS_InsertCall(ins, IPOINT_BEFORE,
+                   func,
+                   IARG_THREAD_ID,
+                   IARG_PTR, inst,
+                   ea_arg,
+                   size_arg,
+                   IARG_UINT32, clk_adj,
+                   IARG_END);
+  }
+}
+
+bool ExecutionControl::Prunable(Inst *inst) {
+  if (!prune_db_ || !prune_db_->Profiled(inst))
+    return false;
+  return !prune_db_->Shared(inst);
+}
+
+void ExecutionControl::InsertPrunedCheck(INS ins, Inst *inst,
+                                         IARG_TYPE ea_arg,
+                                         IARG_TYPE size_arg,
+                                         bool is_write, UINT32 clk_adj) {
+  INS_InsertIfCall(ins, IPOINT_BEFORE,
+                   (AFUNPTR)__CheckPruned,
+                   IARG_FAST_ANALYSIS_CALL,
+                   IARG_PTR, prune_owner_,
+                   IARG_PTR, prune_key_,
+                   ea_arg,
+                   IARG_THREAD_ID,
+                   IARG_END);
+  INS_InsertThenCall(ins, IPOINT_BEFORE,
+                     (AFUNPTR)__PrunedAccess,
+                     IARG_THREAD_ID,
+                     IARG_PTR, inst,
+                     IARG_INST_PTR,
+                     ea_arg,
+                     size_arg,
+                     IARG_BOOL, is_write,
+                     IARG_UINT32, clk_adj,
+                     IARG_END);
+}
+
+void ExecutionControl::InsertOwnerCheck(INS ins, IARG_TYPE ea_arg) {
+  INS_InsertIfCall(ins, IPOINT_BEFORE,
+                   (AFUNPTR)__CheckOwner,
+                   IARG_FAST_ANALYSIS_CALL,
+                   IARG_PTR, prune_owner_,
+                   IARG_PTR, prune_key_,
+                   ea_arg,
+                   IARG_THREAD_ID,
+                   IARG_END);
+  INS_InsertThenCall(ins, IPOINT_BEFORE,
+                     (AFUNPTR)__OwnerAccess,
+                     IARG_THREAD_ID,
+                     ea_arg,
+                     IARG_END);
+}
+
+void ExecutionControl::HandlePrunedAccess(THREADID tid, Inst *inst,
+                                          address_t pc, address_t addr,
+                                          size_t size, bool is_write,
+                                          UINT32 clk_adj) {
+  uint32 *owner = &prune_owner_[(addr >> PRUNE_PAGE_SHIFT) &
+                                (PRUNE_OWNER_TABLE_SIZE - 1)];
+  // The first thread touching the page owns it.
+  if (ATOMIC_BOOL_COMPARE_AND_SWAP(owner, 0, prune_key_[tid]))
+    return;
+
+  // The page is touched by more than one thread (or collides with such
+  // a page in the table). Mark the page shared so that the other pruned
+  // insts touching it are also caught.
+  *owner = PRUNE_OWNER_SHARED;
+
+  // This access is the first one the analyzers should see, hand it to
+  // the regular hooks as the instrumented inst would.
+  ThreadContext *ctx = GetThreadContext(tid);
+  if (desc_.HookBeforeMem()) {
+    if (is_write)
+      HandleBeforeMemWrite(tid, ctx->thd_clk - clk_adj, inst, addr, size);
+    else
+      HandleBeforeMemRead(tid, ctx->thd_clk - clk_adj, inst, addr, size);
+  }
+  if (desc_.HookMemBatch())
+    BufferMemAccess(tid, inst, addr, size, is_write, clk_adj);
+
+  // Mark the inst shared and drop its code so that it is instrumented
+  // in full the next time it is reached.
+  if (prune_db_->Shared(inst))
+    return;
+  prune_db_->SetShared(inst);
+  CODECACHE_InvalidateRange(pc, pc + 1);
+}
+
+void ExecutionControl::HandleOwnerAccess(THREADID tid, address_t addr) {
+  uint32 *owner = &prune_owner_[(addr >> PRUNE_PAGE_SHIFT) &
+                                (PRUNE_OWNER_TABLE_SIZE - 1)];
+  // The first thread touching the page owns it. Otherwise, the page is
+  // touched by more than one thread, mark it shared so that the pruned
+  // insts touching it are caught (the inst itself is instrumented).
+  if (ATOMIC_BOOL_COMPARE_AND_SWAP(owner, 0, prune_key_[tid]))
+    return;
+  *owner = PRUNE_OWNER_SHARED;
+}
+
+void ExecutionControl::AddTraceToGroup(TRACE trace, int group) {
+  // Remember the code range of a trace whose instrumentation depends on
+  // some dynamic state, so that the code can be dropped when the state
+  // changes (see InvalidateTraceGroup).
+  ScopedLock locker(trace_group_lock_);
+  address_t start = TRACE_Address(trace);
+  address_t last = start + TRACE_Size(trace) - 1;
+  address_t &curr_last = trace_group_map_[group][start];
+  if (last > curr_last)
+    curr_last = last;
+}
+
+void ExecutionControl::InvalidateTraceGroup(int group) {
+  // Drop the code of all the traces in the group. They will be
+  // instrumented again the next time they are executed.
+  ScopedLock locker(trace_group_lock_);
+  TraceRangeMap &range_map = trace_group_map_[group];
+  for (TraceRangeMap::iterator it = range_map.begin();
+       it != range_map.end(); ++it) {
+    CODECACHE_InvalidateRange(it->first, it->second);
+  }
+  range_map.clear();
+}
+
+bool ExecutionControl::Subscribed(Analyzer *analyzer, HookType type) {
+  Descriptor *desc = analyzer->desc();
+  switch (type) {
+    case HOOK_TYPE_BeforeMem: return desc->HookBeforeMem();
+    case HOOK_TYPE_AfterMem: return desc->HookAfterMem();
+    case HOOK_TYPE_MemBatch: return desc->HookMemBatch();
+    case HOOK_TYPE_AtomicInst: return desc->HookAtomicInst();
+    case HOOK_TYPE_PthreadFunc: return desc->HookPthreadFunc();
+    case HOOK_TYPE_YieldFunc: return desc->HookYieldFunc();
+    case HOOK_TYPE_MallocFunc: return desc->HookMallocFunc();
+    case HOOK_TYPE_MainFunc: return desc->HookMainFunc();
+    case HOOK_TYPE_CallReturn: return desc->HookCallReturn();
+    case HOOK_TYPE_Syscall: return desc->HookSyscall();
+    case HOOK_TYPE_Signal: return desc->HookSignal();
+    default: return false;
+  }
+}
+
 thread_id_t ExecutionControl::GetThdID(pthread_t thread) {
   ScopedLock locker(kernel_lock_);
 
@@ -846,12 +1264,63 @@ void ExecutionControl::InstrumentStartupFunc(IMG img) {
 }
 
 void PIN_FAST_ANALYSIS_CALL ExecutionControl::__InstCount(THREADID tid) {
-  ctrl_->tls_thd_clock_[tid]++;
+  ctrl_->GetThreadContext(tid)->thd_clk++;
 }
 
 void PIN_FAST_ANALYSIS_CALL ExecutionControl::__InstCount2(THREADID tid,
                                                            UINT32 c) {
-  ctrl_->tls_thd_clock_[tid] += c;
+  ctrl_->GetThreadContext(tid)->thd_clk += c;
+}
+
+ADDRINT PIN_FAST_ANALYSIS_CALL ExecutionControl::__CheckAccess(uint8 *bitmap,
+                                                              ADDRINT addr) {
+  return AccessPredicate::Check(bitmap, addr);
+}
+
+ADDRINT PIN_FAST_ANALYSIS_CALL ExecutionControl::__CheckPruned(uint32 *owner,
+                                                              uint32 *key,
+                                                              ADDRINT addr,
+                                                              THREADID tid) {
+  return owner[(addr >> PRUNE_PAGE_SHIFT) & (PRUNE_OWNER_TABLE_SIZE - 1)] !=
+         key[tid];
+}
+
+ADDRINT PIN_FAST_ANALYSIS_CALL ExecutionControl::__CheckOwner(uint32 *owner,
+                                                             uint32 *key,
+                                                             ADDRINT addr,
+                                                             THREADID tid) {
+  // the shared pages need no more update
+  uint32 curr = owner[(addr >> PRUNE_PAGE_SHIFT) &
+                      (PRUNE_OWNER_TABLE_SIZE - 1)];
+  return curr != key[tid] && curr != PRUNE_OWNER_SHARED;
+}
+
+void ExecutionControl::__PrunedAccess(THREADID tid, Inst *inst, ADDRINT pc,
+                                      ADDRINT addr, UINT32 size,
+                                      BOOL is_write, UINT32 clk_adj) {
+  ctrl_->HandlePrunedAccess(tid, inst, pc, addr, size, is_write, clk_adj);
+}
+
+void ExecutionControl::__OwnerAccess(THREADID tid, ADDRINT addr) {
+  ctrl_->HandleOwnerAccess(tid, addr);
+}
+
+void ExecutionControl::__LogDrainer(VOID *arg) {
+  while (!ctrl_->log_drainer_stop_ && !PIN_IsProcessExiting()) {
+    if (!ctrl_->async_debug_file_->Drain())
+      PIN_Sleep(10);
+  }
+}
+
+void ExecutionControl::__StopLogDrainer(VOID *arg) {
+  ctrl_->log_drainer_stop_ = true;
+  if (ctrl_->log_drainer_uid_ != INVALID_PIN_THREAD_UID)
+    PIN_WaitForThreadTermination(ctrl_->log_drainer_uid_,
+                                 PIN_INFINITE_TIMEOUT, NULL);
+}
+
+thread_id_t ExecutionControl::__LogThreadId() {
+  return PIN_ThreadUid();
 }
 
 void ExecutionControl::__Main(THREADID tid, CONTEXT *ctxt) {
@@ -863,60 +1332,88 @@ void ExecutionControl::__ThreadMain(THREADID tid, CONTEXT *ctxt) {
 }
 
 void ExecutionControl::__BeforeMemRead(THREADID tid, Inst *inst,
-                                       ADDRINT addr, UINT32 size) {
-  ctrl_->HandleBeforeMemRead(tid, inst, addr, size);
+                                       ADDRINT addr, UINT32 size,
+                                       UINT32 clk_adj) {
+  ThreadContext *ctx = ctrl_->GetThreadContext(tid);
+  ctrl_->HandleBeforeMemRead(tid, ctx->thd_clk - clk_adj, inst, addr, size);
   if (ctrl_->desc_.HookAfterMem()) {
-    ctrl_->tls_read_addr_[tid] = addr;
-    ctrl_->tls_read_size_[tid] = size;
+    ctx->read_addr = addr;
+    ctx->read_size = size;
   }
 }
 
-void ExecutionControl::__AfterMemRead(THREADID tid, Inst *inst) {
-  address_t addr = ctrl_->tls_read_addr_[tid];
-  address_t size = ctrl_->tls_read_size_[tid];
-  ctrl_->HandleAfterMemRead(tid, inst, addr, size);
+void ExecutionControl::__AfterMemRead(THREADID tid, Inst *inst,
+                                      UINT32 clk_adj) {
+  ThreadContext *ctx = ctrl_->GetThreadContext(tid);
+  address_t addr = ctx->read_addr;
+  size_t size = ctx->read_size;
+  ctrl_->HandleAfterMemRead(tid, ctx->thd_clk - clk_adj, inst, addr, size);
 }
 
 void ExecutionControl::__BeforeMemWrite(THREADID tid, Inst *inst,
-                                        ADDRINT addr, UINT32 size) {
-  ctrl_->HandleBeforeMemWrite(tid, inst, addr, size);
+                                        ADDRINT addr, UINT32 size,
+                                        UINT32 clk_adj) {
+  ThreadContext *ctx = ctrl_->GetThreadContext(tid);
+  ctrl_->HandleBeforeMemWrite(tid, ctx->thd_clk - clk_adj, inst, addr, size);
   if (ctrl_->desc_.HookAfterMem()) {
-    ctrl_->tls_write_addr_[tid] = addr;
-    ctrl_->tls_write_size_[tid] = size;
+    ctx->write_addr = addr;
+    ctx->write_size = size;
   }
 }
 
-void ExecutionControl::__AfterMemWrite(THREADID tid, Inst *inst) {
-  address_t addr = ctrl_->tls_write_addr_[tid];
-  size_t size = ctrl_->tls_write_size_[tid];
-  ctrl_->HandleAfterMemWrite(tid, inst, addr, size);
+void ExecutionControl::__AfterMemWrite(THREADID tid, Inst *inst,
+                                       UINT32 clk_adj) {
+  ThreadContext *ctx = ctrl_->GetThreadContext(tid);
+  address_t addr = ctx->write_addr;
+  size_t size = ctx->write_size;
+  ctrl_->HandleAfterMemWrite(tid, ctx->thd_clk - clk_adj, inst, addr, size);
 }
 
 void ExecutionControl::__BeforeMemRead2(THREADID tid, Inst *inst,
-                                        ADDRINT addr, UINT32 size) {
-  ctrl_->HandleBeforeMemRead(tid, inst, addr, size);
+                                        ADDRINT addr, UINT32 size,
+                                        UINT32 clk_adj) {
+  ThreadContext *ctx = ctrl_->GetThreadContext(tid);
+  ctrl_->HandleBeforeMemRead(tid, ctx->thd_clk - clk_adj, inst, addr, size);
   if (ctrl_->desc_.HookAfterMem()) {
-    ctrl_->tls_read2_addr_[tid] = addr;
-    ctrl_->tls_read_size_[tid] = size;
+    ctx->read2_addr = addr;
+    ctx->read_size = size;
   }
 }
 
-void ExecutionControl::__AfterMemRead2(THREADID tid, Inst *inst) {
-  address_t addr = ctrl_->tls_read2_addr_[tid];
-  address_t size = ctrl_->tls_read_size_[tid];
-  ctrl_->HandleAfterMemRead(tid, inst, addr, size);
+void ExecutionControl::__AfterMemRead2(THREADID tid, Inst *inst,
+                                       UINT32 clk_adj) {
+  ThreadContext *ctx = ctrl_->GetThreadContext(tid);
+  address_t addr = ctx->read2_addr;
+  size_t size = ctx->read_size;
+  ctrl_->HandleAfterMemRead(tid, ctx->thd_clk - clk_adj, inst, addr, size);
+}
+
+void ExecutionControl::__BufferMemRead(THREADID tid, Inst *inst,
+                                       ADDRINT addr, UINT32 size,
+                                       UINT32 clk_adj) {
+  ctrl_->BufferMemAccess(tid, inst, addr, size, false, clk_adj);
+}
+
+void ExecutionControl::__BufferMemWrite(THREADID tid, Inst *inst,
+                                        ADDRINT addr, UINT32 size,
+                                        UINT32 clk_adj) {
+  ctrl_->BufferMemAccess(tid, inst, addr, size, true, clk_adj);
 }
 
 void ExecutionControl::__BeforeAtomicInst(THREADID tid, Inst *inst,
-                                          UINT32 opcode, ADDRINT addr) {
-  ctrl_->HandleBeforeAtomicInst(tid, inst, opcode, addr);
-  ctrl_->tls_atomic_addr_[tid] = addr;
+                                          UINT32 opcode, ADDRINT addr,
+                                          UINT32 clk_adj) {
+  ThreadContext *ctx = ctrl_->GetThreadContext(tid);
+  ctrl_->HandleBeforeAtomicInst(tid, ctx->thd_clk - clk_adj, inst, opcode,
+                                addr);
+  ctx->atomic_addr = addr;
 }
 
 void ExecutionControl::__AfterAtomicInst(THREADID tid, Inst *inst,
-                                         UINT32 opcode) {
-  address_t addr = ctrl_->tls_atomic_addr_[tid];
-  ctrl_->HandleAfterAtomicInst(tid, inst, opcode, addr);
+                                         UINT32 opcode, UINT32 clk_adj) {
+  ThreadContext *ctx = ctrl_->GetThreadContext(tid);
+  address_t addr = ctx->atomic_addr;
+  ctrl_->HandleAfterAtomicInst(tid, ctx->thd_clk - clk_adj, inst, opcode, addr);
 }
 
 void ExecutionControl::__BeforeCall(THREADID tid, Inst *inst,
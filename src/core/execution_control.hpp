@@ -22,6 +22,7 @@
 #include <csignal>
 #include <list>
 #include <map>
+#include <vector>
 
 #include "pin.H"
 
@@ -29,12 +30,20 @@
 #include "core/sync.h"
 #include "core/static_info.h"
 #include "core/descriptor.h"
+#include "core/filter.h"
 #include "core/analyzer.h"
 #include "core/debug_analyzer.h"
 #include "core/callstack.h"
 #include "core/pin_sync.hpp"
 #include "core/pin_knob.hpp"
 #include "core/wrapper.hpp"
+#include "core/inst_sharing_db.h"
+
+// The granularity and the size of the page owner table used to verify
+// the pruned memory instructions (see sinst_prune).
+#define PRUNE_PAGE_SHIFT 12
+#define PRUNE_OWNER_TABLE_SIZE (1 << 20)
+#define PRUNE_OWNER_SHARED static_cast<uint32>(-1)
 
 // Define macros for calling analysis functions.
 #define CALL_ANALYSIS_FUNC(func,...)                                        \
@@ -43,12 +52,13 @@
     (*it)->func(__VA_ARGS__);                                               \
   }
 
+// Only visit the analyzers subscribed to the hook (see HookTable).
 #define CALL_ANALYSIS_FUNC2(type,func,...)                                  \
-  for (AnalyzerContainer::iterator it = analyzers_.begin();                 \
-       it != analyzers_.end(); ++it) {                                      \
-    if ((*it)->desc()->Hook##type())                                        \
-      (*it)->func(__VA_ARGS__);                                             \
-  }
+  do {                                                                      \
+    HookTable *hook_table = &hook_tables_[HOOK_TYPE_##type];                \
+    for (size_t i = 0; i < hook_table->size; i++)                           \
+      hook_table->analyzers[i]->func(__VA_ARGS__);                          \
+  } while (0)
 
 // Define macros for wrapper handlers.
 #define MEMBER_WRAPPER_HANDLER(name) Handle##name
@@ -180,13 +190,66 @@ class ExecutionControl {
 
  protected:
   typedef std::list<Analyzer *> AnalyzerContainer;
+  typedef std::map<address_t, address_t> TraceRangeMap; // start -> last
+
+  // the analysis hooks that analyzers can subscribe to (the names
+  // match the Hook* functions in the descriptor).
+  typedef enum {
+    HOOK_TYPE_BeforeMem = 0,
+    HOOK_TYPE_AfterMem,
+    HOOK_TYPE_MemBatch,
+    HOOK_TYPE_AtomicInst,
+    HOOK_TYPE_PthreadFunc,
+    HOOK_TYPE_YieldFunc,
+    HOOK_TYPE_MallocFunc,
+    HOOK_TYPE_MainFunc,
+    HOOK_TYPE_CallReturn,
+    HOOK_TYPE_Syscall,
+    HOOK_TYPE_Signal,
+    NUM_HOOK_TYPES,
+  } HookType;
+
+  // the per thread scratch state of the controller (indexed by the
+  // pin thread id). each context is aligned to a cache line, so that
+  // threads updating their own contexts do not share cache lines.
+  class ThreadContext {
+   public:
+    timestamp_t thd_clk;
+    address_t read_addr;
+    size_t read_size;
+    address_t write_addr;
+    size_t write_size;
+    address_t read2_addr;
+    address_t atomic_addr;
+    int syscall_num;
+    thread_id_t thd_id;
+    MemAccess *batch; // buffered accesses (NULL if not batching)
+    size_t batch_size;
+  } CACHE_LINE_ALIGNED;
+
+  // the dispatch table of a hook. it is a compact array of the
+  // analyzers subscribed to the hook, so that the analysis functions
+  // do not need to walk all the analyzers and check their descriptors.
+  class HookTable {
+   public:
+    HookTable() : size(0), analyzers(NULL) {}
+    ~HookTable() { delete [] analyzers; }
+
+    size_t size;
+    Analyzer **analyzers;
+  };
 
   virtual Mutex *CreateMutex() { return new PinMutex; }
+  virtual RWMutex *CreateRWMutex() { return new PinRWMutex; }
 
   virtual Semaphore *CreateSemaphore(unsigned int value) {
     return new SysSemaphore(value);
   }
 
+  // Create the database used to prune the thread local insts (see
+  // sinst_prune). Return NULL if the tool does not support pruning.
+  virtual InstSharingDB *CreateInstSharingDB() { return NULL; }
+
   virtual void HandlePreSetup();
   virtual void HandlePostSetup();
   virtual bool HandleIgnoreInstCount(IMG img) { return false; }
@@ -207,18 +270,19 @@ class ExecutionControl {
   virtual void HandleThreadExit();
   virtual void HandleMain(THREADID tid, CONTEXT *ctxt);
   virtual void HandleThreadMain(THREADID tid, CONTEXT *ctxt);
-  virtual void HandleBeforeMemRead(THREADID tid, Inst *inst, address_t addr,
-                                   size_t size);
-  virtual void HandleAfterMemRead(THREADID tid, Inst *inst, address_t addr,
-                                  size_t size);
-  virtual void HandleBeforeMemWrite(THREADID tid, Inst *inst, address_t addr,
-                                    size_t size);
-  virtual void HandleAfterMemWrite(THREADID tid, Inst *inst, address_t addr,
-                                   size_t size);
-  virtual void HandleBeforeAtomicInst(THREADID tid, Inst *inst, OPCODE opcode,
+  virtual void HandleBeforeMemRead(THREADID tid, timestamp_t curr_thd_clk,
+                                   Inst *inst, address_t addr, size_t size);
+  virtual void HandleAfterMemRead(THREADID tid, timestamp_t curr_thd_clk,
+                                  Inst *inst, address_t addr, size_t size);
+  virtual void HandleBeforeMemWrite(THREADID tid, timestamp_t curr_thd_clk,
+                                    Inst *inst, address_t addr, size_t size);
+  virtual void HandleAfterMemWrite(THREADID tid, timestamp_t curr_thd_clk,
+                                   Inst *inst, address_t addr, size_t size);
+  virtual void HandleBeforeAtomicInst(THREADID tid, timestamp_t curr_thd_clk,
+                                      Inst *inst, OPCODE opcode,
                                       address_t addr);
-  virtual void HandleAfterAtomicInst(THREADID tid, Inst *inst, OPCODE opcode,
-                                     address_t addr);
+  virtual void HandleAfterAtomicInst(THREADID tid, timestamp_t curr_thd_clk,
+                                     Inst *inst, OPCODE opcode, address_t addr);
   virtual void HandleBeforeCall(THREADID tid, Inst *inst, address_t target);
   virtual void HandleAfterCall(THREADID tid, Inst *inst, address_t target,
                                address_t ret);
@@ -230,14 +294,46 @@ class ExecutionControl {
   void LockKernel() { kernel_lock_->Lock(); }
   void UnlockKernel() { kernel_lock_->Unlock(); }
   void Abort(const std::string &msg);
+  void *AllocThreadContexts(size_t ctx_size);
+  void FlushMemBatch(THREADID tid);
+  void BufferMemAccess(THREADID tid, Inst *inst, address_t addr, size_t size,
+                       bool is_write, UINT32 clk_adj) {
+    ThreadContext *ctx = GetThreadContext(tid);
+    MemAccess *access = &ctx->batch[ctx->batch_size++];
+    access->inst = inst;
+    access->addr = addr;
+    access->size = size;
+    access->is_write = is_write;
+    access->thd_clk = ctx->thd_clk - clk_adj;
+    if (ctx->batch_size == mem_batch_size_)
+      FlushMemBatch(tid);
+  }
   Inst *GetInst(ADDRINT pc);
+  Image *GetImage(IMG img);
   void UpdateInstOpcode(Inst *inst, INS ins);
   void UpdateInstDebugInfo(Inst *inst, ADDRINT pc);
   void AddAnalyzer(Analyzer *analyzer);
+  void BuildHookTables();
+  void SetupAccessPredicate();
+  void InsertBeforeMemCall(INS ins, Inst *inst, AFUNPTR func,
+                           IARG_TYPE ea_arg, IARG_TYPE size_arg,
+                           UINT32 clk_adj);
+  bool Subscribed(Analyzer *analyzer, HookType type);
+  void AddTraceToGroup(TRACE trace, int group);
+  void InvalidateTraceGroup(int group);
+  bool Prunable(Inst *inst);
+  void InsertPrunedCheck(INS ins, Inst *inst, IARG_TYPE ea_arg,
+                         IARG_TYPE size_arg, bool is_write, UINT32 clk_adj);
+  void InsertOwnerCheck(INS ins, IARG_TYPE ea_arg);
+  void HandlePrunedAccess(THREADID tid, Inst *inst, address_t pc,
+                          address_t addr, size_t size, bool is_write,
+                          UINT32 clk_adj);
+  void HandleOwnerAccess(THREADID tid, address_t addr);
   thread_id_t GetThdID(pthread_t thread);
   thread_id_t GetParent();
   thread_id_t Self() { return PIN_ThreadUid(); }
-  timestamp_t GetThdClk(THREADID tid) { return tls_thd_clock_[tid]; }
+  timestamp_t GetThdClk(THREADID tid) { return thd_ctx_[tid].thd_clk; }
+  ThreadContext *GetThreadContext(THREADID tid) { return &thd_ctx_[tid]; }
 
   // TODO(jieyu): How to remove the dependency to the pthread_create wrapper.
   thread_id_t WaitForNewChild(WRAPPER_CLASS(PthreadCreate) *wrapper);
@@ -250,19 +346,31 @@ class ExecutionControl {
   Knob *knob_;
   Descriptor desc_;
   LogFile *debug_file_;
+  AsyncFileLogFile *async_debug_file_; // NULL if not asynchronous
+  volatile bool log_drainer_stop_;
+  PIN_THREAD_UID log_drainer_uid_; // INVALID_PIN_THREAD_UID if none
   StaticInfo *sinfo_;
+  Image *pseudo_image_;
+  std::vector<Image *> img_table_; // indexed by the pin image id
+  Image *last_image_; // the image of the last inst lookup
+  address_t last_low_addr_;
+  address_t last_high_addr_;
   CallStackInfo *callstack_info_;
   AnalyzerContainer analyzers_;
+  HookTable hook_tables_[NUM_HOOK_TYPES];
+  AccessPredicate *access_predicate_; // NULL if not used
   DebugAnalyzer *debug_analyzer_;
   volatile bool main_thread_started_;
-  timestamp_t tls_thd_clock_[PIN_MAX_THREADS];
-  address_t tls_read_addr_[PIN_MAX_THREADS];
-  size_t tls_read_size_[PIN_MAX_THREADS];
-  address_t tls_write_addr_[PIN_MAX_THREADS];
-  size_t tls_write_size_[PIN_MAX_THREADS];
-  address_t tls_read2_addr_[PIN_MAX_THREADS];
-  address_t tls_atomic_addr_[PIN_MAX_THREADS];
-  int tls_syscall_num_[PIN_MAX_THREADS];
+  ThreadContext *thd_ctx_; // PIN_MAX_THREADS contexts
+  size_t mem_batch_size_;
+  bool bbl_inst_count_; // count insts at bbl entries only
+  InstSharingDB *prune_db_; // NULL if not pruning
+  uint32 *prune_owner_; // the owner (owner key) of each page
+  // the owner key of each pin thread (the thread index + 1). pin
+  // thread ids are reused, so they cannot identify the owners.
+  uint32 *prune_key_;
+  Mutex *trace_group_lock_;
+  std::map<int, TraceRangeMap> trace_group_map_;
   std::map<OS_THREAD_ID, Semaphore *> thd_create_sem_map_; // init = 0
   std::map<OS_THREAD_ID, thread_id_t> child_thd_map_;
   std::map<OS_THREAD_ID, thread_id_t> os_tid_map_;
@@ -276,20 +384,42 @@ class ExecutionControl {
 
   static void PIN_FAST_ANALYSIS_CALL __InstCount(THREADID tid);
   static void PIN_FAST_ANALYSIS_CALL __InstCount2(THREADID tid, UINT32 c);
+  static ADDRINT PIN_FAST_ANALYSIS_CALL __CheckAccess(uint8 *bitmap,
+                                                     ADDRINT addr);
+  static ADDRINT PIN_FAST_ANALYSIS_CALL __CheckPruned(uint32 *owner,
+                                                     uint32 *key,
+                                                     ADDRINT addr,
+                                                     THREADID tid);
+  static ADDRINT PIN_FAST_ANALYSIS_CALL __CheckOwner(uint32 *owner,
+                                                    uint32 *key,
+                                                    ADDRINT addr,
+                                                    THREADID tid);
+  static void __PrunedAccess(THREADID tid, Inst *inst, ADDRINT pc,
+                             ADDRINT addr, UINT32 size, BOOL is_write,
+                             UINT32 clk_adj);
+  static void __OwnerAccess(THREADID tid, ADDRINT addr);
+  static void __LogDrainer(VOID *arg);
+  static void __StopLogDrainer(VOID *arg);
+  static thread_id_t __LogThreadId();
   static void __Main(THREADID tid, CONTEXT *ctxt);
   static void __ThreadMain(THREADID tid, CONTEXT *ctxt);
   static void __BeforeMemRead(THREADID tid, Inst *inst, ADDRINT addr,
-                              UINT32 size);
-  static void __AfterMemRead(THREADID tid, Inst *inst);
+                              UINT32 size, UINT32 clk_adj);
+  static void __AfterMemRead(THREADID tid, Inst *inst, UINT32 clk_adj);
   static void __BeforeMemWrite(THREADID tid, Inst *inst, ADDRINT addr,
-                               UINT32 size);
-  static void __AfterMemWrite(THREADID tid, Inst *inst);
+                               UINT32 size, UINT32 clk_adj);
+  static void __AfterMemWrite(THREADID tid, Inst *inst, UINT32 clk_adj);
   static void __BeforeMemRead2(THREADID tid, Inst *inst, ADDRINT addr,
-                               UINT32 size);
-  static void __AfterMemRead2(THREADID tid, Inst *inst);
+                               UINT32 size, UINT32 clk_adj);
+  static void __AfterMemRead2(THREADID tid, Inst *inst, UINT32 clk_adj);
+  static void __BufferMemRead(THREADID tid, Inst *inst, ADDRINT addr,
+                              UINT32 size, UINT32 clk_adj);
+  static void __BufferMemWrite(THREADID tid, Inst *inst, ADDRINT addr,
+                               UINT32 size, UINT32 clk_adj);
   static void __BeforeAtomicInst(THREADID tid, Inst *inst, UINT32 opcode,
-                                 ADDRINT addr);
-  static void __AfterAtomicInst(THREADID tid, Inst *inst, UINT32 opcode);
+                                 ADDRINT addr, UINT32 clk_adj);
+  static void __AfterAtomicInst(THREADID tid, Inst *inst, UINT32 opcode,
+                                UINT32 clk_adj);
   static void __BeforeCall(THREADID tid, Inst *inst, ADDRINT target);
   static void __AfterCall(THREADID tid, Inst *inst, ADDRINT target,
                           ADDRINT ret);
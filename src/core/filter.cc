@@ -18,10 +18,30 @@
 
 #include "core/filter.h"
 
+#include <cstdlib>
+#include <cstring>
+
+#include "core/atomic.h"
+
+RegionFilter::RegionFilter(Mutex *lock)
+    : internal_lock_(lock),
+      page_table_(NULL),
+      granule_table_(NULL) {
+  page_table_ = new ShadowMemory<uint8>(FILTER_PAGE_SIZE);
+  granule_table_ = new ShadowMemory<uint8>(FILTER_GRANULE_SIZE);
+}
+
+RegionFilter::~RegionFilter() {
+  delete internal_lock_;
+  delete page_table_;
+  delete granule_table_;
+}
+
 void RegionFilter::AddRegion(address_t addr, size_t size, bool locking) {
   ScopedLock locker(internal_lock_, locking);
 
   addr_region_map_[addr] = size;
+  UpdateStates(addr, size, true);
 }
 
 size_t RegionFilter::RemoveRegion(address_t addr, bool locking) {
@@ -33,13 +53,190 @@ size_t RegionFilter::RemoveRegion(address_t addr, bool locking) {
   if (it != addr_region_map_.end()) {
     size = it->second;
     addr_region_map_.erase(it);
+    UpdateStates(addr, size, false);
   }
   return size;
 }
 
 bool RegionFilter::Filter(address_t addr, bool locking) {
+  uint8 *state = page_table_->Find(addr);
+  if (!state)
+    return true;
+
+  switch (*state) {
+    case STATE_NONE:
+      return true;
+    case STATE_FULL:
+      return false;
+    default:
+      break;
+  }
+
+  // the page is at the boundary of a region
+  state = granule_table_->Find(addr);
+  if (state) {
+    switch (*state) {
+      case STATE_NONE:
+        return true;
+      case STATE_FULL:
+        return false;
+      default:
+        break;
+    }
+  }
+
+  // the granule is at the boundary of a region
   ScopedLock locker(internal_lock_, locking);
+  return FilterRegionMap(addr);
+}
+
+void RegionFilter::UpdateStates(address_t addr, size_t size, bool add) {
+  // the caller should hold the internal lock
+  if (!size)
+    return;
+  address_t start_page = UNIT_DOWN_ALIGN(addr, FILTER_PAGE_SIZE);
+  address_t end_page = UNIT_UP_ALIGN(addr + size, FILTER_PAGE_SIZE);
+  for (address_t page = start_page; page < end_page;
+       page += FILTER_PAGE_SIZE) {
+    if (page < addr || page + FILTER_PAGE_SIZE > addr + size) {
+      // the page might be shared with neighboring regions
+      UpdateBoundaryPage(page, addr, size, add);
+    } else if (add) {
+      *page_table_->Get(page) = STATE_FULL;
+    } else {
+      uint8 *state = page_table_->Find(page);
+      if (state)
+        *state = STATE_NONE;
+    }
+  }
+
+  if (!add) {
+    // no other region overlaps the shadow pages entirely covered by
+    // the removed region, so their states are no longer needed
+    page_table_->Release(addr, size);
+    granule_table_->Release(addr, size);
+  }
+}
+
+void RegionFilter::UpdateBoundaryPage(address_t page, address_t addr,
+                                      size_t size, bool add) {
+  // the caller should hold the internal lock
+  uint8 state = ComputeState(page, page + FILTER_PAGE_SIZE);
+  if (state == STATE_PARTIAL) {
+    uint8 *old_state = page_table_->Find(page);
+    if (old_state && *old_state == STATE_PARTIAL) {
+      // the granules outside the updated region are still valid
+      UpdateRangeGranules(page, addr, size, add);
+      return;
+    }
+    // the granule states should be ready before the page is marked
+    // partial, as Filter reads them without locking
+    UpdatePageGranules(page);
+    MEMORY_BARRIER();
+    *page_table_->Get(page) = STATE_PARTIAL;
+    return;
+  }
+
+  uint8 *slot = state == STATE_NONE ? page_table_->Find(page)
+                                    : page_table_->Get(page);
+  if (slot)
+    *slot = state;
+  ReleaseGranules(page);
+}
 
+void RegionFilter::UpdatePageGranules(address_t page) {
+  // the caller should hold the internal lock. compute the states first
+  // and write each of them once, so that Filter never sees a transient
+  // state of a granule.
+  uint8 states[FILTER_PAGE_SIZE / FILTER_GRANULE_SIZE];
+  memset(states, 0, sizeof(states));
+  address_t page_end = page + FILTER_PAGE_SIZE;
+
+  // only visit the regions overlapping the page
+  std::map<address_t, size_t>::iterator it =
+      addr_region_map_.lower_bound(page_end);
+  while (it != addr_region_map_.begin()) {
+    --it;
+    address_t region_start = it->first;
+    address_t region_end = region_start + it->second;
+    if (region_end <= page)
+      break;
+    address_t start = region_start > page ? region_start : page;
+    address_t end = region_end < page_end ? region_end : page_end;
+    for (address_t granule = UNIT_DOWN_ALIGN(start, FILTER_GRANULE_SIZE);
+         granule < end; granule += FILTER_GRANULE_SIZE) {
+      uint8 *state = &states[(granule - page) / FILTER_GRANULE_SIZE];
+      if (granule >= region_start &&
+          granule + FILTER_GRANULE_SIZE <= region_end) {
+        // the granule is entirely inside the region
+        *state = STATE_FULL;
+      } else {
+        // the granule might be shared with neighboring regions
+        *state = ComputeState(granule, granule + FILTER_GRANULE_SIZE);
+      }
+    }
+  }
+
+  // the granule slots of a page are contiguous in one shadow page
+  uint8 *slots = granule_table_->Get(page);
+  for (size_t i = 0; i < FILTER_PAGE_SIZE / FILTER_GRANULE_SIZE; i++)
+    slots[i] = states[i];
+}
+
+void RegionFilter::UpdateRangeGranules(address_t page, address_t addr,
+                                       size_t size, bool add) {
+  // the caller should hold the internal lock. only the granules
+  // overlapping the added or removed region [addr, addr + size) change.
+  // regions never overlap, so a granule entirely inside the region is
+  // simply full (add) or not covered (remove).
+  address_t page_end = page + FILTER_PAGE_SIZE;
+  address_t start = addr > page ? addr : page;
+  address_t end = addr + size < page_end ? addr + size : page_end;
+  for (address_t granule = UNIT_DOWN_ALIGN(start, FILTER_GRANULE_SIZE);
+       granule < end; granule += FILTER_GRANULE_SIZE) {
+    uint8 state;
+    if (granule >= addr && granule + FILTER_GRANULE_SIZE <= addr + size)
+      state = add ? STATE_FULL : STATE_NONE;
+    else
+      state = ComputeState(granule, granule + FILTER_GRANULE_SIZE);
+    *granule_table_->Get(granule) = state;
+  }
+}
+
+void RegionFilter::ReleaseGranules(address_t page) {
+  // the caller should hold the internal lock. the granule states of a
+  // page are only used while the page is partial, so the shadow page
+  // holding them can be released once no page it covers is partial.
+  address_t start = UNIT_DOWN_ALIGN(page, SHADOW_PAGE_SIZE);
+  address_t end = start + SHADOW_PAGE_SIZE;
+  for (address_t ipage = start; ipage < end; ipage += FILTER_PAGE_SIZE) {
+    uint8 *state = page_table_->Find(ipage);
+    if (state && *state == STATE_PARTIAL)
+      return;
+  }
+  granule_table_->Release(start, SHADOW_PAGE_SIZE);
+}
+
+uint8 RegionFilter::ComputeState(address_t start, address_t end) {
+  // the caller should hold the internal lock
+  bool overlap = false;
+  std::map<address_t, size_t>::iterator it =
+      addr_region_map_.lower_bound(end);
+  while (it != addr_region_map_.begin()) {
+    --it;
+    address_t region_start = it->first;
+    address_t region_end = region_start + it->second;
+    if (region_end <= start)
+      break;
+    if (region_start <= start && region_end >= end)
+      return STATE_FULL;
+    overlap = true;
+  }
+  return overlap ? STATE_PARTIAL : STATE_NONE;
+}
+
+bool RegionFilter::FilterRegionMap(address_t addr) {
+  // the caller should hold the internal lock
   if (addr_region_map_.begin() == addr_region_map_.end())
     return true;
 
@@ -56,3 +253,25 @@ bool RegionFilter::Filter(address_t addr, bool locking) {
     return true;
 }
 
+
+AccessPredicate::AccessPredicate()
+    : bitmap_(NULL) {
+  bitmap_ = (uint8 *)calloc(PREDICATE_NUM_CHUNKS / 8, sizeof(uint8));
+}
+
+AccessPredicate::~AccessPredicate() {
+  free(bitmap_);
+}
+
+void AccessPredicate::AddRegion(address_t addr, size_t size) {
+  if (!size)
+    return;
+  address_t start_chunk = addr >> PREDICATE_CHUNK_SHIFT;
+  address_t end_chunk = (addr + size - 1) >> PREDICATE_CHUNK_SHIFT;
+  for (address_t chunk = start_chunk; chunk <= end_chunk; chunk++) {
+    address_t index = chunk & (PREDICATE_NUM_CHUNKS - 1);
+    uint8 mask = 1 << (index & 0x7);
+    if (!(bitmap_[index >> 3] & mask))
+      ATOMIC_OR_AND_FETCH(&bitmap_[index >> 3], mask);
+  }
+}
@@ -23,11 +23,34 @@
 
 #include "core/basictypes.h"
 #include "core/sync.h"
+#include "core/shadow_memory.h"
 
+// the granularity of the region filter states. a page is fully
+// covered, not covered or partially covered by the regions, and only
+// the partially covered pages keep the states of their granules.
+#define FILTER_PAGE_SIZE 4096
+#define FILTER_GRANULE_SIZE 8
+
+// the layout of the access predicate bitmap (one bit per chunk)
+#define PREDICATE_ADDR_BITS 48
+#define PREDICATE_CHUNK_SHIFT 24
+#define PREDICATE_NUM_CHUNKS \
+    (static_cast<address_t>(1) << (PREDICATE_ADDR_BITS - PREDICATE_CHUNK_SHIFT))
+
+// The region filter tracks a set of non-overlapping address regions.
+// Besides the ordered region map, it keeps a state for each page of the
+// address space, telling whether the page is fully covered, not
+// covered, or partially covered by the regions. A partially covered
+// page (at the boundary of a region) also keeps such a state for each
+// of its granules. Filter only reads the states without locking,
+// unless the granule is partially covered. Updating the regions is
+// serialized by the internal lock, and only touches the boundary pages
+// plus one state per page inside the region. The granules of a page
+// that is already partial are updated only where the region overlaps.
 class RegionFilter {
  public:
-  explicit RegionFilter(Mutex *lock) : internal_lock_(lock) {}
-  ~RegionFilter() { delete internal_lock_; }
+  explicit RegionFilter(Mutex *lock);
+  ~RegionFilter();
 
   void AddRegion(address_t addr, size_t size) { AddRegion(addr, size, true); }
   size_t RemoveRegion(address_t addr) { return RemoveRegion(addr, true); }
@@ -38,11 +61,54 @@ class RegionFilter {
   bool Filter(address_t addr, bool locking);
 
  private:
+  enum State {
+    STATE_NONE = 0,
+    STATE_FULL,
+    STATE_PARTIAL
+  };
+
+  void UpdateStates(address_t addr, size_t size, bool add);
+  void UpdateBoundaryPage(address_t page, address_t addr, size_t size,
+                          bool add);
+  void UpdatePageGranules(address_t page);
+  void UpdateRangeGranules(address_t page, address_t addr, size_t size,
+                           bool add);
+  void ReleaseGranules(address_t page);
+  uint8 ComputeState(address_t start, address_t end);
+  bool FilterRegionMap(address_t addr);
+
   Mutex *internal_lock_;
   std::map<address_t, size_t> addr_region_map_;
+  ShadowMemory<uint8> *page_table_;
+  ShadowMemory<uint8> *granule_table_; // only for the partial pages
 
   DISALLOW_COPY_CONSTRUCTORS(RegionFilter);
 };
 
-#endif
+// The access predicate is a coarse and conservative summary of the
+// regions monitored by the analyzers: one bit for each chunk of the
+// address space, set if the chunk contains any monitored region. Bits
+// are never cleared. Check has no branches and no calls, so that it
+// can be inlined by the instrumentation framework to drop the
+// accesses that no analyzer cares about.
+class AccessPredicate {
+ public:
+  AccessPredicate();
+  ~AccessPredicate();
+
+  void AddRegion(address_t addr, size_t size);
+  uint8 *bitmap() { return bitmap_; }
 
+  static bool Check(uint8 *bitmap, address_t addr) {
+    address_t chunk = (addr >> PREDICATE_CHUNK_SHIFT) &
+                      (PREDICATE_NUM_CHUNKS - 1);
+    return (bitmap[chunk >> 3] >> (chunk & 0x7)) & 0x1;
+  }
+
+ private:
+  uint8 *bitmap_;
+
+  DISALLOW_COPY_CONSTRUCTORS(AccessPredicate);
+};
+
+#endif
@@ -0,0 +1,53 @@
+// Copyright 2011 The University of Michigan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Authors - Jie Yu (jieyu@umich.edu)
+
+
+// File: core/inst_sharing_db.h - Define the interface of the databases
+// that know which instructions access shared memory.
+
+#ifndef CORE_INST_SHARING_DB_H_
+#define CORE_INST_SHARING_DB_H_
+
+#include <string>
+
+#include "core/basictypes.h"
+#include "core/static_info.h"
+
+// The interface of a database that records which memory instructions
+// have been profiled, and which of them access shared memory. It lets
+// the execution control prune the thread local instructions (see
+// sinst_prune) without depending on the profiler that fills the
+// database (see sinst::SharedInstDB). All the methods are thread safe.
+class InstSharingDB {
+ public:
+  InstSharingDB() {}
+  virtual ~InstSharingDB() {}
+
+  // return whether the sharing of the inst has been profiled
+  virtual bool Profiled(Inst *inst) = 0;
+  virtual void SetProfiled(Inst *inst) = 0;
+  // return whether the inst has been found accessing shared memory
+  virtual bool Shared(Inst *inst) = 0;
+  virtual void SetShared(Inst *inst) = 0;
+  virtual void Load(const std::string &db_name, StaticInfo *sinfo) = 0;
+  virtual void Save(const std::string &db_name, StaticInfo *sinfo) = 0;
+
+ private:
+  DISALLOW_COPY_CONSTRUCTORS(InstSharingDB);
+};
+
+#endif
+
@@ -47,5 +47,41 @@ class Knob {
   DISALLOW_COPY_CONSTRUCTORS(Knob);
 };
 
+// Typed handles of the registered knobs. The knob values do not change
+// once the command line is parsed, so a handle looks up the value once
+// when it is bound (usually in HandlePostSetup) and caches it. Use them
+// for the knobs that are read in the analysis routines.
+class BoolKnob {
+ public:
+  BoolKnob() : value_(false) {}
+  ~BoolKnob() {}
+
+  void Bind(Knob *knob, const std::string &name) {
+    value_ = knob->ValueBool(name);
+  }
+  bool Value() { return value_; }
+
+ private:
+  bool value_;
+
+  DISALLOW_COPY_CONSTRUCTORS(BoolKnob);
+};
+
+class IntKnob {
+ public:
+  IntKnob() : value_(0) {}
+  ~IntKnob() {}
+
+  void Bind(Knob *knob, const std::string &name) {
+    value_ = knob->ValueInt(name);
+  }
+  int Value() { return value_; }
+
+ private:
+  int value_;
+
+  DISALLOW_COPY_CONSTRUCTORS(IntKnob);
+};
+
 #endif
 
@@ -18,6 +18,14 @@
 
 #include "core/logging.h"
 
+#include <sys/time.h>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "core/atomic.h"
+
 void StdLogFile::Open() {
   if (name_.compare("stdout") == 0)
     out_ = &std::cout;
@@ -25,6 +33,149 @@ void StdLogFile::Open() {
     out_ = &std::cerr;
 }
 
+AsyncFileLogFile::ThreadIdFunc AsyncFileLogFile::thread_id_func_ = NULL;
+
+AsyncFileLogFile::AsyncFileLogFile(const std::string &name, Mutex *drain_lock)
+    : LogFile(name),
+      drain_lock_(drain_lock),
+      rings_(NULL),
+      dropped_(0),
+      reported_dropped_(0) {
+  void *ptr = NULL;
+  size_t size = sizeof(Ring) * ASYNC_LOG_NUM_RINGS;
+  if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0)
+    assert(0);
+  memset(ptr, 0, size);
+  rings_ = (Ring *)ptr;
+  for (int r = 0; r < ASYNC_LOG_NUM_RINGS; r++) {
+    for (int i = 0; i < ASYNC_LOG_RING_SIZE; i++)
+      rings_[r].records[i].seq = i;
+  }
+}
+
+AsyncFileLogFile::~AsyncFileLogFile() {
+  free(rings_);
+  delete drain_lock_;
+}
+
+void AsyncFileLogFile::Close() {
+  Sync();
+  ScopedLock locker(drain_lock_);
+  out_.close();
+}
+
+void AsyncFileLogFile::Write(const std::string &msg) {
+  thread_id_t thd_id = thread_id_func_ ? thread_id_func_() : 0;
+  Ring *ring = &rings_[thd_id % ASYNC_LOG_NUM_RINGS];
+
+  // claim a record (the ring is shared by the threads that map to it)
+  Record *rec = NULL;
+  uint64 pos = ring->tail;
+  while (true) {
+    rec = &ring->records[pos & (ASYNC_LOG_RING_SIZE - 1)];
+    int64 diff = (int64)(rec->seq - pos);
+    if (diff == 0) {
+      if (ATOMIC_BOOL_COMPARE_AND_SWAP(&ring->tail, pos, pos + 1))
+        break;
+      pos = ring->tail;
+    } else if (diff < 0) {
+      // the ring is full, drop the message
+      ATOMIC_FETCH_AND_ADD(&dropped_, 1);
+      return;
+    } else {
+      pos = ring->tail;
+    }
+  }
+
+  // fill and publish the record
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  rec->time = (uint64)tv.tv_sec * 1000000 + tv.tv_usec;
+  rec->thd_id = thd_id;
+  if (msg.size() <= ASYNC_LOG_MSG_SIZE) {
+    rec->length = msg.size();
+    memcpy(rec->msg, msg.data(), rec->length);
+  } else {
+    // keep the trailing newline so that the next message still starts
+    // on its own line, and mark the message as truncated
+    size_t marker_length = strlen(ASYNC_LOG_TRUNC_MARKER);
+    bool newline = msg[msg.size() - 1] == '\n';
+    size_t length = ASYNC_LOG_MSG_SIZE - marker_length - (newline ? 1 : 0);
+    memcpy(rec->msg, msg.data(), length);
+    memcpy(rec->msg + length, ASYNC_LOG_TRUNC_MARKER, marker_length);
+    length += marker_length;
+    if (newline)
+      rec->msg[length++] = '\n';
+    rec->length = length;
+  }
+  MEMORY_BARRIER();
+  rec->seq = pos + 1;
+}
+
+void AsyncFileLogFile::Sync() {
+  Drain();
+  out_.flush();
+}
+
+size_t AsyncFileLogFile::Drain() {
+  ScopedLock locker(drain_lock_);
+
+  if (!out_.is_open())
+    return 0;
+
+  // merge the rings in time order
+  size_t num_written = 0;
+  while (true) {
+    Ring *next_ring = NULL;
+    Record *next_rec = NULL;
+    for (int r = 0; r < ASYNC_LOG_NUM_RINGS; r++) {
+      Record *rec = Peek(&rings_[r]);
+      if (rec && (!next_rec || rec->time < next_rec->time)) {
+        next_ring = &rings_[r];
+        next_rec = rec;
+      }
+    }
+    if (!next_rec)
+      break;
+
+    char header[64];
+    snprintf(header, 64, "[%lu.%06lu] [T%lu] ",
+             (unsigned long)(next_rec->time / 1000000),
+             (unsigned long)(next_rec->time % 1000000),
+             (unsigned long)next_rec->thd_id);
+    out_ << header;
+    out_.write(next_rec->msg, next_rec->length);
+    Pop(next_ring);
+    num_written++;
+  }
+
+  uint64 dropped = dropped_;
+  if (dropped != reported_dropped_) {
+    out_ << "[ASYNC] " << (dropped - reported_dropped_)
+         << " messages dropped" << std::endl;
+    reported_dropped_ = dropped;
+  }
+
+  if (num_written)
+    out_.flush();
+  return num_written;
+}
+
+AsyncFileLogFile::Record *AsyncFileLogFile::Peek(Ring *ring) {
+  Record *rec = &ring->records[ring->head & (ASYNC_LOG_RING_SIZE - 1)];
+  if (rec->seq != ring->head + 1)
+    return NULL;
+  MEMORY_BARRIER();
+  return rec;
+}
+
+void AsyncFileLogFile::Pop(Ring *ring) {
+  Record *rec = &ring->records[ring->head & (ASYNC_LOG_RING_SIZE - 1)];
+  MEMORY_BARRIER();
+  rec->seq = ring->head + ASYNC_LOG_RING_SIZE;
+  ring->head++;
+}
+
 LogType::LogType(bool enable, bool terminate, bool buffered,
                  const std::string &prefix)
     : enable_(enable),
@@ -42,22 +193,21 @@ void LogType::Message(const std::string &msg, bool print_prefix) {
        it != log_files_.end(); ++it) {
     LogFile *log_file = *it;
     if (log_file->IsOpen()) {
+      // write the prefix and the message at once so that they stay
+      // together in asynchronous log files
       if (print_prefix)
-        log_file->Write(prefix_);
-      log_file->Write(msg);
+        log_file->Write(prefix_ + msg);
+      else
+        log_file->Write(msg);
       if (!buffered_)
         log_file->Flush();
     }
   }
 
   if (terminate_) {
-    for (std::vector<LogFile *>::iterator it = log_files_.begin();
-       it != log_files_.end(); ++it) {
-      LogFile *log_file = *it;
-      if (log_file->IsOpen()) {
-        log_file->Flush();
-      }
-    }
+    // make sure all the pending messages (including those in the other
+    // logs) are written out before terminating
+    logging_sync();
     abort();
   }
 }
@@ -69,6 +219,14 @@ void LogType::CloseLogFiles() {
   }
 }
 
+void LogType::SyncLogFiles() {
+  for (std::vector<LogFile *>::iterator it = log_files_.begin();
+       it != log_files_.end(); ++it) {
+    if ((*it)->IsOpen())
+      (*it)->Sync();
+  }
+}
+
 // standard output/error stream
 LogFile *stdout_log_file = NULL;
 LogFile *stderr_log_file = NULL;
@@ -104,6 +262,8 @@ void logging_init(Mutex *lock) {
 }
 
 void logging_fini() {
+  logging_sync();
+
   assertion_log->Disable();
   debug_log->Disable();
   info_log->Disable();
@@ -112,3 +272,9 @@ void logging_fini() {
   stderr_log_file->Close();
 }
 
+void logging_sync() {
+  assertion_log->SyncLogFiles();
+  debug_log->SyncLogFiles();
+  info_log->SyncLogFiles();
+}
+
@@ -39,6 +39,9 @@ class LogFile {
   virtual void Write(const std::string &msg) = 0;
   virtual void Flush() = 0;
   virtual bool IsOpen() = 0;
+  // Make sure every message written so far has reached the output.
+  // Different from Flush, it never returns before that happens.
+  virtual void Sync() { Flush(); }
 
  protected:
   std::string name_;
@@ -83,6 +86,69 @@ class StdLogFile : public LogFile {
   DISALLOW_COPY_CONSTRUCTORS(StdLogFile);
 };
 
+// Define asynchronous file log file. Writers copy each message into a
+// bounded lock free ring (selected by the writer's thread id) and
+// return without touching the file. The rings are drained into the
+// file by Drain, which is expected to be called periodically by a
+// background thread. When a ring is full, the message is dropped and
+// counted, so that the writers never block. Messages longer than
+// ASYNC_LOG_MSG_SIZE are truncated and end with ASYNC_LOG_TRUNC_MARKER.
+#define ASYNC_LOG_NUM_RINGS 16
+#define ASYNC_LOG_RING_SIZE 256 // must be a power of 2
+#define ASYNC_LOG_MSG_SIZE 480
+#define ASYNC_LOG_TRUNC_MARKER " [truncated]"
+
+class AsyncFileLogFile : public LogFile {
+ public:
+  typedef thread_id_t (*ThreadIdFunc)();
+
+  AsyncFileLogFile(const std::string &name, Mutex *drain_lock);
+  ~AsyncFileLogFile();
+
+  void Open() { out_.open(name_.c_str()); }
+  void Close();
+  void Write(const std::string &msg);
+  void Flush() {} // the messages are written by Drain
+  bool IsOpen() { return out_.is_open(); }
+  void Sync();
+  // Write all the published messages to the file. Return the number
+  // of messages written.
+  size_t Drain();
+  uint64 dropped() { return dropped_; }
+
+  static void SetThreadIdFunc(ThreadIdFunc func) { thread_id_func_ = func; }
+
+ private:
+  struct Record {
+    volatile uint64 seq; // the ring position this record is ready for
+    uint64 time; // in micro seconds
+    thread_id_t thd_id;
+    size_t length;
+    char msg[ASYNC_LOG_MSG_SIZE];
+  };
+
+  // the writers and the drainer update tail and head respectively, so
+  // they are kept on separate cache lines
+  struct Ring {
+    volatile uint64 tail CACHE_LINE_ALIGNED; // the next position to write
+    uint64 head CACHE_LINE_ALIGNED; // the next position to drain (drain lock)
+    Record records[ASYNC_LOG_RING_SIZE] CACHE_LINE_ALIGNED;
+  } CACHE_LINE_ALIGNED;
+
+  Record *Peek(Ring *ring);
+  void Pop(Ring *ring);
+
+  Mutex *drain_lock_;
+  Ring *rings_;
+  volatile uint64 dropped_;
+  uint64 reported_dropped_; // (drain lock)
+  std::ofstream out_;
+
+  static ThreadIdFunc thread_id_func_;
+
+  DISALLOW_COPY_CONSTRUCTORS(AsyncFileLogFile);
+};
+
 // Define a log. A log can have multiple log files so that it can write
 // to multiple output ports.
 class LogType {
@@ -98,6 +164,7 @@ class LogType {
   void Enable() { enable_ = true; }
   void Disable() { enable_ = false; }
   void CloseLogFiles();
+  void SyncLogFiles();
 
  private:
   bool enable_;
@@ -119,6 +186,7 @@ extern Mutex *g_print_lock;
 
 extern void logging_init(Mutex *lock);
 extern void logging_fini();
+extern void logging_sync();
 
 #define LOG_MSG(log,msg) do { \
     if ((log)->On()) \
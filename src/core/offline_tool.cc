@@ -46,6 +46,7 @@ void OfflineTool::PreSetup() {
   knob_->RegisterStr("debug_out", "the output file for the debug messages", "stdout");
   knob_->RegisterStr("sinfo_in", "the input static info database path", "sinfo.db");
   knob_->RegisterStr("sinfo_out", "the output static info database path", "sinfo.db");
+  knob_->RegisterBool("sinfo_indexed", "whether save the static info database in the indexed (memory mapped) format", "0");
 
   HandlePreSetup();
 }
@@ -68,6 +69,8 @@ void OfflineTool::PostSetup() {
   // load static info
   sinfo_ = new StaticInfo(CreateMutex());
   sinfo_->Load(knob_->ValueStr("sinfo_in"));
+  if (knob_->ValueBool("sinfo_indexed"))
+    sinfo_->set_indexed(true);
 
   HandlePostSetup();
 }
@@ -39,6 +39,7 @@ class OfflineTool {
 
  protected:
   virtual Mutex *CreateMutex() { return new NullMutex; }
+  virtual RWMutex *CreateRWMutex() { return new NullRWMutex; }
   virtual void HandlePreSetup();
   virtual void HandlePostSetup();
   virtual void HandleStart();
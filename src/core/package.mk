@@ -19,6 +19,8 @@ srcs += \
   core/stat.cc \
   core/static_info.cc \
   core/static_info.pb.cc \
+  core/static_info_index.cc \
+  core/thread_index.cc \
   core/vector_clock.cc \
   core/wrapper.cpp
 
@@ -38,6 +40,8 @@ core_objs := \
   core/stat.o \
   core/static_info.o \
   core/static_info.pb.o \
+  core/static_info_index.o \
+  core/thread_index.o \
   core/vector_clock.o \
   core/wrapper.o
 
@@ -54,5 +58,7 @@ core_cmd_objs := \
   core/stat.o \
   core/static_info.o \
   core/static_info.pb.o \
+  core/static_info_index.o \
+  core/thread_index.o \
   core/vector_clock.o \
 
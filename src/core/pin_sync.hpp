@@ -42,5 +42,24 @@ class PinMutex : public Mutex {
   DISALLOW_COPY_CONSTRUCTORS(PinMutex);
 };
 
+// Define PIN read-write mutex.
+class PinRWMutex : public RWMutex {
+ public:
+  PinRWMutex() { PIN_RWMutexInit(&lock_); }
+  ~PinRWMutex() { PIN_RWMutexFini(&lock_); }
+
+  void LockRead() { PIN_RWMutexReadLock(&lock_); }
+  void UnlockRead() { PIN_RWMutexUnlock(&lock_); }
+  void LockWrite() { PIN_RWMutexWriteLock(&lock_); }
+  void UnlockWrite() { PIN_RWMutexUnlock(&lock_); }
+  RWMutex *Clone() { return new PinRWMutex; }
+
+ protected:
+  PIN_RWMUTEX lock_;
+
+ private:
+  DISALLOW_COPY_CONSTRUCTORS(PinRWMutex);
+};
+
 #endif
 
@@ -61,4 +61,3 @@ bool BBLContainMemOp(BBL bbl) {
   }
   return false;
 }
-
@@ -0,0 +1,149 @@
+// Copyright 2011 The University of Michigan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Authors - Jie Yu (jieyu@umich.edu)
+
+// File: core/read_mostly_set.h - Define the read mostly pointer set.
+
+#ifndef CORE_READ_MOSTLY_SET_H_
+#define CORE_READ_MOSTLY_SET_H_
+
+#include "core/basictypes.h"
+#include "core/atomic.h"
+
+// the initial number of slots of the set (a power of two)
+#define READ_MOSTLY_SET_INIT_SIZE 1024
+
+// The read mostly set is a set of pointers in which lookups never
+// block. It is an open addressing hash table. Lookups are lock free,
+// while insertions should be serialized by the caller. When the table
+// is half full, a copy twice as large is built and published
+// atomically (read-copy-update). The old tables are retired but not
+// freed until the set is destroyed, since lookups might still be
+// reading them. As the tables double in size, the retired ones take no
+// more memory than the current one. Pointers are never removed.
+template <typename T>
+class ReadMostlySet {
+ public:
+  ReadMostlySet();
+  ~ReadMostlySet();
+
+  // return whether the pointer is in the set (lock free)
+  bool Contains(T *key);
+  // insert the pointer, return false if it is already in the set. the
+  // caller should serialize the insertions.
+  bool Insert(T *key);
+
+  size_t size() { return size_; }
+
+ private:
+  struct Table {
+    size_t num_slots;
+    T *volatile *slots;
+    Table *retired; // the previous table
+  };
+
+  static size_t Hash(T *key) {
+    return static_cast<size_t>(
+        ((uint64)(size_t)key * 0x9e3779b97f4a7c15ULL) >> 32);
+  }
+  static Table *NewTable(size_t num_slots, Table *retired);
+  static bool InsertToTable(Table *table, T *key);
+
+  Table *volatile table_;
+  size_t size_;
+
+  DISALLOW_COPY_CONSTRUCTORS(ReadMostlySet);
+};
+
+template <typename T>
+ReadMostlySet<T>::ReadMostlySet()
+    : table_(NULL),
+      size_(0) {
+  table_ = NewTable(READ_MOSTLY_SET_INIT_SIZE, NULL);
+}
+
+template <typename T>
+ReadMostlySet<T>::~ReadMostlySet() {
+  Table *table = table_;
+  while (table) {
+    Table *retired = table->retired;
+    delete [] table->slots;
+    delete table;
+    table = retired;
+  }
+}
+
+template <typename T>
+bool ReadMostlySet<T>::Contains(T *key) {
+  Table *table = table_;
+  size_t mask = table->num_slots - 1;
+  for (size_t pos = Hash(key) & mask; ; pos = (pos + 1) & mask) {
+    T *slot = table->slots[pos];
+    if (slot == key)
+      return true;
+    if (!slot)
+      return false;
+  }
+}
+
+template <typename T>
+bool ReadMostlySet<T>::Insert(T *key) {
+  if (Contains(key))
+    return false;
+
+  Table *table = table_;
+  if ((size_ + 1) * 2 > table->num_slots) {
+    // copy to a larger table and publish it after it is filled
+    Table *new_table = NewTable(table->num_slots * 2, table);
+    for (size_t i = 0; i < table->num_slots; i++) {
+      if (table->slots[i])
+        InsertToTable(new_table, table->slots[i]);
+    }
+    MEMORY_BARRIER();
+    table_ = new_table;
+    table = new_table;
+  }
+  InsertToTable(table, key);
+  size_++;
+  return true;
+}
+
+template <typename T>
+typename ReadMostlySet<T>::Table *ReadMostlySet<T>::NewTable(
+    size_t num_slots, Table *retired) {
+  Table *table = new Table;
+  table->num_slots = num_slots;
+  table->slots = new T *volatile[num_slots]();
+  table->retired = retired;
+  return table;
+}
+
+template <typename T>
+bool ReadMostlySet<T>::InsertToTable(Table *table, T *key) {
+  size_t mask = table->num_slots - 1;
+  for (size_t pos = Hash(key) & mask; ; pos = (pos + 1) & mask) {
+    T *slot = table->slots[pos];
+    if (slot == key)
+      return false;
+    if (!slot) {
+      // a slot is a single word, readers see either NULL or the key
+      table->slots[pos] = key;
+      return true;
+    }
+  }
+}
+
+#endif
+
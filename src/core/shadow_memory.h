@@ -0,0 +1,247 @@
+// Copyright 2011 The University of Michigan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Authors - Jie Yu (jieyu@umich.edu)
+
+
+// File: core/shadow_memory.h - Define the direct-mapped shadow memory.
+
+#ifndef CORE_SHADOW_MEMORY_H_
+#define CORE_SHADOW_MEMORY_H_
+
+#include <cstring>
+#include <vector>
+
+#include "core/basictypes.h"
+#include "core/atomic.h"
+
+// the layout of the shadow memory. an address is split into a top
+// level directory index (bits 32 to 47), a second level directory
+// index (bits 16 to 31) and an offset within the shadow page (bits 0
+// to 15).
+#define SHADOW_ADDR_BITS 48
+#define SHADOW_DIR_SHIFT 32
+#define SHADOW_PAGE_SHIFT 16
+#define SHADOW_NUM_DIRS (1UL << (SHADOW_ADDR_BITS - SHADOW_DIR_SHIFT))
+#define SHADOW_DIR_SIZE (1UL << (SHADOW_DIR_SHIFT - SHADOW_PAGE_SHIFT))
+#define SHADOW_PAGE_SIZE (1UL << SHADOW_PAGE_SHIFT)
+
+// The shadow memory maps each unit of the application address space
+// to a slot of type T. Slots are stored in shadow pages, which are
+// contiguous arrays allocated lazily when a unit in the page is first
+// touched. Finding a slot only involves indexing into the directories
+// and the page (no hashing). Allocating the directories and pages is
+// lock free. Accesses to the slots should be synchronized by the
+// caller. T should be a plain data type whose zero value means empty,
+// for example, a pointer to the meta data.
+template <typename T>
+class ShadowMemory {
+ public:
+  explicit ShadowMemory(size_t unit_size);
+  ~ShadowMemory();
+
+  // return the slot of the unit containing addr. return NULL if the
+  // shadow page has not been allocated.
+  T *Find(address_t addr);
+  // return the slot of the unit containing addr. allocate the shadow
+  // page if necessary.
+  T *Get(address_t addr);
+  // return the first non-empty slot of the units in the region
+  // [addr, end_addr), and store the address of its unit in unit_addr.
+  // return NULL if there is none. shadow pages that have not been
+  // allocated are skipped without looking at their units.
+  T *FindNext(address_t addr, address_t end_addr, address_t *unit_addr);
+  // release the shadow pages that are entirely covered by the region
+  // [addr, addr + size). the caller should have cleared the slots in
+  // the region. the released pages are not freed, but kept in a free
+  // list and reused by Get, so that the threads that still hold a slot
+  // in them (racing with the release) never touch freed memory.
+  void Release(address_t addr, size_t size);
+
+  size_t unit_size() { return unit_size_; }
+
+ private:
+  typedef T *Page;
+  typedef Page *Dir;
+
+  size_t TopIndex(address_t addr) {
+    return (static_cast<uint64>(addr) >> SHADOW_DIR_SHIFT) &
+           (SHADOW_NUM_DIRS - 1);
+  }
+  size_t DirIndex(address_t addr) {
+    return (addr >> SHADOW_PAGE_SHIFT) & (SHADOW_DIR_SIZE - 1);
+  }
+  size_t PageIndex(address_t addr) {
+    return (addr & (SHADOW_PAGE_SIZE - 1)) >> unit_shift_;
+  }
+  size_t PageSlots() { return SHADOW_PAGE_SIZE >> unit_shift_; }
+  Dir AllocDir(size_t top_idx);
+  Page AllocPage(Dir dir, size_t dir_idx);
+  void LockFreePages() {
+    while (ATOMIC_LOCK_TEST_AND_SET(&free_pages_lock_, 1))
+      ;
+  }
+  void UnlockFreePages() {
+    MEMORY_BARRIER();
+    free_pages_lock_ = 0;
+  }
+
+  size_t unit_size_;
+  size_t unit_shift_;
+  Dir *dirs_;
+  volatile int free_pages_lock_; // a spin lock protecting free_pages_
+  std::vector<Page> free_pages_;
+
+  DISALLOW_COPY_CONSTRUCTORS(ShadowMemory);
+};
+
+template <typename T>
+ShadowMemory<T>::ShadowMemory(size_t unit_size)
+    : unit_size_(unit_size),
+      unit_shift_(0),
+      dirs_(NULL),
+      free_pages_lock_(0) {
+  while ((1UL << unit_shift_) < unit_size_)
+    unit_shift_++;
+  // the unit size should be a power of two no larger than a page
+  assert((1UL << unit_shift_) == unit_size_);
+  assert(unit_size_ <= SHADOW_PAGE_SIZE);
+  dirs_ = new Dir[SHADOW_NUM_DIRS]();
+}
+
+template <typename T>
+ShadowMemory<T>::~ShadowMemory() {
+  for (size_t i = 0; i < SHADOW_NUM_DIRS; i++) {
+    Dir dir = dirs_[i];
+    if (!dir)
+      continue;
+    for (size_t j = 0; j < SHADOW_DIR_SIZE; j++)
+      delete [] dir[j];
+    delete [] dir;
+  }
+  delete [] dirs_;
+  for (size_t i = 0; i < free_pages_.size(); i++)
+    delete [] free_pages_[i];
+}
+
+template <typename T>
+T *ShadowMemory<T>::Find(address_t addr) {
+  Dir dir = dirs_[TopIndex(addr)];
+  if (!dir)
+    return NULL;
+  Page page = dir[DirIndex(addr)];
+  if (!page)
+    return NULL;
+  return &page[PageIndex(addr)];
+}
+
+template <typename T>
+T *ShadowMemory<T>::Get(address_t addr) {
+  size_t top_idx = TopIndex(addr);
+  Dir dir = dirs_[top_idx];
+  if (!dir)
+    dir = AllocDir(top_idx);
+  size_t dir_idx = DirIndex(addr);
+  Page page = dir[dir_idx];
+  if (!page)
+    page = AllocPage(dir, dir_idx);
+  return &page[PageIndex(addr)];
+}
+
+template <typename T>
+T *ShadowMemory<T>::FindNext(address_t addr, address_t end_addr,
+                            address_t *unit_addr) {
+  addr = UNIT_DOWN_ALIGN(addr, unit_size_);
+  while (addr < end_addr) {
+    address_t page_end = UNIT_DOWN_ALIGN(addr, SHADOW_PAGE_SIZE) +
+                         SHADOW_PAGE_SIZE;
+    if (page_end > end_addr || page_end < addr)
+      page_end = end_addr;
+    Dir dir = dirs_[TopIndex(addr)];
+    Page page = dir ? dir[DirIndex(addr)] : NULL;
+    if (page) {
+      for (; addr < page_end; addr += unit_size_) {
+        T *slot = &page[PageIndex(addr)];
+        if (*slot) {
+          *unit_addr = addr;
+          return slot;
+        }
+      }
+    }
+    addr = page_end;
+  }
+  return NULL;
+}
+
+template <typename T>
+void ShadowMemory<T>::Release(address_t addr, size_t size) {
+  // only release the pages that are entirely covered
+  address_t start_addr = UNIT_UP_ALIGN(addr, SHADOW_PAGE_SIZE);
+  address_t end_addr = UNIT_DOWN_ALIGN(addr + size, SHADOW_PAGE_SIZE);
+  for (address_t iaddr = start_addr; iaddr < end_addr;
+       iaddr += SHADOW_PAGE_SIZE) {
+    Dir dir = dirs_[TopIndex(iaddr)];
+    if (!dir)
+      continue;
+    size_t dir_idx = DirIndex(iaddr);
+    Page page = dir[dir_idx];
+    if (!page)
+      continue;
+    if (ATOMIC_BOOL_COMPARE_AND_SWAP(&dir[dir_idx], page, (Page)NULL)) {
+      LockFreePages();
+      free_pages_.push_back(page);
+      UnlockFreePages();
+    }
+  }
+}
+
+template <typename T>
+typename ShadowMemory<T>::Dir ShadowMemory<T>::AllocDir(size_t top_idx) {
+  Dir dir = new Page[SHADOW_DIR_SIZE]();
+  if (!ATOMIC_BOOL_COMPARE_AND_SWAP(&dirs_[top_idx], (Dir)NULL, dir)) {
+    // another thread has allocated the directory
+    delete [] dir;
+    dir = dirs_[top_idx];
+  }
+  return dir;
+}
+
+template <typename T>
+typename ShadowMemory<T>::Page ShadowMemory<T>::AllocPage(Dir dir,
+                                                          size_t dir_idx) {
+  Page page = NULL;
+  LockFreePages();
+  if (!free_pages_.empty()) {
+    page = free_pages_.back();
+    free_pages_.pop_back();
+  }
+  UnlockFreePages();
+  if (page) {
+    // a late thread might have written the page after it was released
+    memset(page, 0, sizeof(T) * PageSlots());
+  } else {
+    page = new T[PageSlots()]();
+  }
+  if (!ATOMIC_BOOL_COMPARE_AND_SWAP(&dir[dir_idx], (Page)NULL, page)) {
+    // another thread has allocated the page
+    LockFreePages();
+    free_pages_.push_back(page);
+    UnlockFreePages();
+    page = dir[dir_idx];
+  }
+  return page;
+}
+
+#endif
+
@@ -18,10 +18,26 @@
 
 #include "core/stat.h"
 
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
+#include <sstream>
 #include <algorithm>
 
+Stat::Stat(Mutex *lock)
+    : internal_lock_(lock),
+      shards_(NULL),
+      next_slot_(STAT_SINK_ID + STAT_HIST_BUCKETS) {
+  void *ptr = NULL;
+  size_t size = sizeof(Shard) * STAT_NUM_SHARDS;
+  if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0)
+    assert(0);
+  memset(ptr, 0, size);
+  shards_ = (Shard *)ptr;
+}
+
 void Stat::Inc(std::string var, Stat::Int i, bool locking) {
   ScopedLock locker(internal_lock_, locking);
   IntTable::iterator it = int_table_.find(var);
@@ -51,7 +67,58 @@ void Stat::Min(std::string var, Stat::Int i, bool locking) {
 
 void Stat::Rec(std::string var, Stat::Int i, bool locking) {
   ScopedLock locker(internal_lock_, locking);
-  int_vec_table_[var].push_back(i);
+  Histogram &hist = hist_table_[var];
+  if (hist.empty())
+    hist.resize(STAT_HIST_BUCKETS, 0);
+  hist[HistBucket(i)]++;
+}
+
+Stat::Id Stat::Register(const std::string &var, Stat::Type type) {
+  ScopedLock locker(internal_lock_);
+  for (EntryVec::iterator it = entry_vec_.begin();
+       it != entry_vec_.end(); ++it) {
+    if (it->var == var)
+      return it->id;
+  }
+
+  // Use the sink if running out of slots (not displayed).
+  size_t num_slots = type == STAT_TYPE_REC ? STAT_HIST_BUCKETS : 1;
+  if (next_slot_ + num_slots > STAT_MAX_SLOTS)
+    return STAT_SINK_ID;
+
+  Entry entry;
+  entry.var = var;
+  entry.type = type;
+  entry.id = next_slot_;
+  next_slot_ += num_slots;
+  entry_vec_.push_back(entry);
+
+  // The initial value of a min statistic is the largest value.
+  if (type == STAT_TYPE_MIN) {
+    for (size_t s = 0; s < STAT_NUM_SHARDS; s++)
+      shards_[s].slots[entry.id] = (Int)-1;
+  }
+  return entry.id;
+}
+
+void Stat::Max(Stat::Id id, thread_id_t thd_id, Stat::Int i) {
+  volatile Int *slot = &GetShard(thd_id)->slots[id];
+  Int curr = *slot;
+  while (i > curr) {
+    if (ATOMIC_BOOL_COMPARE_AND_SWAP(slot, curr, i))
+      break;
+    curr = *slot;
+  }
+}
+
+void Stat::Min(Stat::Id id, thread_id_t thd_id, Stat::Int i) {
+  volatile Int *slot = &GetShard(thd_id)->slots[id];
+  Int curr = *slot;
+  while (i < curr) {
+    if (ATOMIC_BOOL_COMPARE_AND_SWAP(slot, curr, i))
+      break;
+    curr = *slot;
+  }
 }
 
 void Stat::Display(const std::string &fname) {
@@ -66,24 +133,71 @@ void Stat::Display(const std::string &fname) {
     out << std::setw(20) << tit->first;
     out << tit->second << std::endl;
   }
-  // display int vec table
-  for (IntVecTable::iterator tit = int_vec_table_.begin();
-       tit != int_vec_table_.end(); ++tit) {
-    IntVec &vec = tit->second;
-    sort(vec.begin(), vec.end());
-    out << std::setw(20) << tit->first;
-    out << vec.size() << std::endl;
-    size_t detail_level = 10;
-    for (size_t i = 0; i < detail_level; i++) {
-      double ratio = (double)(i + 1) / (double)detail_level;
-      size_t idx = (size_t)((double)(vec.size() - 1) * ratio);
-      out << "  " << std::setw(18) << idx;
-      out << vec[idx] << std::endl;
+  // display histogram table
+  for (HistogramTable::iterator tit = hist_table_.begin();
+       tit != hist_table_.end(); ++tit) {
+    DisplayHistogram(out, tit->first, tit->second);
+  }
+  // display registered statistics (aggregate the shards)
+  for (EntryVec::iterator it = entry_vec_.begin();
+       it != entry_vec_.end(); ++it) {
+    if (it->type == STAT_TYPE_REC) {
+      Histogram hist(STAT_HIST_BUCKETS, 0);
+      for (size_t s = 0; s < STAT_NUM_SHARDS; s++) {
+        for (size_t b = 0; b < STAT_HIST_BUCKETS; b++)
+          hist[b] += shards_[s].slots[it->id + b];
+      }
+      DisplayHistogram(out, it->var, hist);
+      continue;
     }
+
+    Int value = shards_[0].slots[it->id];
+    for (size_t s = 1; s < STAT_NUM_SHARDS; s++) {
+      Int shard_value = shards_[s].slots[it->id];
+      switch (it->type) {
+        case STAT_TYPE_INC:
+          value += shard_value;
+          break;
+        case STAT_TYPE_MAX:
+          value = MAX(value, shard_value);
+          break;
+        case STAT_TYPE_MIN:
+          value = MIN(value, shard_value);
+          break;
+        default:
+          break;
+      }
+    }
+    // a min statistic still holding its initial value is never updated
+    if (it->type == STAT_TYPE_MIN && value == (Int)-1)
+      value = 0;
+    out << std::setw(20) << it->var;
+    out << value << std::endl;
   }
   out.close();
 }
 
+void Stat::DisplayHistogram(std::ostream &out, const std::string &var,
+                            const Histogram &hist) {
+  Int total = 0;
+  for (size_t b = 0; b < hist.size(); b++)
+    total += hist[b];
+  out << std::setw(20) << var;
+  out << total << std::endl;
+  // display the non-empty buckets by their upper bounds
+  for (size_t b = 0; b < hist.size(); b++) {
+    if (!hist[b])
+      continue;
+    std::stringstream bound;
+    if (b == 0)
+      bound << "0";
+    else
+      bound << "< 2^" << b;
+    out << "  " << std::setw(18) << bound.str();
+    out << hist[b] << std::endl;
+  }
+}
+
 // global variables and definitions
 Stat *g_stat = NULL;
 
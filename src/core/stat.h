@@ -19,12 +19,15 @@
 #ifndef CORE_STAT_H_
 #define CORE_STAT_H_
 
+#include <iostream>
 #include <map>
 #include <vector>
 #include <tr1/unordered_map>
 
 #include "core/basictypes.h"
+#include "core/atomic.h"
 #include "core/sync.h"
+#include "core/thread_index.h"
 
 #ifndef MAX
 #define MAX(a, b) (((a)>(b)) ? (a) : (b))
@@ -34,29 +37,94 @@
 #define MIN(a, b) (((a)<(b)) ? (a) : (b))
 #endif
 
+// The limits of the registered statistics. Each counter takes one slot
+// and each histogram takes STAT_HIST_BUCKETS slots. The first
+// STAT_HIST_BUCKETS slots are a sink (never displayed) shared by the
+// statistics that cannot be registered, so that their updates, including
+// those of a histogram, never touch the slots of the other statistics.
+#define STAT_MAX_SLOTS 1024
+#define STAT_NUM_SHARDS 64
+#define STAT_HIST_BUCKETS 65
+#define STAT_SINK_ID 0
+
 // The class for statistics
 class Stat {
  public:
   typedef uint64 Int;
   typedef double Float;
+  typedef size_t Id; // the handle of a registered statistic
+
+  typedef enum {
+    STAT_TYPE_INC = 0,
+    STAT_TYPE_MAX,
+    STAT_TYPE_MIN,
+    STAT_TYPE_REC,
+  } Type;
 
-  Stat(Mutex *lock) : internal_lock_(lock) {}
+  explicit Stat(Mutex *lock);
   ~Stat() {}
 
+  // The string keyed statistics (slow path).
   void Inc(std::string var, Int i, bool locking);
   void Max(std::string var, Int i, bool locking);
   void Min(std::string var, Int i, bool locking);
   void Rec(std::string var, Int i, bool locking);
+
+  // The registered statistics. Register returns the handle of the named
+  // statistic (the same handle if registered twice, STAT_SINK_ID if
+  // running out of slots), and should be done at setup time. The
+  // updates do not lock. They go to the shard of the calling thread and
+  // are aggregated in Display (a min statistic that is never updated is
+  // displayed as 0).
+  Id Register(const std::string &var, Type type);
+  void Inc(Id id, thread_id_t thd_id, Int i) {
+    ATOMIC_FETCH_AND_ADD(&GetShard(thd_id)->slots[id], i);
+  }
+  void Max(Id id, thread_id_t thd_id, Int i);
+  void Min(Id id, thread_id_t thd_id, Int i);
+  void Rec(Id id, thread_id_t thd_id, Int i) {
+    Inc(id + HistBucket(i), thd_id, 1);
+  }
+
   void Display(const std::string &fname);
 
  protected:
-  typedef std::vector<Int> IntVec;
+  // The histogram of a statistic. Bucket 0 counts value 0, and bucket k
+  // counts the values in [2^(k-1), 2^k).
+  typedef std::vector<Int> Histogram;
   typedef std::tr1::unordered_map<std::string, Int> IntTable;
-  typedef std::tr1::unordered_map<std::string, IntVec> IntVecTable;
+  typedef std::tr1::unordered_map<std::string, Histogram> HistogramTable;
+
+  // The per thread copy of the registered statistics.
+  class Shard {
+   public:
+    volatile Int slots[STAT_MAX_SLOTS];
+  } CACHE_LINE_ALIGNED;
+
+  class Entry {
+   public:
+    std::string var;
+    Type type;
+    Id id; // the first slot
+  };
+
+  typedef std::vector<Entry> EntryVec;
+
+  static size_t HistBucket(Int i) {
+    return i ? 64 - __builtin_clzll(i) : 0;
+  }
+  Shard *GetShard(thread_id_t thd_id) {
+    return &shards_[ThreadIndex::Get(thd_id) & (STAT_NUM_SHARDS - 1)];
+  }
+  void DisplayHistogram(std::ostream &out, const std::string &var,
+                        const Histogram &hist);
 
   Mutex *internal_lock_;
   IntTable int_table_;
-  IntVecTable int_vec_table_;
+  HistogramTable hist_table_;
+  Shard *shards_; // STAT_NUM_SHARDS shards
+  EntryVec entry_vec_;
+  Id next_slot_;
 
  private:
   DISALLOW_COPY_CONSTRUCTORS(Stat);
@@ -70,11 +138,17 @@ extern void stat_display(const std::string &fname);
 #define STAT_INC(var,i) do { g_stat->Inc(var, i, false); } while (0)
 #define STAT_INC_SAFE(var,i) do { g_stat->Inc(var, i, true); } while (0)
 #define STAT_MAX(var,i) do { g_stat->Max(var, i, false); } while (0)
-#define STAT_MAX_SAFE(var,i) do { g_stat->Inc(var, i, true); } while (0)
+#define STAT_MAX_SAFE(var,i) do { g_stat->Max(var, i, true); } while (0)
 #define STAT_MIN(var,i) do { g_stat->Min(var, i, false); } while (0)
 #define STAT_MIN_SAFE(var,i) do { g_stat->Min(var, i, true); } while (0)
 #define STAT_REC(var,i) do { g_stat->Rec(var, i, false); } while (0)
-#define STAT_REC_SAFE(var,i) do ( g_stat->Rec(var, i, true); } while (0)
+#define STAT_REC_SAFE(var,i) do { g_stat->Rec(var, i, true); } while (0)
+
+#define STAT_REGISTER(var,type) g_stat->Register(var, Stat::STAT_TYPE_##type)
+#define STAT_ID_INC(id,thd,i) do { g_stat->Inc(id, thd, i); } while (0)
+#define STAT_ID_MAX(id,thd,i) do { g_stat->Max(id, thd, i); } while (0)
+#define STAT_ID_MIN(id,thd,i) do { g_stat->Min(id, thd, i); } while (0)
+#define STAT_ID_REC(id,thd,i) do { g_stat->Rec(id, thd, i); } while (0)
 
 #ifdef _DEBUG
 #define DEBUG_STAT_INC(var,i) STAT_INC(var, i)
@@ -85,6 +159,10 @@ extern void stat_display(const std::string &fname);
 #define DEBUG_STAT_MIN_SAFE(var,i) STAT_MIN_SAFE(var, i)
 #define DEBUG_STAT_REC(var,i) STAT_REC(var, i)
 #define DEBUG_STAT_REC_SAFE(var,i) STAT_REC_SAFE(var, i)
+#define DEBUG_STAT_ID_INC(id,thd,i) STAT_ID_INC(id, thd, i)
+#define DEBUG_STAT_ID_MAX(id,thd,i) STAT_ID_MAX(id, thd, i)
+#define DEBUG_STAT_ID_MIN(id,thd,i) STAT_ID_MIN(id, thd, i)
+#define DEBUG_STAT_ID_REC(id,thd,i) STAT_ID_REC(id, thd, i)
 #else
 #define DEBUG_STAT_INC(var,i) do {} while (0)
 #define DEBUG_STAT_INC_SAFE(var,i) do {} while (0)
@@ -94,6 +172,10 @@ extern void stat_display(const std::string &fname);
 #define DEBUG_STAT_MIN_SAFE(var,i) do {} while (0)
 #define DEBUG_STAT_REC(var,i) do {} while (0)
 #define DEBUG_STAT_REC_SAFE(var,i) do {} while (0)
+#define DEBUG_STAT_ID_INC(id,thd,i) do {} while (0)
+#define DEBUG_STAT_ID_MAX(id,thd,i) do {} while (0)
+#define DEBUG_STAT_ID_MIN(id,thd,i) do {} while (0)
+#define DEBUG_STAT_ID_REC(id,thd,i) do {} while (0)
 #endif
 
 #endif
@@ -19,10 +19,45 @@
 
 #include "core/static_info.h"
 
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
+#include "core/atomic.h"
+
+static const char *volatile opcode_names[MAX_NUM_OPCODES];
+
+void RegisterOpcodeName(opcode_type opcode, const std::string &name) {
+  if (opcode >= MAX_NUM_OPCODES || opcode_names[opcode])
+    return;
+  char *str = strdup(name.c_str());
+  if (!ATOMIC_BOOL_COMPARE_AND_SWAP(&opcode_names[opcode],
+                                    (const char *)NULL, str))
+    free(str); // registered by someone else
+}
+
+const char *OpcodeName(opcode_type opcode) {
+  if (opcode >= MAX_NUM_OPCODES || !opcode_names[opcode])
+    return "";
+  return opcode_names[opcode];
+}
+
 Inst *Image::Find(address_t offset) {
+  Inst *inst = FindLoaded(offset);
+  if (!inst && index_owner_)
+    inst = index_owner_->FindIndexInst(this, offset);
+  return inst;
+}
+
+Inst *Image::FindLoaded(address_t offset) {
+  if (offset < inst_table_size_) {
+    Inst **chunk = inst_table_[offset >> INST_CHUNK_SHIFT];
+    if (!chunk)
+      return NULL;
+    return chunk[offset & (INST_CHUNK_SIZE - 1)];
+  }
+
   InstAddrMap::iterator found = inst_offset_map_.find(offset);
   if (found == inst_offset_map_.end())
     return NULL;
@@ -72,8 +107,32 @@ std::string Image::ShortName() {
     return name();
 }
 
+void Image::SetupInstTable(address_t size) {
+  if (inst_table_)
+    return;
+  address_t num_chunks = (size + INST_CHUNK_SIZE - 1) >> INST_CHUNK_SHIFT;
+  inst_table_ = new Inst **[num_chunks]();
+  inst_table_size_ = num_chunks << INST_CHUNK_SHIFT;
+  // move the known insts into the table
+  for (InstAddrMap::iterator it = inst_offset_map_.begin();
+       it != inst_offset_map_.end(); ++it) {
+    RegisterInTable(it->second);
+  }
+}
+
 void Image::Register(Inst *inst) {
   inst_offset_map_[inst->offset()] = inst;
+  RegisterInTable(inst);
+}
+
+void Image::RegisterInTable(Inst *inst) {
+  address_t offset = inst->offset();
+  if (offset >= inst_table_size_)
+    return;
+  Inst **&chunk = inst_table_[offset >> INST_CHUNK_SHIFT];
+  if (!chunk)
+    chunk = new Inst *[INST_CHUNK_SIZE]();
+  chunk[offset & (INST_CHUNK_SIZE - 1)] = inst;
 }
 
 void Inst::SetDebugInfo(const std::string &file_name, int line, int column) {
@@ -110,7 +169,9 @@ std::string Inst::ToString() {
 StaticInfo::StaticInfo(Mutex *lock)
     : lock_(lock),
       curr_image_id_(0),
-      curr_inst_id_(0) {
+      curr_inst_id_(0),
+      indexed_(false),
+      index_(NULL) {
   // empty
 }
 
@@ -155,16 +216,28 @@ Image *StaticInfo::FindImage(image_id_type id) {
 }
 
 Inst *StaticInfo::FindInst(inst_id_type id) {
+  // the insts of an index are loaded (inserted) under the lock
+  ScopedLock locker(lock_, index_ != NULL);
   InstMap::iterator it = inst_map_.find(id);
-  if (it == inst_map_.end())
-    return NULL;
-  else
+  if (it != inst_map_.end())
     return it->second;
+  if (!index_)
+    return NULL;
+
+  // load it from the index
+  const IndexInstRecord *record = index_->FindInst(id);
+  if (!record)
+    return NULL;
+  return LoadIndexInst(record);
 }
 
 void StaticInfo::Load(const std::string &db_name) {
+  if (StaticInfoIndex::IsIndexFile(db_name) && LoadIndex(db_name))
+    return;
+
   std::fstream in(db_name.c_str(), std::ios::in | std::ios::binary);
-  proto_.ParseFromIstream(&in);
+  if (!proto_.ParseFromIstream(&in))
+    proto_.Clear(); // drop the partially parsed records
   in.close();
   // setup image map
   for (int i = 0; i < proto_.image_size(); i++) {
@@ -189,9 +262,165 @@ void StaticInfo::Load(const std::string &db_name) {
 }
 
 void StaticInfo::Save(const std::string &db_name) {
+  if (indexed_) {
+    SaveIndex(db_name);
+    return;
+  }
+
   std::fstream out(db_name.c_str(),
                    std::ios::out | std::ios::trunc | std::ios::binary);
   proto_.SerializeToOstream(&out);
   out.close();
 }
 
+bool StaticInfo::LoadIndex(const std::string &db_name) {
+  index_ = new StaticInfoIndex;
+  if (!index_->Open(db_name)) {
+    fprintf(stderr, "[StaticInfo] invalid index %s\n", db_name.c_str());
+    delete index_;
+    index_ = NULL;
+    return false;
+  }
+  indexed_ = true;
+
+  // the images are few, load them now
+  const StaticInfoIndex::ImageNameMap &image_names = index_->image_names();
+  for (StaticInfoIndex::ImageNameMap::const_iterator it = image_names.begin();
+       it != image_names.end(); ++it) {
+    ImageProto *image_proto = proto_.add_image();
+    image_proto->set_id(it->first);
+    image_proto->set_name(it->second);
+    Image *image = new Image(image_proto);
+    image->index_owner_ = this;
+    image_map_[it->first] = image;
+  }
+  curr_image_id_ = index_->max_image_id();
+  curr_inst_id_ = index_->max_inst_id();
+  return true;
+}
+
+void StaticInfo::SaveIndex(const std::string &db_name) {
+  StaticInfoIndex::ImageNameMap images;
+  for (ImageMap::iterator it = image_map_.begin();
+       it != image_map_.end(); ++it) {
+    images[it->first] = it->second->name().c_str();
+  }
+
+  // append the new and the changed insts to the loaded index if
+  // possible, the insts that have not been loaded are unchanged
+  std::vector<StaticInfoIndex::InstEntry> insts;
+  if (index_ && index_->path() == db_name &&
+      index_->num_segments() < SINFO_INDEX_MAX_SEGMENTS) {
+    for (InstMap::iterator it = inst_map_.begin();
+         it != inst_map_.end(); ++it) {
+      Inst *inst = it->second;
+      if (inst->id() > index_->max_inst_id() ||
+          IndexInstChanged(inst, index_->FindInst(inst->id()))) {
+        StaticInfoIndex::InstEntry entry;
+        GetIndexEntry(inst, &entry);
+        insts.push_back(entry);
+      }
+    }
+    if (insts.empty() && curr_image_id_ == index_->max_image_id())
+      return;
+    if (index_->Append(images, &insts))
+      return;
+    insts.clear();
+  }
+
+  // rewrite the whole database
+  for (inst_id_type id = 1; id <= curr_inst_id_; id++) {
+    StaticInfoIndex::InstEntry entry;
+    InstMap::iterator it = inst_map_.find(id);
+    if (it != inst_map_.end()) {
+      GetIndexEntry(it->second, &entry);
+      insts.push_back(entry);
+    } else if (index_) {
+      const IndexInstRecord *record = index_->FindInst(id);
+      if (!record)
+        continue;
+      entry.offset = record->offset;
+      entry.id = record->id;
+      entry.image_id = record->image_id;
+      entry.flags = record->flags;
+      entry.opcode = record->opcode;
+      entry.file_name = NULL;
+      if (record->flags & SINFO_INDEX_HAS_DEBUG_INFO)
+        entry.file_name = index_->String(record->file_name);
+      entry.line = record->line;
+      entry.column = record->column;
+      insts.push_back(entry);
+    }
+  }
+  if (!StaticInfoIndex::Write(db_name, images, &insts))
+    fprintf(stderr, "[StaticInfo] fail to write %s\n", db_name.c_str());
+}
+
+Inst *StaticInfo::FindIndexInst(Image *image, address_t offset) {
+  ScopedLock locker(lock_);
+  Inst *inst = image->FindLoaded(offset);
+  if (inst)
+    return inst;
+  const IndexInstRecord *record = index_->FindInst(image->id(), offset);
+  if (!record)
+    return NULL;
+  return LoadIndexInst(record);
+}
+
+Inst *StaticInfo::LoadIndexInst(const IndexInstRecord *record) {
+  Image *image = FindImage(record->image_id);
+  if (!image)
+    return NULL;
+  InstProto *inst_proto = proto_.add_inst();
+  inst_proto->set_id(record->id);
+  inst_proto->set_image_id(record->image_id);
+  inst_proto->set_offset(record->offset);
+  if (record->flags & SINFO_INDEX_HAS_OPCODE)
+    inst_proto->set_opcode(record->opcode);
+  if (record->flags & SINFO_INDEX_HAS_DEBUG_INFO) {
+    DebugInfoProto *di_proto = inst_proto->mutable_debug_info();
+    di_proto->set_file_name(index_->String(record->file_name));
+    di_proto->set_line(record->line);
+    di_proto->set_column(record->column);
+  }
+  Inst *inst = new Inst(image, inst_proto);
+  inst_map_[record->id] = inst;
+  image->Register(inst);
+  return inst;
+}
+
+bool StaticInfo::IndexInstChanged(Inst *inst, const IndexInstRecord *record) {
+  if (!record)
+    return true;
+  if (inst->HasOpcode() != ((record->flags & SINFO_INDEX_HAS_OPCODE) != 0) ||
+      (inst->HasOpcode() && inst->opcode() != record->opcode))
+    return true;
+  if (inst->HasDebugInfo() !=
+      ((record->flags & SINFO_INDEX_HAS_DEBUG_INFO) != 0))
+    return true;
+  return false;
+}
+
+void StaticInfo::GetIndexEntry(Inst *inst,
+                               StaticInfoIndex::InstEntry *entry) {
+  entry->offset = inst->offset();
+  entry->id = inst->id();
+  entry->image_id = inst->image()->id();
+  entry->flags = 0;
+  entry->opcode = 0;
+  entry->file_name = NULL;
+  entry->line = 0;
+  entry->column = 0;
+  if (inst->HasOpcode()) {
+    entry->flags |= SINFO_INDEX_HAS_OPCODE;
+    entry->opcode = inst->opcode();
+  }
+  if (inst->HasDebugInfo()) {
+    const DebugInfoProto &di_proto = inst->proto_->debug_info();
+    entry->flags |= SINFO_INDEX_HAS_DEBUG_INFO;
+    entry->file_name = di_proto.file_name().c_str();
+    entry->line = di_proto.line();
+    entry->column = di_proto.column();
+  }
+}
+
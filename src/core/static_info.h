@@ -27,6 +27,7 @@
 
 #include "core/basictypes.h"
 #include "core/sync.h"
+#include "core/static_info_index.h"
 #include "core/static_info.pb.h" // protobuf head file
 
 class Inst;
@@ -36,10 +37,15 @@ typedef uint32 image_id_type;
 #define INVALID_IMAGE_ID static_cast<image_id_type>(-1)
 #define PSEUDO_IMAGE_NAME  "PSEUDO_IMAGE"
 
+// The number of offsets covered by each chunk of the inst table.
+#define INST_CHUNK_SHIFT 8
+#define INST_CHUNK_SIZE (1 << INST_CHUNK_SHIFT)
+
 // An image can be a main executable, or a library image.
 class Image {
  public:
   Inst *Find(address_t offset);
+  void SetupInstTable(address_t size);
   bool IsCommonLib();
   bool IsLibc();
   bool IsPthread();
@@ -52,13 +58,26 @@ class Image {
  private:
   typedef std::tr1::unordered_map<address_t, Inst *> InstAddrMap;
 
-  explicit Image(ImageProto *proto) : proto_(proto) {}
+  explicit Image(ImageProto *proto)
+      : inst_table_(NULL),
+        inst_table_size_(0),
+        proto_(proto),
+        index_owner_(NULL) {}
   ~Image() {}
 
+  Inst *FindLoaded(address_t offset);
   void Register(Inst *inst);
+  void RegisterInTable(Inst *inst);
 
   InstAddrMap inst_offset_map_; // store static instructions for the image
+  // dense lookup table (indexed by offset, lazily allocated in chunks of
+  // INST_CHUNK_SIZE). only available when the image size is known.
+  Inst ***inst_table_;
+  address_t inst_table_size_; // number of offsets covered by the table
   ImageProto *proto_;
+  // the static info whose index may contain insts of this image that
+  // have not been loaded yet (NULL if none)
+  StaticInfo *index_owner_;
 
  private:
   friend class StaticInfo;
@@ -70,6 +89,14 @@ typedef uint32 inst_id_type;
 typedef uint32 opcode_type;
 #define INVALID_INST_ID static_cast<inst_id_type>(-1)
 #define INVALID_OPCODE static_cast<opcode_type>(0)
+#define MAX_NUM_OPCODES 4096
+
+// The opcodes are defined by the instrumentation framework. Their
+// names are registered when the instructions are instrumented, so
+// that the analyzers can look them up lazily without depending on
+// the framework (and without building a string for each execution).
+void RegisterOpcodeName(opcode_type opcode, const std::string &name);
+const char *OpcodeName(opcode_type opcode); // "" if unknown
 
 // A static instruction represented by the image that contains it and
 // the offset in the image.
@@ -111,15 +138,30 @@ class StaticInfo {
   Image *FindImage(const std::string &name);
   Image *FindImage(image_id_type id);
   Inst *FindInst(inst_id_type id);
+  // Load the database. Both the protobuf format and the indexed format
+  // (see core/static_info_index.h) are accepted. The insts in an
+  // indexed database are loaded lazily when they are looked up. An
+  // index that fails to open is read as a protobuf database instead.
   void Load(const std::string &db_name);
+  // Save the database, in the indexed format if it has been loaded
+  // from an indexed database or if set_indexed(true) is called.
   void Save(const std::string &db_name);
 
+  bool indexed() { return indexed_; }
+  void set_indexed(bool indexed) { indexed_ = indexed; }
+
  private:
   typedef std::map<image_id_type, Image *> ImageMap;
   typedef std::tr1::unordered_map<inst_id_type, Inst *> InstMap;
 
   image_id_type GetNextImageID() { return ++curr_image_id_; }
   inst_id_type GetNextInstID() { return ++curr_inst_id_; }
+  bool LoadIndex(const std::string &db_name);
+  void SaveIndex(const std::string &db_name);
+  Inst *FindIndexInst(Image *image, address_t offset);
+  Inst *LoadIndexInst(const IndexInstRecord *record);
+  bool IndexInstChanged(Inst *inst, const IndexInstRecord *record);
+  void GetIndexEntry(Inst *inst, StaticInfoIndex::InstEntry *entry);
 
   Mutex *lock_;
   image_id_type curr_image_id_;
@@ -127,8 +169,12 @@ class StaticInfo {
   ImageMap image_map_;
   InstMap inst_map_;
   StaticInfoProto proto_;
+  bool indexed_;
+  StaticInfoIndex *index_; // NULL if not loaded from an indexed database
 
  private:
+  friend class Image;
+
   DISALLOW_COPY_CONSTRUCTORS(StaticInfo);
 };
 
@@ -0,0 +1,376 @@
+// Copyright 2011 The University of Michigan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Authors - Jie Yu (jieyu@umich.edu)
+
+// File: core/static_info_index.cc - Implementation of the memory mapped
+// index format of the static info database.
+
+#include "core/static_info_index.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+
+#define ALIGN8(x) (((x) + 7) & ~static_cast<uint64>(7))
+
+// Order the inst entries by image and offset.
+static bool InstEntryLess(const StaticInfoIndex::InstEntry &a,
+                          const StaticInfoIndex::InstEntry &b) {
+  if (a.image_id != b.image_id)
+    return a.image_id < b.image_id;
+  return a.offset < b.offset;
+}
+
+// Order the positions of the inst entries by inst id.
+class InstIdLess {
+ public:
+  explicit InstIdLess(std::vector<StaticInfoIndex::InstEntry> *insts)
+      : insts_(insts) {}
+  bool operator()(uint32 a, uint32 b) const {
+    return (*insts_)[a].id < (*insts_)[b].id;
+  }
+
+ private:
+  std::vector<StaticInfoIndex::InstEntry> *insts_;
+};
+
+// Add a string to the pool (if not there yet), return its offset in
+// the file.
+static uint64 PoolString(const char *str, uint64 pool_start,
+                         std::string *pool,
+                         std::map<std::string, uint64> *pool_map) {
+  std::string key(str);
+  std::map<std::string, uint64>::iterator it = pool_map->find(key);
+  if (it != pool_map->end())
+    return it->second;
+  uint64 offset = pool_start + pool->size();
+  pool->append(key);
+  pool->push_back('\0');
+  (*pool_map)[key] = offset;
+  return offset;
+}
+
+StaticInfoIndex::StaticInfoIndex()
+    : base_(NULL),
+      size_(0),
+      valid_size_(0),
+      max_image_id_(0),
+      max_inst_id_(0) {
+  // empty
+}
+
+StaticInfoIndex::~StaticInfoIndex() {
+  Close();
+}
+
+bool StaticInfoIndex::Open(const std::string &path) {
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(IndexFileHeader)) {
+    close(fd);
+    return false;
+  }
+  void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED)
+    return false;
+  base_ = (const char *)ptr;
+  size_ = st.st_size;
+
+  const IndexFileHeader *file_header = (const IndexFileHeader *)base_;
+  if (file_header->magic != SINFO_INDEX_MAGIC ||
+      file_header->version != SINFO_INDEX_VERSION) {
+    Close();
+    return false;
+  }
+
+  // scan the segments, stop at the first incomplete one (the file may
+  // be truncated if a save was interrupted)
+  uint64 pos = sizeof(IndexFileHeader);
+  while (pos + sizeof(IndexSegmentHeader) <= size_) {
+    const IndexSegmentHeader *header =
+        (const IndexSegmentHeader *)(base_ + pos);
+    uint64 records_size = sizeof(IndexSegmentHeader) +
+        sizeof(IndexImageRecord) * (uint64)header->num_images +
+        sizeof(IndexInstRecord) * (uint64)header->num_insts +
+        ALIGN8(sizeof(uint32) * (uint64)header->num_insts);
+    if (header->magic != SINFO_INDEX_SEGMENT_MAGIC ||
+        header->size < records_size || pos + header->size > size_)
+      break;
+
+    Segment segment;
+    segment.header = header;
+    segment.images = (const IndexImageRecord *)(header + 1);
+    segment.insts = (const IndexInstRecord *)(segment.images +
+                                              header->num_images);
+    segment.id_order = (const uint32 *)(segment.insts + header->num_insts);
+    segment.pool_start = pos + records_size;
+    segment.end = pos + header->size;
+    if (!CheckSegment(&segment)) {
+      // a complete but corrupted segment, do not trust the file
+      Close();
+      return false;
+    }
+    segments_.push_back(segment);
+
+    for (uint32 i = 0; i < header->num_images; i++) {
+      const IndexImageRecord *image = &segment.images[i];
+      image_names_[image->id] = String(image->name);
+    }
+    max_image_id_ = std::max(max_image_id_, header->max_image_id);
+    max_inst_id_ = std::max(max_inst_id_, header->max_inst_id);
+    pos += header->size;
+  }
+  valid_size_ = pos;
+  path_ = path;
+  return true;
+}
+
+void StaticInfoIndex::Close() {
+  if (base_)
+    munmap((void *)base_, size_);
+  base_ = NULL;
+  size_ = 0;
+  valid_size_ = 0;
+  segments_.clear();
+  max_image_id_ = 0;
+  max_inst_id_ = 0;
+  image_names_.clear();
+}
+
+bool StaticInfoIndex::CheckSegment(Segment *segment) {
+  // the strings are null terminated, so a valid string offset never
+  // runs past the end of the segment
+  if (segment->pool_start < segment->end && base_[segment->end - 1] != '\0')
+    return false;
+  uint32 num_insts = segment->header->num_insts;
+  for (uint32 i = 0; i < segment->header->num_images; i++) {
+    const IndexImageRecord *image = &segment->images[i];
+    if ((uint64)image->first_inst + image->num_insts > num_insts ||
+        !ValidString(segment, image->name))
+      return false;
+  }
+  for (uint32 i = 0; i < num_insts; i++) {
+    if (segment->id_order[i] >= num_insts)
+      return false;
+  }
+  return true;
+}
+
+const IndexInstRecord *StaticInfoIndex::CheckInst(
+    Segment *segment, const IndexInstRecord *record) {
+  // the inst records are only checked when found, so that opening the
+  // index does not touch all of them
+  if ((record->flags & SINFO_INDEX_HAS_DEBUG_INFO) &&
+      !ValidString(segment, record->file_name))
+    return NULL;
+  return record;
+}
+
+const IndexInstRecord *StaticInfoIndex::FindInst(uint32 image_id,
+                                                 address_t offset) {
+  // the later segments override the earlier ones
+  for (size_t s = segments_.size(); s > 0; s--) {
+    Segment *segment = &segments_[s - 1];
+    for (uint32 i = 0; i < segment->header->num_images; i++) {
+      const IndexImageRecord *image = &segment->images[i];
+      if (image->id != image_id)
+        continue;
+      // binary search the offsets of the image
+      const IndexInstRecord *low = segment->insts + image->first_inst;
+      const IndexInstRecord *high = low + image->num_insts;
+      while (low < high) {
+        const IndexInstRecord *mid = low + (high - low) / 2;
+        if (mid->offset < offset)
+          low = mid + 1;
+        else
+          high = mid;
+      }
+      if (low < segment->insts + image->first_inst + image->num_insts &&
+          low->offset == offset)
+        return CheckInst(segment, low);
+      break;
+    }
+  }
+  return NULL;
+}
+
+const IndexInstRecord *StaticInfoIndex::FindInst(uint32 inst_id) {
+  for (size_t s = segments_.size(); s > 0; s--) {
+    Segment *segment = &segments_[s - 1];
+    uint32 low = 0;
+    uint32 high = segment->header->num_insts;
+    while (low < high) {
+      uint32 mid = low + (high - low) / 2;
+      if (segment->insts[segment->id_order[mid]].id < inst_id)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    if (low < segment->header->num_insts &&
+        segment->insts[segment->id_order[low]].id == inst_id)
+      return CheckInst(segment, &segment->insts[segment->id_order[low]]);
+  }
+  return NULL;
+}
+
+bool StaticInfoIndex::Append(const ImageNameMap &images,
+                             std::vector<InstEntry> *insts) {
+  if (!base_)
+    return false;
+
+  // give up if the file has been changed by others
+  struct stat st;
+  if (stat(path_.c_str(), &st) != 0 || (size_t)st.st_size != size_)
+    return false;
+  // drop the incomplete segment left by an interrupted save
+  if (valid_size_ != size_ && truncate(path_.c_str(), valid_size_) != 0)
+    return false;
+
+  std::ofstream out(path_.c_str(),
+                    std::ios::out | std::ios::app | std::ios::binary);
+  if (!out.is_open())
+    return false;
+  bool success = WriteSegment(out, valid_size_, images, insts,
+                              max_image_id_, max_inst_id_);
+  out.close();
+  return success && !out.fail();
+}
+
+bool StaticInfoIndex::IsIndexFile(const std::string &path) {
+  std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+  IndexFileHeader header;
+  if (!in.read((char *)&header, sizeof(header)))
+    return false;
+  return header.magic == SINFO_INDEX_MAGIC;
+}
+
+bool StaticInfoIndex::Write(const std::string &path,
+                            const ImageNameMap &images,
+                            std::vector<InstEntry> *insts) {
+  // write to a temporary file first so that the file being replaced
+  // (which might be mapped) is never modified
+  std::string tmp_path = path + ".tmp";
+  std::ofstream out(tmp_path.c_str(),
+                    std::ios::out | std::ios::trunc | std::ios::binary);
+  if (!out.is_open())
+    return false;
+  IndexFileHeader header;
+  header.magic = SINFO_INDEX_MAGIC;
+  header.version = SINFO_INDEX_VERSION;
+  out.write((const char *)&header, sizeof(header));
+  bool success = WriteSegment(out, sizeof(header), images, insts, 0, 0);
+  out.close();
+  if (!success || out.fail()) {
+    remove(tmp_path.c_str());
+    return false;
+  }
+  return rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+bool StaticInfoIndex::WriteSegment(std::ostream &out, uint64 start,
+                                   const ImageNameMap &images,
+                                   std::vector<InstEntry> *insts,
+                                   uint32 max_image_id, uint32 max_inst_id) {
+  uint32 num_images = images.size();
+  uint32 num_insts = insts->size();
+
+  // group the insts by image and sort them by offset
+  std::sort(insts->begin(), insts->end(), InstEntryLess);
+  std::vector<uint32> id_order(num_insts);
+  for (uint32 i = 0; i < num_insts; i++)
+    id_order[i] = i;
+  std::sort(id_order.begin(), id_order.end(), InstIdLess(insts));
+
+  uint64 pool_start = start + sizeof(IndexSegmentHeader) +
+      sizeof(IndexImageRecord) * (uint64)num_images +
+      sizeof(IndexInstRecord) * (uint64)num_insts +
+      ALIGN8(sizeof(uint32) * (uint64)num_insts);
+  std::string pool;
+  std::map<std::string, uint64> pool_map;
+
+  // build the image records
+  std::vector<IndexImageRecord> image_records;
+  for (ImageNameMap::const_iterator it = images.begin();
+       it != images.end(); ++it) {
+    IndexImageRecord record;
+    InstEntry key;
+    key.image_id = it->first;
+    key.offset = 0;
+    std::vector<InstEntry>::iterator first =
+        std::lower_bound(insts->begin(), insts->end(), key, InstEntryLess);
+    std::vector<InstEntry>::iterator last = first;
+    while (last != insts->end() && last->image_id == it->first)
+      ++last;
+    record.id = it->first;
+    record.first_inst = first - insts->begin();
+    record.num_insts = last - first;
+    record.reserved = 0;
+    record.name = PoolString(it->second, pool_start, &pool, &pool_map);
+    image_records.push_back(record);
+    max_image_id = std::max(max_image_id, it->first);
+  }
+
+  // build the inst records
+  std::vector<IndexInstRecord> inst_records(num_insts);
+  for (uint32 i = 0; i < num_insts; i++) {
+    InstEntry *entry = &(*insts)[i];
+    IndexInstRecord *record = &inst_records[i];
+    record->offset = entry->offset;
+    record->id = entry->id;
+    record->image_id = entry->image_id;
+    record->flags = entry->flags;
+    record->opcode = entry->opcode;
+    record->file_name = SINFO_INDEX_NO_STRING;
+    record->line = entry->line;
+    record->column = entry->column;
+    if (entry->file_name)
+      record->file_name = PoolString(entry->file_name, pool_start,
+                                     &pool, &pool_map);
+    max_inst_id = std::max(max_inst_id, entry->id);
+  }
+  id_order.resize(ALIGN8(sizeof(uint32) * num_insts) / sizeof(uint32), 0);
+  pool.resize(ALIGN8(pool.size()), '\0');
+
+  IndexSegmentHeader header;
+  header.magic = SINFO_INDEX_SEGMENT_MAGIC;
+  header.num_images = num_images;
+  header.num_insts = num_insts;
+  header.max_image_id = max_image_id;
+  header.max_inst_id = max_inst_id;
+  header.reserved = 0;
+  header.size = pool_start - start + pool.size();
+
+  out.write((const char *)&header, sizeof(header));
+  if (num_images)
+    out.write((const char *)&image_records[0],
+              sizeof(IndexImageRecord) * num_images);
+  if (num_insts) {
+    out.write((const char *)&inst_records[0],
+              sizeof(IndexInstRecord) * num_insts);
+    out.write((const char *)&id_order[0], sizeof(uint32) * id_order.size());
+  }
+  out.write(pool.data(), pool.size());
+  return out.good();
+}
+
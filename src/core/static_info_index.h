@@ -0,0 +1,167 @@
+// Copyright 2011 The University of Michigan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Authors - Jie Yu (jieyu@umich.edu)
+
+// File: core/static_info_index.h - Define the memory mapped index format
+// of the static info database.
+
+#ifndef CORE_STATIC_INFO_INDEX_H_
+#define CORE_STATIC_INFO_INDEX_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "core/basictypes.h"
+
+// An index file is a header followed by segments. Each save appends a
+// segment holding the images and the new or updated insts, and the
+// records in later segments override those in earlier ones. A segment
+// is laid out as follows (all integers in host byte order):
+//
+//   IndexSegmentHeader
+//   IndexImageRecord[num_images]
+//   IndexInstRecord[num_insts]   grouped by image, sorted by offset
+//   uint32[num_insts]            record positions sorted by inst id
+//   char[pool_size]              null terminated strings
+//
+// Strings are referred to by their offsets in the file, so that they
+// can be used directly from the mapping.
+#define SINFO_INDEX_MAGIC 0x78646973 // "sidx"
+#define SINFO_INDEX_SEGMENT_MAGIC 0x67657373 // "sseg"
+#define SINFO_INDEX_VERSION 1
+// The maximum number of segments before a save rewrites the file.
+#define SINFO_INDEX_MAX_SEGMENTS 16
+#define SINFO_INDEX_NO_STRING static_cast<uint64>(-1)
+
+// Flags of the inst records.
+#define SINFO_INDEX_HAS_OPCODE 0x1
+#define SINFO_INDEX_HAS_DEBUG_INFO 0x2
+
+struct IndexFileHeader {
+  uint32 magic;
+  uint32 version;
+};
+
+struct IndexSegmentHeader {
+  uint32 magic;
+  uint32 num_images;
+  uint32 num_insts;
+  uint32 max_image_id; // the largest image id so far
+  uint32 max_inst_id; // the largest inst id so far
+  uint32 reserved;
+  uint64 size; // the size of the whole segment
+};
+
+struct IndexImageRecord {
+  uint32 id;
+  uint32 first_inst; // the first inst record of the image
+  uint32 num_insts;
+  uint32 reserved;
+  uint64 name; // string offset
+};
+
+struct IndexInstRecord {
+  uint64 offset;
+  uint32 id;
+  uint32 image_id;
+  uint32 flags;
+  uint32 opcode;
+  uint64 file_name; // string offset, SINFO_INDEX_NO_STRING if none
+  int32 line;
+  int32 column;
+};
+
+// The memory mapped static info index. The index is read only, new
+// records are added by writing a new segment.
+class StaticInfoIndex {
+ public:
+  typedef std::map<uint32, const char *> ImageNameMap;
+
+  // The description of an inst to write.
+  struct InstEntry {
+    uint64 offset;
+    uint32 id;
+    uint32 image_id;
+    uint32 flags;
+    uint32 opcode;
+    const char *file_name; // NULL if no debug info
+    int32 line;
+    int32 column;
+  };
+
+  StaticInfoIndex();
+  ~StaticInfoIndex();
+
+  // Map the index file. Return false if it is not a valid index file,
+  // or if a complete segment refers to records or strings outside of
+  // it.
+  bool Open(const std::string &path);
+  void Close();
+  const IndexInstRecord *FindInst(uint32 image_id, address_t offset);
+  const IndexInstRecord *FindInst(uint32 inst_id);
+  const char *String(uint64 offset) { return base_ + offset; }
+  // Append a segment to the mapped file. The mapping is not changed,
+  // so the new records are not visible until the file is opened again.
+  bool Append(const ImageNameMap &images, std::vector<InstEntry> *insts);
+
+  const std::string &path() { return path_; }
+  size_t num_segments() { return segments_.size(); }
+  uint32 max_image_id() { return max_image_id_; }
+  uint32 max_inst_id() { return max_inst_id_; }
+  const ImageNameMap &image_names() { return image_names_; }
+
+  // Return whether the file is an index file.
+  static bool IsIndexFile(const std::string &path);
+  // Create (or replace) an index file with a single segment.
+  static bool Write(const std::string &path, const ImageNameMap &images,
+                    std::vector<InstEntry> *insts);
+
+ private:
+  struct Segment {
+    const IndexSegmentHeader *header;
+    const IndexImageRecord *images;
+    const IndexInstRecord *insts;
+    const uint32 *id_order;
+    uint64 pool_start; // the file offset of the string pool
+    uint64 end; // the file offset of the end of the segment
+  };
+
+  bool CheckSegment(Segment *segment);
+  bool ValidString(Segment *segment, uint64 offset) {
+    return offset >= segment->pool_start && offset < segment->end;
+  }
+  const IndexInstRecord *CheckInst(Segment *segment,
+                                   const IndexInstRecord *record);
+
+  static bool WriteSegment(std::ostream &out, uint64 start,
+                           const ImageNameMap &images,
+                           std::vector<InstEntry> *insts,
+                           uint32 max_image_id, uint32 max_inst_id);
+
+  std::string path_;
+  const char *base_;
+  size_t size_; // the size of the mapping
+  size_t valid_size_; // the size of the complete segments
+  std::vector<Segment> segments_;
+  uint32 max_image_id_;
+  uint32 max_inst_id_;
+  ImageNameMap image_names_;
+
+  DISALLOW_COPY_CONSTRUCTORS(StaticInfoIndex);
+};
+
+#endif
+
@@ -145,5 +145,62 @@ class ScopedLock {
   DISALLOW_COPY_CONSTRUCTORS(ScopedLock);
 };
 
+// Define scoped read lock and write lock for read-write mutexes.
+class ScopedReadLock {
+ public:
+  explicit ScopedReadLock(RWMutex *mutex)
+      : mutex_(mutex), locked_(false) {
+    mutex_->LockRead();
+    locked_ = true;
+  }
+
+  ScopedReadLock(RWMutex *mutex, bool initially_locked)
+      : mutex_(mutex), locked_(false) {
+    if (initially_locked) {
+      mutex_->LockRead();
+      locked_ = true;
+    }
+  }
+
+  ~ScopedReadLock() {
+    if (locked_)
+      mutex_->UnlockRead();
+  }
+
+ private:
+  RWMutex *mutex_;
+  bool locked_;
+
+  DISALLOW_COPY_CONSTRUCTORS(ScopedReadLock);
+};
+
+class ScopedWriteLock {
+ public:
+  explicit ScopedWriteLock(RWMutex *mutex)
+      : mutex_(mutex), locked_(false) {
+    mutex_->LockWrite();
+    locked_ = true;
+  }
+
+  ScopedWriteLock(RWMutex *mutex, bool initially_locked)
+      : mutex_(mutex), locked_(false) {
+    if (initially_locked) {
+      mutex_->LockWrite();
+      locked_ = true;
+    }
+  }
+
+  ~ScopedWriteLock() {
+    if (locked_)
+      mutex_->UnlockWrite();
+  }
+
+ private:
+  RWMutex *mutex_;
+  bool locked_;
+
+  DISALLOW_COPY_CONSTRUCTORS(ScopedWriteLock);
+};
+
 #endif
 
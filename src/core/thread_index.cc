@@ -0,0 +1,96 @@
+// Copyright 2011 The University of Michigan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Authors - Jie Yu (jieyu@umich.edu)
+
+
+// File: core/thread_index.cc - Implementation of the compact thread
+// index.
+
+#include "core/thread_index.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "core/atomic.h"
+
+// the size of the hash table that maps thread ids to indexes
+#define THREAD_INDEX_TABLE_SIZE (MAX_NUM_THREAD_INDEXES * 2)
+
+// a key is the thread id plus one (0 means empty), and a value is the
+// index plus one (0 means the index is being assigned). entries are
+// never removed. the table is zero filled and only the pages holding
+// used entries are ever touched, so it occupies memory in proportion
+// to the number of threads.
+static volatile thread_id_t index_table_keys[THREAD_INDEX_TABLE_SIZE];
+static volatile size_t index_table_values[THREAD_INDEX_TABLE_SIZE];
+static ThreadIndexTable<thread_id_t> index_threads;
+static size_t num_indexes = 0;
+
+size_t ThreadIndex::Get(thread_id_t thd_id) {
+  return Lookup(thd_id, true);
+}
+
+size_t ThreadIndex::Find(thread_id_t thd_id) {
+  return Lookup(thd_id, false);
+}
+
+thread_id_t ThreadIndex::Thread(size_t index) {
+  return *index_threads.Find(index);
+}
+
+size_t ThreadIndex::Size() {
+  size_t size = num_indexes;
+  return size < MAX_NUM_THREAD_INDEXES ? size : MAX_NUM_THREAD_INDEXES;
+}
+
+size_t ThreadIndex::Lookup(thread_id_t thd_id, bool create) {
+  thread_id_t key = thd_id + 1;
+  if (!key)
+    return INVALID_THREAD_INDEX;
+  size_t pos = static_cast<size_t>((key * 0x9e3779b97f4a7c15ULL) >> 32) %
+               THREAD_INDEX_TABLE_SIZE;
+  while (true) {
+    thread_id_t curr_key = index_table_keys[pos];
+    if (curr_key == key) {
+      // wait until the index has been assigned
+      size_t value;
+      while (!(value = index_table_values[pos]))
+        ;
+      return value - 1;
+    }
+    if (!curr_key) {
+      if (!create)
+        return INVALID_THREAD_INDEX;
+      if (ATOMIC_BOOL_COMPARE_AND_SWAP(&index_table_keys[pos], 0, key)) {
+        size_t index = ATOMIC_FETCH_AND_ADD(&num_indexes, 1);
+        if (index >= MAX_NUM_THREAD_INDEXES) {
+          // the indexes cannot be recycled because the vector clocks
+          // keep the components of the exited threads
+          fprintf(stderr, "[ThreadIndex] more than %d threads, abort\n",
+                  MAX_NUM_THREAD_INDEXES);
+          abort();
+        }
+        *index_threads.Get(index) = thd_id;
+        MEMORY_BARRIER();
+        index_table_values[pos] = index + 1;
+        return index;
+      }
+      // lost the race, check the same entry again
+      continue;
+    }
+    pos = (pos + 1) % THREAD_INDEX_TABLE_SIZE;
+  }
+}
+
@@ -0,0 +1,104 @@
+// Copyright 2011 The University of Michigan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Authors - Jie Yu (jieyu@umich.edu)
+
+
+// File: core/thread_index.h - Define the compact thread index.
+
+#ifndef CORE_THREAD_INDEX_H_
+#define CORE_THREAD_INDEX_H_
+
+#include "core/basictypes.h"
+#include "core/atomic.h"
+
+// the per thread tables are allocated in chunks of indexes
+#define THREAD_INDEX_CHUNK_SIZE 4096
+#define THREAD_INDEX_MAX_CHUNKS 256
+// the maximum number of distinct threads in one run (the process is
+// aborted if more threads are seen)
+#define MAX_NUM_THREAD_INDEXES \
+    (THREAD_INDEX_CHUNK_SIZE * THREAD_INDEX_MAX_CHUNKS)
+#define INVALID_THREAD_INDEX static_cast<size_t>(-1)
+
+// Map thread ids to compact indexes (0, 1, 2, ...) in the order in
+// which the threads are first seen. The mapping is global, lock free,
+// and indexes are never reused, so they can be used to index per
+// thread tables (see ThreadIndexTable).
+class ThreadIndex {
+ public:
+  // return the index of the thread, assign one if necessary
+  static size_t Get(thread_id_t thd_id);
+  // return the index of the thread, or INVALID_THREAD_INDEX if the
+  // thread has not been assigned one
+  static size_t Find(thread_id_t thd_id);
+  // return the thread id of the index
+  static thread_id_t Thread(size_t index);
+  // return the number of indexes assigned so far
+  static size_t Size();
+
+ private:
+  static size_t Lookup(thread_id_t thd_id, bool create);
+};
+
+// A per thread table indexed by the thread index. The slots are zero
+// initialized, and are allocated a chunk at a time when an index in
+// the chunk is first used, so that the table only grows with the
+// number of threads seen so far. Allocating a chunk is lock free.
+template <typename T>
+class ThreadIndexTable {
+ public:
+  ThreadIndexTable() {
+    for (size_t i = 0; i < THREAD_INDEX_MAX_CHUNKS; i++)
+      chunks_[i] = NULL;
+  }
+
+  ~ThreadIndexTable() {
+    for (size_t i = 0; i < THREAD_INDEX_MAX_CHUNKS; i++)
+      delete [] chunks_[i];
+  }
+
+  // return the slot of the index, or NULL if its chunk has not been
+  // allocated
+  T *Find(size_t index) {
+    T *chunk = chunks_[index / THREAD_INDEX_CHUNK_SIZE];
+    return chunk ? &chunk[index % THREAD_INDEX_CHUNK_SIZE] : NULL;
+  }
+
+  // return the slot of the index, allocate its chunk if necessary
+  T *Get(size_t index) {
+    T *volatile *chunk_ptr = &chunks_[index / THREAD_INDEX_CHUNK_SIZE];
+    T *chunk = *chunk_ptr;
+    if (!chunk) {
+      T *new_chunk = new T[THREAD_INDEX_CHUNK_SIZE]();
+      if (ATOMIC_BOOL_COMPARE_AND_SWAP(chunk_ptr, static_cast<T *>(NULL),
+                                       new_chunk)) {
+        chunk = new_chunk;
+      } else {
+        // lost the race, use the chunk of the winner
+        delete [] new_chunk;
+        chunk = *chunk_ptr;
+      }
+    }
+    return &chunk[index % THREAD_INDEX_CHUNK_SIZE];
+  }
+
+ private:
+  T *volatile chunks_[THREAD_INDEX_MAX_CHUNKS];
+
+  DISALLOW_COPY_CONSTRUCTORS(ThreadIndexTable);
+};
+
+#endif
+
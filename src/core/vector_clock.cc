@@ -18,8 +18,16 @@
 
 #include "core/vector_clock.h"
 
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "core/atomic.h"
+
 #ifndef MAX
 #define MAX(a, b) (((a)>(b)) ? (a) : (b))
 #endif
@@ -28,121 +36,228 @@
 #define MIN(a, b) (((a)<(b)) ? (a) : (b))
 #endif
 
-bool VectorClock::HappensBefore(VectorClock *vc) {
-  ThreadClockMap::iterator curr_it = map_.begin();
-  ThreadClockMap::iterator vc_it = vc->map_.begin();
-  for (; curr_it != map_.end(); ++curr_it) {
-    thread_id_t curr_thd_id = curr_it->first;
-    timestamp_t curr_thd_clk = curr_it->second;
-
-    bool valid = false;
-    for (; vc_it != vc->map_.end(); ++vc_it) {
-      thread_id_t vc_thd_id = vc_it->first;
-      timestamp_t vc_thd_clk = vc_it->second;
-
-      if (vc_thd_id == curr_thd_id) {
-        if (vc_thd_clk >= curr_thd_clk) {
-          valid = true;
-          ++vc_it;
-        }
-        break;
-      } else if (vc_thd_id > curr_thd_id) {
-        break;
-      }
-    }
-
-    if (!valid)
+// The following helper functions operate on dense clock arrays. The
+// SSE2 versions rely on the fact that clocks are always smaller than
+// 2^63, so that a > b if and only if the sign bit of (b - a) is set.
+
+// return true if a[i] <= b[i] for all i < n
+static bool ClocksLessEqual(timestamp_t *a, timestamp_t *b, size_t n) {
+  size_t i = 0;
+#ifdef __SSE2__
+  __m128i sign = _mm_setzero_si128();
+  for (; i + 2 <= n; i += 2) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<__m128i *>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<__m128i *>(b + i));
+    sign = _mm_or_si128(sign, _mm_sub_epi64(vb, va));
+  }
+  if (_mm_movemask_pd(_mm_castsi128_pd(sign)))
+    return false;
+#endif
+  for (; i < n; i++) {
+    if (a[i] > b[i])
       return false;
   }
-
   return true;
 }
 
-bool VectorClock::HappensAfter(VectorClock *vc) {
-  ThreadClockMap::iterator curr_it = map_.begin();
-  ThreadClockMap::iterator vc_it = vc->map_.begin();
-  for (; vc_it != vc->map_.end(); ++vc_it) {
-    thread_id_t vc_thd_id = vc_it->first;
-    timestamp_t vc_thd_clk = vc_it->second;
-
-    bool valid = false;
-    for (; curr_it != map_.end(); ++curr_it) {
-      thread_id_t curr_thd_id = curr_it->first;
-      timestamp_t curr_thd_clk = curr_it->second;
-
-      if (curr_thd_id == vc_thd_id) {
-        if (curr_thd_clk >= vc_thd_clk) {
-          valid = true;
-          ++curr_it;
-        }
-        break;
-      } else if (curr_thd_id > vc_thd_id) {
-        break;
-      }
-    }
-
-    if (!valid)
-      return false;
+// set a[i] to MAX(a[i], b[i]) for all i < n
+static void ClocksMax(timestamp_t *a, timestamp_t *b, size_t n) {
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 2 <= n; i += 2) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<__m128i *>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<__m128i *>(b + i));
+    // all ones in the lanes where b < a
+    __m128i mask = _mm_shuffle_epi32(_mm_srai_epi32(_mm_sub_epi64(vb, va), 31),
+                                     _MM_SHUFFLE(3, 3, 1, 1));
+    __m128i vmax = _mm_or_si128(_mm_and_si128(mask, va),
+                                _mm_andnot_si128(mask, vb));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(a + i), vmax);
   }
+#endif
+  for (; i < n; i++)
+    a[i] = MAX(a[i], b[i]);
+}
 
+// return true if a[i] == b[i] for all i < n
+static bool ClocksEqual(timestamp_t *a, timestamp_t *b, size_t n) {
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 2 <= n; i += 2) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<__m128i *>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<__m128i *>(b + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(va, vb)) != 0xFFFF)
+      return false;
+  }
+#endif
+  for (; i < n; i++) {
+    if (a[i] != b[i])
+      return false;
+  }
   return true;
 }
 
-void VectorClock::Join(VectorClock *vc) {
-  for (ThreadClockMap::iterator it = vc->map_.begin();
-       it != vc->map_.end(); ++it) {
-    ThreadClockMap::iterator mit = map_.find(it->first);
-    if (mit == map_.end()) {
-      map_[it->first] = it->second;
-    } else {
-      mit->second = MAX(it->second, mit->second);
-    }
+// return true if a[i] == 0 for all i < n
+static bool ClocksZero(timestamp_t *a, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (a[i])
+      return false;
   }
+  return true;
 }
 
-void VectorClock::Increment(thread_id_t thd_id) {
-  ThreadClockMap::iterator it = map_.find(thd_id);
-  if (it == map_.end()) {
-    map_[thd_id] = 1;
+VectorClock::VectorClock()
+    : size_(0),
+      buffer_(NULL),
+      it_(0) {
+  memset(inline_, 0, sizeof(inline_));
+}
+
+VectorClock::VectorClock(const VectorClock &vc)
+    : size_(0),
+      buffer_(NULL),
+      it_(0) {
+  memset(inline_, 0, sizeof(inline_));
+  *this = vc;
+}
+
+VectorClock::~VectorClock() {
+  Release();
+}
+
+VectorClock &VectorClock::operator=(const VectorClock &vc) {
+  if (this == &vc)
+    return *this;
+
+  Release();
+  size_ = vc.size_;
+  if (size_ <= VC_INLINE_SIZE) {
+    // small enough to be stored inline
+    memcpy(inline_, vc.buffer_ ? vc.buffer_->clk : vc.inline_,
+           sizeof(timestamp_t) * size_);
   } else {
-    it->second++;
+    // share the buffer until one of the copies is modified
+    ATOMIC_ADD_AND_FETCH(&vc.buffer_->ref_count, 1);
+    buffer_ = vc.buffer_;
   }
+  return *this;
+}
+
+bool VectorClock::HappensBefore(VectorClock *vc) {
+  if (buffer_ && buffer_ == vc->buffer_ && size_ == vc->size_)
+    return true;
+
+  size_t n = MIN(size_, vc->size_);
+  if (!ClocksLessEqual(Data(), vc->Data(), n))
+    return false;
+  return ClocksZero(Data() + n, size_ - n);
+}
+
+bool VectorClock::HappensAfter(VectorClock *vc) {
+  return vc->HappensBefore(this);
+}
+
+void VectorClock::Join(VectorClock *vc) {
+  // avoid modifying (and unsharing) the storage if nothing changes
+  if (vc->HappensBefore(this))
+    return;
+
+  timestamp_t *clk = MutableData(vc->size_);
+  ClocksMax(clk, vc->Data(), vc->size_);
+  size_ = MAX(size_, vc->size_);
+}
+
+void VectorClock::Increment(thread_id_t thd_id) {
+  size_t slot = ThreadIndex::Get(thd_id);
+  timestamp_t *clk = MutableData(slot + 1);
+  clk[slot]++;
+  size_ = MAX(size_, slot + 1);
 }
 
 timestamp_t VectorClock::GetClock(thread_id_t thd_id) {
-  ThreadClockMap::iterator it = map_.find(thd_id);
-  if (it == map_.end())
+  size_t slot = ThreadIndex::Find(thd_id);
+  if (slot >= size_)
     return 0;
   else
-    return it->second;
+    return Data()[slot];
 }
 
 void VectorClock::SetClock(thread_id_t thd_id, timestamp_t clk) {
-  map_[thd_id] = clk;
+  size_t slot = ThreadIndex::Get(thd_id);
+  MutableData(slot + 1)[slot] = clk;
+  size_ = MAX(size_, slot + 1);
 }
 
 bool VectorClock::Equal(VectorClock *vc) {
-  if (map_.size() != vc->map_.size())
-    return false;
+  if (buffer_ && buffer_ == vc->buffer_ && size_ == vc->size_)
+    return true;
 
-  ThreadClockMap::iterator curr_it = map_.begin();
-  ThreadClockMap::iterator vc_it = vc->map_.begin();
-  for (; curr_it != map_.end() && vc_it != vc->map_.end(); ++curr_it, ++vc_it) {
-    if (curr_it->first != vc_it->first || curr_it->second != vc_it->second) {
-      return false;
-    }
-  }
-
-  return true;
+  size_t n = MIN(size_, vc->size_);
+  return ClocksEqual(Data(), vc->Data(), n) &&
+         ClocksZero(Data() + n, size_ - n) &&
+         ClocksZero(vc->Data() + n, vc->size_ - n);
 }
 
 std::string VectorClock::ToString() {
   std::stringstream ss;
   ss << "[";
-  for (ThreadClockMap::iterator it = map_.begin(); it != map_.end(); ++it) {
-    ss << "T" << std::hex << it->first << ":" << std::dec << it->second << " ";
+  for (size_t slot = NextSlot(0); slot < size_; slot = NextSlot(slot + 1)) {
+    ss << "T" << std::hex << ThreadIndex::Thread(slot) << ":";
+    ss << std::dec << Data()[slot] << " ";
   }
   ss << "]";
   return ss.str();
 }
 
+timestamp_t *VectorClock::MutableData(size_t size) {
+  size = MAX(size, size_);
+  if (!buffer_) {
+    if (size <= VC_INLINE_SIZE)
+      return inline_;
+    // move the clocks out of the inline storage
+    Buffer *buffer = NewBuffer(MAX(size, 2 * VC_INLINE_SIZE));
+    memcpy(buffer->clk, inline_, sizeof(timestamp_t) * size_);
+    memset(inline_, 0, sizeof(inline_));
+    buffer_ = buffer;
+    return buffer_->clk;
+  }
+
+  if (buffer_->ref_count == 1 && size <= buffer_->capacity)
+    return buffer_->clk;
+
+  // the buffer is shared or too small, make a private copy
+  size_t capacity = buffer_->capacity;
+  while (capacity < size)
+    capacity *= 2;
+  Buffer *buffer = NewBuffer(capacity);
+  memcpy(buffer->clk, buffer_->clk, sizeof(timestamp_t) * size_);
+  Release();
+  buffer_ = buffer;
+  return buffer_->clk;
+}
+
+size_t VectorClock::NextSlot(size_t slot) {
+  timestamp_t *clk = Data();
+  while (slot < size_ && !clk[slot])
+    slot++;
+  return slot;
+}
+
+void VectorClock::Release() {
+  if (buffer_) {
+    if (ATOMIC_SUB_AND_FETCH(&buffer_->ref_count, 1) == 0)
+      free(buffer_);
+    buffer_ = NULL;
+  } else {
+    memset(inline_, 0, sizeof(timestamp_t) * size_);
+  }
+}
+
+VectorClock::Buffer *VectorClock::NewBuffer(size_t capacity) {
+  size_t buffer_size = sizeof(Buffer) + sizeof(timestamp_t) * (capacity - 1);
+  Buffer *buffer = static_cast<Buffer *>(calloc(1, buffer_size));
+  buffer->ref_count = 1;
+  buffer->capacity = capacity;
+  return buffer;
+}
+
@@ -19,15 +19,26 @@
 #ifndef CORE_VECTOR_CLOCK_H_
 #define CORE_VECTOR_CLOCK_H_
 
-#include <map>
+#include <string>
 
 #include "core/basictypes.h"
+#include "core/thread_index.h"
 
-// Vector clock.
+// the number of clocks stored inside the vector clock object itself
+#define VC_INLINE_SIZE 8
+
+// Vector clock. The clocks are stored densely, indexed by the compact
+// thread index (the slot) of each thread. Small vector clocks are
+// stored inline. Larger ones are stored in a reference counted buffer
+// that is shared between copies until one of them is modified (copy on
+// write). Missing entries have clock 0.
 class VectorClock {
  public:
-  VectorClock() {}
-  ~VectorClock() {}
+  VectorClock();
+  VectorClock(const VectorClock &vc);
+  ~VectorClock();
+
+  VectorClock &operator=(const VectorClock &vc);
 
   bool HappensBefore(VectorClock *vc);
   bool HappensAfter(VectorClock *vc);
@@ -37,19 +48,34 @@ class VectorClock {
   void SetClock(thread_id_t thd_id, timestamp_t clk);
   bool Equal(VectorClock *vc);
   std::string ToString();
-  void IterBegin() { it_ = map_.begin(); }
-  bool IterEnd() { return it_ == map_.end(); }
-  void IterNext() { ++it_; }
-  thread_id_t IterCurrThd() { return it_->first; }
-  timestamp_t IterCurrClk() { return it_->second; }
+  void IterBegin() { it_ = NextSlot(0); }
+  bool IterEnd() { return it_ >= size_; }
+  void IterNext() { it_ = NextSlot(it_ + 1); }
+  thread_id_t IterCurrThd() { return ThreadIndex::Thread(it_); }
+  timestamp_t IterCurrClk() { return Data()[it_]; }
 
  private:
-  typedef std::map<thread_id_t, timestamp_t> ThreadClockMap;
+  // the shared storage for large vector clocks
+  struct Buffer {
+    long ref_count;
+    size_t capacity;
+    timestamp_t clk[1];
+  };
+
+  timestamp_t *Data() { return buffer_ ? buffer_->clk : inline_; }
+  size_t Capacity() { return buffer_ ? buffer_->capacity : VC_INLINE_SIZE; }
+  // return the storage for modification, which holds at least size
+  // clocks and is not shared with other vector clocks
+  timestamp_t *MutableData(size_t size);
+  size_t NextSlot(size_t slot);
+  void Release();
 
-  ThreadClockMap map_;
-  ThreadClockMap::iterator it_;
+  static Buffer *NewBuffer(size_t capacity);
 
-  // using default copy constructor and assignment operator
+  size_t size_; // the number of slots in use
+  Buffer *buffer_; // NULL if the clocks are stored inline
+  timestamp_t inline_[VC_INLINE_SIZE];
+  size_t it_;
 };
 
 #endif
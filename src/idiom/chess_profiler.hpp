@@ -38,6 +38,9 @@ class ChessProfiler : public systematic::Controller {
   ~ChessProfiler() {}
 
  private:
+  InstSharingDB *CreateInstSharingDB() {
+    return new sinst::SharedInstDB(CreateMutex());
+  }
   void HandlePreSetup();
   void HandlePostSetup();
   bool HandleIgnoreInstCount(IMG img);
@@ -72,7 +72,7 @@ int iRoot::GetNumEvents(IdiomType idiom) {
   return num_args;
 }
 
-iRootDB::iRootDB(Mutex *lock)
+iRootDB::iRootDB(RWMutex *lock)
     : internal_lock_(lock),
       curr_event_id_(0),
       curr_iroot_id_(0) {
@@ -81,9 +81,14 @@ iRootDB::iRootDB(Mutex *lock)
 
 iRootEvent *iRootDB::GetiRootEvent(Inst *inst, iRootEventType type,
                                    bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  // most events exist already, look them up with the read lock
+  iRootEvent *event = FindiRootEvent(inst, type, locking);
+  if (event)
+    return event;
 
-  iRootEvent *event = FindiRootEvent(inst, type, false);
+  ScopedWriteLock locker(internal_lock_, locking);
+
+  event = FindiRootEvent(inst, type, false);
   if (!event)
     event = CreateiRootEvent(inst, type, false);
   return event;
@@ -91,7 +96,7 @@ iRootEvent *iRootDB::GetiRootEvent(Inst *inst, iRootEventType type,
 
 iRootEvent *iRootDB::FindiRootEvent(iroot_event_id_t event_id,
                                     bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedReadLock locker(internal_lock_, locking);
 
   iRootEventMap::iterator it = event_map_.find(event_id);
   if (it == event_map_.end())
@@ -101,8 +106,6 @@ iRootEvent *iRootDB::FindiRootEvent(iroot_event_id_t event_id,
 }
 
 iRoot *iRootDB::GetiRoot(IdiomType idiom, bool locking, ...) {
-  ScopedLock locker(internal_lock_, locking);
-
   int num_args = iRoot::GetNumEvents(idiom);
   iRootEventVec events;
   va_list vl;
@@ -113,14 +116,21 @@ iRoot *iRootDB::GetiRoot(IdiomType idiom, bool locking, ...) {
   }
   va_end(vl);
 
-  iRoot *iroot = FindiRoot(idiom, &events, false);
+  // most iroots exist already, look them up with the read lock
+  iRoot *iroot = FindiRoot(idiom, &events, locking);
+  if (iroot)
+    return iroot;
+
+  ScopedWriteLock locker(internal_lock_, locking);
+
+  iroot = FindiRoot(idiom, &events, false);
   if (!iroot)
     iroot = CreateiRoot(idiom, &events, false);
   return iroot;
 }
 
 iRoot *iRootDB::FindiRoot(iroot_id_t iroot_id, bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedReadLock locker(internal_lock_, locking);
 
   iRootMap::iterator it = iroot_map_.find(iroot_id);
   if (it == iroot_map_.end())
@@ -131,7 +141,7 @@ iRoot *iRootDB::FindiRoot(iroot_id_t iroot_id, bool locking) {
 
 iRootEvent *iRootDB::FindiRootEvent(Inst *inst, iRootEventType type,
                                     bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedReadLock locker(internal_lock_, locking);
 
   size_t hash_val = HashiRootEvent(inst, type);
   iRootEventHashIndex::iterator it = event_index_.find(hash_val);
@@ -149,7 +159,7 @@ iRootEvent *iRootDB::FindiRootEvent(Inst *inst, iRootEventType type,
 
 iRootEvent *iRootDB::CreateiRootEvent(Inst *inst, iRootEventType type,
                                       bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedWriteLock locker(internal_lock_, locking);
 
   iRootEventProto *event_proto = proto_.add_event();
   iroot_event_id_t event_id = GetNextiRootEventID();
@@ -165,7 +175,7 @@ iRootEvent *iRootDB::CreateiRootEvent(Inst *inst, iRootEventType type,
 
 iRoot *iRootDB::FindiRoot(IdiomType idiom, iRootEventVec *events,
                           bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedReadLock locker(internal_lock_, locking);
 
   size_t hash_val = HashiRoot(idiom, events);
   iRootHashIndex::iterator it = iroot_index_.find(hash_val);
@@ -192,7 +202,7 @@ iRoot *iRootDB::FindiRoot(IdiomType idiom, iRootEventVec *events,
 
 iRoot *iRootDB::CreateiRoot(IdiomType idiom, iRootEventVec *events,
                             bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedWriteLock locker(internal_lock_, locking);
 
   iRootProto *iroot_proto = proto_.add_iroot();
   iroot_id_t iroot_id = GetNextiRootID();
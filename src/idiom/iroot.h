@@ -103,7 +103,7 @@ class iRoot {
 
 class iRootDB {
  public:
-  explicit iRootDB(Mutex *lock);
+  explicit iRootDB(RWMutex *lock);
   ~iRootDB() {}
 
   iRootEvent *GetiRootEvent(Inst *inst, iRootEventType type, bool locking);
@@ -146,7 +146,7 @@ class iRootDB {
     return hash_val;
   }
 
-  Mutex *internal_lock_;
+  RWMutex *internal_lock_;
   iroot_event_id_t curr_event_id_;
   iroot_id_t curr_iroot_id_;
   iRootEventMap event_map_;
@@ -45,7 +45,7 @@ void MemoTool::HandlePostSetup() {
   OfflineTool::HandlePostSetup();
 
   // Load the iroot database.
-  iroot_db_ = new iRootDB(CreateMutex());
+  iroot_db_ = new iRootDB(CreateRWMutex());
   iroot_db_->Load(knob_->ValueStr("iroot_in"), sinfo_);
   // load the memoization database.
   memo_ = new Memo(CreateMutex(), iroot_db_);
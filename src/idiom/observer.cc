@@ -33,13 +33,15 @@ Observer::Observer()
       unit_size_(4),
       complex_idioms_(false),
       vw_(1000),
-      filter_(NULL) {
+      filter_(NULL),
+      meta_map_(NULL) {
   // empty
 }
 
 Observer::~Observer() {
   delete internal_lock_;
   delete filter_;
+  delete meta_map_;
 }
 
 void Observer::Register() {
@@ -69,9 +71,11 @@ void Observer::Setup(Mutex *lock, StaticInfo *sinfo, iRootDB *iroot_db,
   complex_idioms_ = knob_->ValueBool("complex_idioms");
   vw_ = knob_->ValueInt("vw");
   filter_ = new RegionFilter(internal_lock_->Clone());
+  meta_map_ = new MetaMap(unit_size_);
 
   if (!sync_only_)
     desc_.SetHookBeforeMem();
+  desc_.SetPublishMemRegion();
   desc_.SetHookPthreadFunc();
   desc_.SetHookMallocFunc();
   desc_.SetTrackInstCount();
@@ -252,33 +256,33 @@ void Observer::AfterValloc(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
 }
 
 ObserverMemMeta *Observer::GetMemMeta(address_t iaddr) {
-  MetaMap::iterator it = meta_map_.find(iaddr);
-  if (it == meta_map_.end()) {
+  ObserverMeta **slot = meta_map_->Get(iaddr);
+  if (!*slot) {
     ObserverMemMeta *meta = new ObserverMemMeta;
-    meta_map_[iaddr] = meta;
+    *slot = meta;
     return meta;
   } else {
     // check the type of the existing meta for this address
-    ObserverMemMeta *meta = dynamic_cast<ObserverMemMeta *>(it->second);
+    ObserverMemMeta *meta = dynamic_cast<ObserverMemMeta *>(*slot);
     return meta; // could be NULL
   }
 }
 
 ObserverMutexMeta *Observer::GetMutexMeta(address_t iaddr) {
-  MetaMap::iterator it = meta_map_.find(iaddr);
-  if (it == meta_map_.end()) {
+  ObserverMeta **slot = meta_map_->Get(iaddr);
+  if (!*slot) {
     ObserverMutexMeta *meta = new ObserverMutexMeta;
-    meta_map_[iaddr] = meta;
+    *slot = meta;
     return meta;
   } else {
     // check the type of the existing meta for this address
-    ObserverMutexMeta *meta = dynamic_cast<ObserverMutexMeta *>(it->second);
+    ObserverMutexMeta *meta = dynamic_cast<ObserverMutexMeta *>(*slot);
     if (meta) {
       return meta;
     } else {
-      delete it->second;
+      delete *slot;
       meta = new ObserverMutexMeta;
-      it->second = meta;
+      *slot = meta;
       return meta;
     }
   }
@@ -288,6 +292,8 @@ void Observer::AllocAddrRegion(address_t addr, size_t size) {
   ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(addr && size);
   filter_->AddRegion(addr, size, false);
+  if (access_predicate_)
+    access_predicate_->AddRegion(addr, size);
 }
 
 void Observer::FreeAddrRegion(address_t addr) {
@@ -297,13 +303,15 @@ void Observer::FreeAddrRegion(address_t addr) {
   size_t size = filter_->RemoveRegion(addr, false);
   address_t start_addr = UNIT_DOWN_ALIGN(addr, unit_size_);
   address_t end_addr = UNIT_UP_ALIGN(addr + size, unit_size_);
-  for (address_t iaddr = start_addr; iaddr < end_addr; iaddr += unit_size_) {
-    MetaMap::iterator it = meta_map_.find(iaddr);
-    if (it != meta_map_.end()) {
-      delete it->second;
-      meta_map_.erase(it);
-    }
+  // only visit the existing meta data
+  address_t iaddr = start_addr;
+  for (ObserverMeta **slot = meta_map_->FindNext(iaddr, end_addr, &iaddr);
+       slot;
+       slot = meta_map_->FindNext(iaddr + unit_size_, end_addr, &iaddr)) {
+    delete *slot;
+    *slot = NULL;
   }
+  meta_map_->Release(addr, size);
 }
 
 bool Observer::FilterAccess(address_t addr) {
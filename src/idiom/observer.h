@@ -31,6 +31,7 @@
 #include "core/analyzer.h"
 #include "core/static_info.h"
 #include "core/filter.h"
+#include "core/shadow_memory.h"
 #include "idiom/iroot.h"
 #include "idiom/memo.h"
 #include "sinst/sinst.h"
@@ -209,7 +210,7 @@ class Observer : public Analyzer {
                    Inst *inst, size_t size, address_t addr);
 
  private:
-  typedef std::tr1::unordered_map<address_t, ObserverMeta *> MetaMap;
+  typedef ShadowMemory<ObserverMeta *> MetaMap;
 
   ObserverMemMeta *GetMemMeta(address_t iaddr);
   ObserverMutexMeta *GetMutexMeta(address_t iaddr);
@@ -247,7 +248,7 @@ class Observer : public Analyzer {
   timestamp_t vw_; // vulnerability window
   RegionFilter *filter_;
   std::map<thread_id_t, ObserverLocalInfo> local_info_map_;
-  MetaMap meta_map_;
+  MetaMap *meta_map_;
 
   DISALLOW_COPY_CONSTRUCTORS(Observer);
 };
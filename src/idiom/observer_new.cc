@@ -89,6 +89,7 @@ void ObserverNew::Setup(Mutex *lock,
   // setup analysis descriptor
   if (!sync_only_)
     desc_.SetHookBeforeMem();
+  desc_.SetPublishMemRegion();
   desc_.SetHookPthreadFunc();
   desc_.SetHookMallocFunc();
   desc_.SetTrackInstCount();
@@ -349,6 +350,8 @@ void ObserverNew::AllocAddrRegion(address_t addr, size_t size) {
   DEBUG_ASSERT(addr && size);
   ScopedLock locker(internal_lock_);
   filter_->AddRegion(addr, size, false);
+  if (access_predicate_)
+    access_predicate_->AddRegion(addr, size);
 }
 
 void ObserverNew::FreeAddrRegion(address_t addr) {
@@ -39,6 +39,9 @@ class PCTProfiler : public pct::Scheduler {
   ~PCTProfiler() {}
 
  private:
+  InstSharingDB *CreateInstSharingDB() {
+    return new sinst::SharedInstDB(CreateMutex());
+  }
   void HandlePreSetup();
   void HandlePostSetup();
   bool HandleIgnoreInstCount(IMG img);
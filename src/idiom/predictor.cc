@@ -19,6 +19,7 @@
 #include "idiom/predictor.h"
 
 #include <csignal>
+#include <cstring>
 #include <sys/syscall.h>
 #include "core/logging.h"
 #include "core/knob.h"
@@ -77,6 +78,7 @@ void Predictor::Setup(Mutex *lock, StaticInfo *sinfo, iRootDB *iroot_db,
 
   if (!sync_only_) {
     desc_.SetHookBeforeMem();
+    desc_.SetPublishMemRegion();
   }
   desc_.SetHookSyscall();
   desc_.SetHookSignal();
@@ -240,7 +242,7 @@ void Predictor::BeforeMemWrite(thread_id_t curr_thd_id,
 
 void Predictor::BeforeAtomicInst(thread_id_t curr_thd_id,
                                  timestamp_t curr_thd_clk, Inst *inst,
-                                 std::string type, address_t addr) {
+                                 opcode_type opcode, address_t addr) {
   // use heuristics to find locks and unlocks in libc library
   // the main idea is to identify special lock prefixed instructions
   if (!inst->image()->IsLibc())
@@ -252,7 +254,7 @@ void Predictor::BeforeAtomicInst(thread_id_t curr_thd_id,
   LockSet *curr_ls = curr_ls_map_[curr_thd_id];
   DEBUG_ASSERT(curr_ls);
 
-  if (type.compare("DEC") == 0) {
+  if (strcmp(OpcodeName(opcode), "DEC") == 0) {
     //DEBUG_FMT_PRINT_SAFE("[T%lx] internal libc unlock(0x%lx)\n",
     //                     curr_thd_id, addr);
     DEBUG_ASSERT(UNIT_DOWN_ALIGN(addr, unit_size_) == addr);
@@ -265,7 +267,7 @@ void Predictor::BeforeAtomicInst(thread_id_t curr_thd_id,
 
 void Predictor::AfterAtomicInst(thread_id_t curr_thd_id,
                                 timestamp_t curr_thd_clk, Inst *inst,
-                                std::string type, address_t addr) {
+                                opcode_type opcode, address_t addr) {
   // use heuristics to find locks and unlocks in libc library
   // the main idea is to identify special lock prefixed instructions
   if (!inst->image()->IsLibc())
@@ -280,7 +282,7 @@ void Predictor::AfterAtomicInst(thread_id_t curr_thd_id,
   // make sure that read/write in an atomic inst. are treated as a unit
   curr_ls->Remove(~addr);
 
-  if (type.compare("CMPXCHG") == 0) {
+  if (strcmp(OpcodeName(opcode), "CMPXCHG") == 0) {
     //DEBUG_FMT_PRINT_SAFE("[T%lx] internal libc lock(0x%lx)\n",
     //                     curr_thd_id, addr);
     DEBUG_ASSERT(UNIT_DOWN_ALIGN(addr, unit_size_) == addr);
@@ -552,6 +554,8 @@ void Predictor::AllocAddrRegion(address_t addr, size_t size) {
   ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(addr && size);
   filter_->AddRegion(addr, size, false);
+  if (access_predicate_)
+    access_predicate_->AddRegion(addr, size);
 }
 
 void Predictor::FreeAddrRegion(address_t addr) {
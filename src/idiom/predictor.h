@@ -380,9 +380,9 @@ class Predictor : public Analyzer {
   void BeforeMemWrite(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
                       Inst *inst, address_t addr, size_t size);
   void BeforeAtomicInst(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
-                        Inst *inst, std::string type, address_t addr);
+                        Inst *inst, opcode_type opcode, address_t addr);
   void AfterAtomicInst(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
-                       Inst *inst, std::string type, address_t addr);
+                       Inst *inst, opcode_type opcode, address_t addr);
   void AfterPthreadCreate(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
                           Inst *inst, thread_id_t child_thd_id);
   void AfterPthreadJoin(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
@@ -22,6 +22,7 @@
 #include <cassert>
 #include <cstdarg>
 #include <csignal>
+#include <cstring>
 #include <sys/syscall.h>
 #include "core/logging.h"
 #include "core/stat.h"
@@ -97,6 +98,7 @@ void PredictorNew::Setup(Mutex *lock,
   // setup analysis descriptor
   if (!sync_only_) {
     desc_.SetHookBeforeMem();
+    desc_.SetPublishMemRegion();
   }
   desc_.SetHookSyscall();
   desc_.SetHookSignal();
@@ -345,13 +347,13 @@ void PredictorNew::BeforeMemWrite(thread_id_t curr_thd_id,
 void PredictorNew::BeforeAtomicInst(thread_id_t curr_thd_id,
                                     timestamp_t curr_thd_clk,
                                     Inst *inst,
-                                    std::string type,
+                                    opcode_type opcode,
                                     address_t addr) {
   ScopedLock locker(internal_lock_);
   atomic_inst_set_.insert(inst);
   // use heuristics to find locks and unlocks in libc library
   // the main idea is to identify special lock prefixed instructions
-  if (inst->image()->IsLibc() && type.compare("DEC") == 0) {
+  if (inst->image()->IsLibc() && strcmp(OpcodeName(opcode), "DEC") == 0) {
     LockSet *curr_ls = curr_ls_map_[curr_thd_id];
     DEBUG_ASSERT(curr_ls);
     DEBUG_ASSERT(UNIT_DOWN_ALIGN(addr, unit_size_) == addr);
@@ -362,12 +364,12 @@ void PredictorNew::BeforeAtomicInst(thread_id_t curr_thd_id,
 void PredictorNew::AfterAtomicInst(thread_id_t curr_thd_id,
                                    timestamp_t curr_thd_clk,
                                    Inst *inst,
-                                   std::string type,
+                                   opcode_type opcode,
                                    address_t addr) {
   ScopedLock locker(internal_lock_);
   // use heuristics to find locks and unlocks in libc library
   // the main idea is to identify special lock prefixed instructions
-  if (inst->image()->IsLibc() && type.compare("CMPXCHG") == 0) {
+  if (inst->image()->IsLibc() && strcmp(OpcodeName(opcode), "CMPXCHG") == 0) {
     LockSet *curr_ls = curr_ls_map_[curr_thd_id];
     DEBUG_ASSERT(curr_ls);
     DEBUG_ASSERT(UNIT_DOWN_ALIGN(addr, unit_size_) == addr);
@@ -836,6 +838,8 @@ void PredictorNew::AllocAddrRegion(address_t addr, size_t size) {
   DEBUG_ASSERT(addr && size);
   ScopedLock locker(internal_lock_);
   filter_->AddRegion(addr, size, false);
+  if (access_predicate_)
+    access_predicate_->AddRegion(addr, size);
 }
 
 void PredictorNew::FreeAddrRegion(address_t addr) {
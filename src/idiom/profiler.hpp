@@ -38,6 +38,9 @@ class Profiler : public ExecutionControl {
   ~Profiler() {}
 
  private:
+  InstSharingDB *CreateInstSharingDB() {
+    return new sinst::SharedInstDB(CreateMutex());
+  }
   void HandlePreSetup();
   void HandlePostSetup();
   bool HandleIgnoreInstCount(IMG img);
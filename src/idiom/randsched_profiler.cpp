@@ -62,14 +62,19 @@ void RandSchedProfiler::HandlePostSetup() {
   randsched::Scheduler::HandlePostSetup();
 
   // load iroot db
-  iroot_db_ = new iRootDB(CreateMutex());
+  iroot_db_ = new iRootDB(CreateRWMutex());
   iroot_db_->Load(knob_->ValueStr("iroot_in"), sinfo_);
   // load memoization db
   memo_ = new Memo(CreateMutex(), iroot_db_);
   memo_->Load(knob_->ValueStr("memo_in"), sinfo_);
-  // load shared inst db
-  sinst_db_ = new sinst::SharedInstDB(CreateMutex());
-  sinst_db_->Load(knob_->ValueStr("sinst_in"), sinfo_);
+  // load shared inst db (reuse the one loaded for pruning if any, which
+  // is created by CreateInstSharingDB)
+  if (prune_db_) {
+    sinst_db_ = static_cast<sinst::SharedInstDB *>(prune_db_);
+  } else {
+    sinst_db_ = new sinst::SharedInstDB(CreateMutex());
+    sinst_db_->Load(knob_->ValueStr("sinst_in"), sinfo_);
+  }
 
   if (sinst_analyzer_->Enabled()) {
     // create sinst analyzer
@@ -145,8 +150,9 @@ void RandSchedProfiler::HandleProgramExit() {
   iroot_db_->Save(knob_->ValueStr("iroot_out"), sinfo_);
   // save memoization db
   memo_->Save(knob_->ValueStr("memo_out"), sinfo_);
-  // save shared instruction db
-  sinst_db_->Save(knob_->ValueStr("sinst_out"), sinfo_);
+  // save shared instruction db (saved by the controller if pruning)
+  if (sinst_db_ != prune_db_)
+    sinst_db_->Save(knob_->ValueStr("sinst_out"), sinfo_);
 }
 
 } // namespace idiom
@@ -39,6 +39,9 @@ class RandSchedProfiler : public randsched::Scheduler {
   ~RandSchedProfiler() {}
 
  private:
+  InstSharingDB *CreateInstSharingDB() {
+    return new sinst::SharedInstDB(CreateMutex());
+  }
   void HandlePreSetup();
   void HandlePostSetup();
   bool HandleIgnoreInstCount(IMG img);
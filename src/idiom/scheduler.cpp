@@ -56,9 +56,14 @@ void Scheduler::HandlePostSetup() {
   // load memoization db
   memo_ = new Memo(CreateMutex(), iroot_db_);
   memo_->Load(knob_->ValueStr("memo_in"), sinfo_);
-  // load shared inst db
-  sinst_db_ = new sinst::SharedInstDB(CreateMutex());
-  sinst_db_->Load(knob_->ValueStr("sinst_in"), sinfo_);
+  // load shared inst db (reuse the one loaded for pruning if any, which
+  // is created by CreateInstSharingDB)
+  if (prune_db_) {
+    sinst_db_ = static_cast<sinst::SharedInstDB *>(prune_db_);
+  } else {
+    sinst_db_ = new sinst::SharedInstDB(CreateMutex());
+    sinst_db_->Load(knob_->ValueStr("sinst_in"), sinfo_);
+  }
 
   if (sinst_analyzer_->Enabled()) {
     // add sinst analyzer
@@ -115,13 +120,14 @@ void Scheduler::HandleProgramExit() {
   // save memoization
   memo_->RefineCandidate(knob_->ValueBool("memo_failed"));
   memo_->Save(knob_->ValueStr("memo_out"), sinfo_);
-  // save shared instruction db
-  sinst_db_->Save(knob_->ValueStr("sinst_out"), sinfo_);
+  // save shared instruction db (saved by the controller if pruning)
+  if (sinst_db_ != prune_db_)
+    sinst_db_->Save(knob_->ValueStr("sinst_out"), sinfo_);
 }
 
 void Scheduler::Choose() {
   // set current iroot to test
-  int target_iroot_id = knob_->ValueInt("target_iroot");
+  int target_iroot_id = target_iroot_knob_.Value();
   int target_idiom_int = knob_->ValueInt("target_idiom");
   if (target_iroot_id) {
     curr_iroot_ = memo_->ChooseForTest((iroot_id_t)target_iroot_id);
@@ -141,20 +147,20 @@ void Scheduler::Choose() {
 
 void Scheduler::TestSuccess() {
   SchedulerCommon::TestSuccess();
-  if (!knob_->ValueInt("target_iroot")) {
+  if (!target_iroot_knob_.Value()) {
     memo_->TestSuccess(curr_iroot_, true);
   }
 }
 
 void Scheduler::TestFail() {
   SchedulerCommon::TestFail();
-  if (!knob_->ValueInt("target_iroot")) {
+  if (!target_iroot_knob_.Value()) {
     memo_->TestFail(curr_iroot_, false);
   }
 }
 
 bool Scheduler::UseDecreasingPriorities() {
-  if (knob_->ValueInt("target_iroot")) {
+  if (target_iroot_knob_.Value()) {
     return history_->TotalTestRuns(curr_iroot_) % 2 == 0;
   } else {
     return memo_->TotalTestRuns(curr_iroot_, true) % 2 == 0;
@@ -162,7 +168,7 @@ bool Scheduler::UseDecreasingPriorities() {
 }
 
 bool Scheduler::YieldWithDelay() {
-  if (knob_->ValueBool("yield_with_delay")) {
+  if (yield_with_delay_knob_.Value()) {
     if (memo_->Async(curr_iroot_, true)) {
       return true;
     }
@@ -35,6 +35,9 @@ class Scheduler : public SchedulerCommon {
   ~Scheduler() {}
 
  protected:
+  InstSharingDB *CreateInstSharingDB() {
+    return new sinst::SharedInstDB(CreateMutex());
+  }
   void HandlePreSetup();
   void HandlePostSetup();
   bool HandleIgnoreInstCount(IMG img);
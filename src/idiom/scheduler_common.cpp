@@ -186,12 +186,21 @@ void SchedulerCommon::HandlePreSetup() {
 void SchedulerCommon::HandlePostSetup() {
   ExecutionControl::HandlePostSetup();
 
+  // bind cached knobs
+  strict_knob_.Bind(knob_, "strict");
+  target_iroot_knob_.Bind(knob_, "target_iroot");
+  yield_with_delay_knob_.Bind(knob_, "yield_with_delay");
+  yield_delay_unit_knob_.Bind(knob_, "yield_delay_unit");
+  yield_delay_min_each_knob_.Bind(knob_, "yield_delay_min_each");
+  yield_delay_max_total_knob_.Bind(knob_, "yield_delay_max_total");
+  ordered_new_thread_prio_knob_.Bind(knob_, "ordered_new_thread_prio");
+
   // set analysis desc
   desc_.SetHookMainFunc();
   desc_.SetHookSyscall();
 
   // load iroot db
-  iroot_db_ = new iRootDB(CreateMutex());
+  iroot_db_ = new iRootDB(CreateRWMutex());
   iroot_db_->Load(knob_->ValueStr("iroot_in"), sinfo_);
   // load test history
   history_ = new TestHistory;
@@ -231,13 +240,22 @@ void SchedulerCommon::HandlePostSetup() {
 void SchedulerCommon::HandlePreInstrumentTrace(TRACE trace) {
   ExecutionControl::HandlePreInstrumentTrace(trace);
 
+  // read the state once, so that the trace is instrumented and grouped
+  // consistently even if the state changes meanwhile
+  bool watch = InWatchState();
+
   // no need to instrument if no memory iroot event exists
   if (curr_iroot_->HasMem()) {
     InstrumentMemiRootEvent(trace);
-    InstrumentWatchInstCount(trace);
-    InstrumentWatchMem(trace);
+    InstrumentWatchInstCount(trace, watch);
+    InstrumentWatchMem(trace, watch);
+    // remember the trace so that FlushWatch can drop its code
+    if (watch)
+      AddTraceToGroup(trace, WATCH_TRACE_GROUP);
+    else
+      AddTraceToGroup(trace, NO_WATCH_TRACE_GROUP);
   } else {
-    InstrumentWatchInstCount(trace);
+    InstrumentWatchInstCount(trace, watch);
   }
 }
 
@@ -256,7 +274,7 @@ void SchedulerCommon::HandleSyscallEntry(THREADID tid, CONTEXT *ctxt,
                                    SYSCALL_STANDARD std) {
   ExecutionControl::HandleSyscallEntry(tid, ctxt, std);
 
-  int syscall_num = tls_syscall_num_[tid];
+  int syscall_num = GetThreadContext(tid)->syscall_num;
   switch (syscall_num) {
     case SYS_sched_yield:
       HandleSchedYield();
@@ -367,7 +385,7 @@ void SchedulerCommon::HandleThreadMain(THREADID tid, CONTEXT *ctxt) {
 
 void SchedulerCommon::Choose() {
   // this function should setup the curr_iroot_ field
-  int target_iroot_id = knob_->ValueInt("target_iroot");
+  int target_iroot_id = target_iroot_knob_.Value();
   curr_iroot_ = iroot_db_->FindiRoot((iroot_id_t)target_iroot_id, false);
   if (!curr_iroot_) {
     Abort("target iroot invalid\n");
@@ -379,7 +397,7 @@ bool SchedulerCommon::UseDecreasingPriorities() {
 }
 
 bool SchedulerCommon::YieldWithDelay() {
-  if (knob_->ValueBool("yield_with_delay"))
+  if (yield_with_delay_knob_.Value())
     return true;
   else
     return false;
@@ -524,237 +542,20 @@ void SchedulerCommon::CheckiRootAfterMutexUnlock(Inst *inst, address_t addr) {
   }
 }
 
-void SchedulerCommon::InstrumentWatchMem(TRACE trace) {
-  switch (curr_iroot_->idiom()) {
-      case IDIOM_1:
-        Idiom1InstrumentWatchMem(trace);
-        break;
-      case IDIOM_2:
-        Idiom2InstrumentWatchMem(trace);
-        break;
-      case IDIOM_3:
-        Idiom3InstrumentWatchMem(trace);
-        break;
-      case IDIOM_4:
-        Idiom4InstrumentWatchMem(trace);
-        break;
-      case IDIOM_5:
-        Idiom5InstrumentWatchMem(trace);
-        break;
-      default:
-        break;
-  }
-}
-
-void SchedulerCommon::InstrumentWatchInstCount(TRACE trace) {
-  switch (curr_iroot_->idiom()) {
-      case IDIOM_1:
-        // no need to instrumet
-        break;
-      case IDIOM_2:
-        Idiom2InstrumentWatchInstCount(trace);
-        break;
-      case IDIOM_3:
-        Idiom3InstrumentWatchInstCount(trace);
-        break;
-      case IDIOM_4:
-        Idiom4InstrumentWatchInstCount(trace);
-        break;
-      case IDIOM_5:
-        Idiom5InstrumentWatchInstCount(trace);
-        break;
-      default:
-        break;
-  }
-}
-
-void SchedulerCommon::Idiom1InstrumentWatchMem(TRACE trace) {
-  Idiom1SchedStatus *s = idiom1_sched_status_;
-
-  if (ContainCandidates(trace)) {
-    __InstrumentWatchMem(trace, true);
-    return;
-  }
-
-  switch (s->state_) {
-    case IDIOM1_STATE_E0_WATCH:
-      __InstrumentWatchMem(trace, false);
-      break;
-    default:
-      break;
-  }
-}
-
-void SchedulerCommon::Idiom1InstrumentWatchInstCount(TRACE trace) {
-  Idiom1SchedStatus *s = idiom1_sched_status_;
-
-  switch (s->state_) {
-    case IDIOM1_STATE_E0_WATCH:
-      __InstrumentWatchInstCount(trace);
-      break;
-    default:
-      break;
-  }
-}
-
-void SchedulerCommon::Idiom2InstrumentWatchMem(TRACE trace) {
-  Idiom2SchedStatus *s = idiom2_sched_status_;
-
-  if (ContainCandidates(trace)) {
-    __InstrumentWatchMem(trace, true);
-    return;
-  }
-
-  switch (s->state_) {
-    case IDIOM2_STATE_E0_WATCH:
-    case IDIOM2_STATE_E0_E1_WATCH:
-    case IDIOM2_STATE_E1_WATCH:
-      __InstrumentWatchMem(trace, false);
-      break;
-    default:
-      break;
-  }
-}
-
-void SchedulerCommon::Idiom2InstrumentWatchInstCount(TRACE trace) {
-  Idiom2SchedStatus *s = idiom2_sched_status_;
-
-  switch (s->state_) {
-    case IDIOM2_STATE_E0_WATCH:
-    case IDIOM2_STATE_E0_E1_WATCH:
-    case IDIOM2_STATE_E1_WATCH:
-      __InstrumentWatchInstCount(trace);
-      break;
-    default:
-      break;
-  }
-}
-
-void SchedulerCommon::Idiom3InstrumentWatchMem(TRACE trace) {
-  Idiom3SchedStatus *s = idiom3_sched_status_;
-
-  if (ContainCandidates(trace)) {
-    __InstrumentWatchMem(trace, true);
-    return;
-  }
-
-  switch (s->state_) {
-    case IDIOM3_STATE_E0_WATCH:
-    case IDIOM3_STATE_E0_E1_WATCH:
-    case IDIOM3_STATE_E1_WATCH:
-    case IDIOM3_STATE_E0_WATCH_E3:
-    case IDIOM3_STATE_E1_WATCH_E3:
-    case IDIOM3_STATE_E1_WATCH_E2:
-    case IDIOM3_STATE_E1_WATCH_E2_WATCH:
-      __InstrumentWatchMem(trace, false);
-      break;
-    default:
-      break;
-  }
-}
-
-void SchedulerCommon::Idiom3InstrumentWatchInstCount(TRACE trace) {
-  Idiom3SchedStatus *s = idiom3_sched_status_;
-
-  switch (s->state_) {
-    case IDIOM3_STATE_E0_WATCH:
-    case IDIOM3_STATE_E0_E1_WATCH:
-    case IDIOM3_STATE_E1_WATCH:
-    case IDIOM3_STATE_E0_WATCH_E3:
-    case IDIOM3_STATE_E1_WATCH_E3:
-    case IDIOM3_STATE_E1_WATCH_E2:
-    case IDIOM3_STATE_E1_WATCH_E2_WATCH:
-      __InstrumentWatchInstCount(trace);
-      break;
-    default:
-      break;
-  }
-}
-
-void SchedulerCommon::Idiom4InstrumentWatchMem(TRACE trace) {
-  Idiom4SchedStatus *s = idiom4_sched_status_;
-
-  if (ContainCandidates(trace)) {
-    __InstrumentWatchMem(trace, true);
-    return;
-  }
-
-  switch (s->state_) {
-    case IDIOM4_STATE_E0_WATCH:
-    case IDIOM4_STATE_E0_E1_WATCH:
-    case IDIOM4_STATE_E1_WATCH:
-    case IDIOM4_STATE_E0_WATCH_E3:
-    case IDIOM4_STATE_E1_WATCH_E3:
-    case IDIOM4_STATE_E1_WATCH_E2:
-    case IDIOM4_STATE_E1_WATCH_E2_WATCH:
-      __InstrumentWatchMem(trace, false);
-      break;
-    default:
-      break;
-  }
-}
-
-void SchedulerCommon::Idiom4InstrumentWatchInstCount(TRACE trace) {
-  Idiom4SchedStatus *s = idiom4_sched_status_;
-
-  switch (s->state_) {
-    case IDIOM4_STATE_E0_WATCH:
-    case IDIOM4_STATE_E0_E1_WATCH:
-    case IDIOM4_STATE_E1_WATCH:
-    case IDIOM4_STATE_E0_WATCH_E3:
-    case IDIOM4_STATE_E1_WATCH_E3:
-    case IDIOM4_STATE_E1_WATCH_E2:
-    case IDIOM4_STATE_E1_WATCH_E2_WATCH:
-      __InstrumentWatchInstCount(trace);
-      break;
-    default:
-      break;
-  }
-}
-
-void SchedulerCommon::Idiom5InstrumentWatchMem(TRACE trace) {
-  Idiom5SchedStatus *s = idiom5_sched_status_;
-
+void SchedulerCommon::InstrumentWatchMem(TRACE trace, bool watch) {
   if (ContainCandidates(trace)) {
     __InstrumentWatchMem(trace, true);
     return;
   }
 
-  switch (s->state_) {
-    case IDIOM5_STATE_E0_WATCH:
-    case IDIOM5_STATE_E2_WATCH:
-    case IDIOM5_STATE_E0_E2_WATCH:
-    case IDIOM5_STATE_E0_WATCH_E3:
-    case IDIOM5_STATE_E2_WATCH_E1:
-    case IDIOM5_STATE_E0_E2_WATCH_E3:
-    case IDIOM5_STATE_E0_E2_WATCH_E1:
-    case IDIOM5_STATE_E0_E2_WATCH_E3_WATCH:
-    case IDIOM5_STATE_E0_E2_WATCH_E1_WATCH:
-      __InstrumentWatchMem(trace, false);
-      break;
-    default:
-      break;
-  }
+  if (watch)
+    __InstrumentWatchMem(trace, false);
 }
 
-void SchedulerCommon::Idiom5InstrumentWatchInstCount(TRACE trace) {
-  Idiom5SchedStatus *s = idiom5_sched_status_;
-
-  switch (s->state_) {
-    case IDIOM5_STATE_E0_WATCH:
-    case IDIOM5_STATE_E2_WATCH:
-    case IDIOM5_STATE_E0_E2_WATCH:
-    case IDIOM5_STATE_E0_WATCH_E3:
-    case IDIOM5_STATE_E2_WATCH_E1:
-    case IDIOM5_STATE_E0_E2_WATCH_E3:
-    case IDIOM5_STATE_E0_E2_WATCH_E1:
-    case IDIOM5_STATE_E0_E2_WATCH_E3_WATCH:
-    case IDIOM5_STATE_E0_E2_WATCH_E1_WATCH:
-      __InstrumentWatchInstCount(trace);
-      break;
-    default:
-      break;
-  }
+void SchedulerCommon::InstrumentWatchInstCount(TRACE trace, bool watch) {
+  // no need to maintain inst count for idiom1
+  if (watch && curr_iroot_->idiom() != IDIOM_1)
+    __InstrumentWatchInstCount(trace);
 }
 
 void SchedulerCommon::__InstrumentWatchInstCount(TRACE trace) {
@@ -879,12 +680,82 @@ bool SchedulerCommon::IsCandidate(TRACE trace, INS ins) {
   return false;
 }
 
+bool SchedulerCommon::InWatchState() {
+  // the states in which the traces are instrumented to watch memory
+  // accesses and maintain inst count
+  switch (curr_iroot_->idiom()) {
+    case IDIOM_1:
+      switch (idiom1_sched_status_->state_) {
+        case IDIOM1_STATE_E0_WATCH:
+          return true;
+        default:
+          return false;
+      }
+    case IDIOM_2:
+      switch (idiom2_sched_status_->state_) {
+        case IDIOM2_STATE_E0_WATCH:
+        case IDIOM2_STATE_E0_E1_WATCH:
+        case IDIOM2_STATE_E1_WATCH:
+          return true;
+        default:
+          return false;
+      }
+    case IDIOM_3:
+      switch (idiom3_sched_status_->state_) {
+        case IDIOM3_STATE_E0_WATCH:
+        case IDIOM3_STATE_E0_E1_WATCH:
+        case IDIOM3_STATE_E1_WATCH:
+        case IDIOM3_STATE_E0_WATCH_E3:
+        case IDIOM3_STATE_E1_WATCH_E3:
+        case IDIOM3_STATE_E1_WATCH_E2:
+        case IDIOM3_STATE_E1_WATCH_E2_WATCH:
+          return true;
+        default:
+          return false;
+      }
+    case IDIOM_4:
+      switch (idiom4_sched_status_->state_) {
+        case IDIOM4_STATE_E0_WATCH:
+        case IDIOM4_STATE_E0_E1_WATCH:
+        case IDIOM4_STATE_E1_WATCH:
+        case IDIOM4_STATE_E0_WATCH_E3:
+        case IDIOM4_STATE_E1_WATCH_E3:
+        case IDIOM4_STATE_E1_WATCH_E2:
+        case IDIOM4_STATE_E1_WATCH_E2_WATCH:
+          return true;
+        default:
+          return false;
+      }
+    case IDIOM_5:
+      switch (idiom5_sched_status_->state_) {
+        case IDIOM5_STATE_E0_WATCH:
+        case IDIOM5_STATE_E2_WATCH:
+        case IDIOM5_STATE_E0_E2_WATCH:
+        case IDIOM5_STATE_E0_WATCH_E3:
+        case IDIOM5_STATE_E2_WATCH_E1:
+        case IDIOM5_STATE_E0_E2_WATCH_E3:
+        case IDIOM5_STATE_E0_E2_WATCH_E1:
+        case IDIOM5_STATE_E0_E2_WATCH_E3_WATCH:
+        case IDIOM5_STATE_E0_E2_WATCH_E1_WATCH:
+          return true;
+        default:
+          return false;
+      }
+    default:
+      return false;
+  }
+}
+
 void SchedulerCommon::FlushWatch() {
   DEBUG_ASSERT(curr_iroot_);
   if (curr_iroot_->HasMem()) {
-    DEBUG_FMT_PRINT_SAFE("flush code cache\n");
-    CODECACHE_FlushCache();
-    //PIN_RemoveInstrumentation();
+    // only drop the code of the traces instrumented in the other kind of
+    // states, the others are still instrumented correctly
+    DEBUG_FMT_PRINT_SAFE("flush watch traces\n");
+    if (InWatchState())
+      InvalidateTraceGroup(NO_WATCH_TRACE_GROUP);
+    else
+      InvalidateTraceGroup(WATCH_TRACE_GROUP);
   }
 }
 
@@ -915,7 +786,7 @@ Inst *SchedulerCommon::FindInst(ADDRINT pc) {
 }
 
 void SchedulerCommon::CalculatePriorities() {
-  if (knob_->ValueBool("strict")) {
+  if (strict_knob_.Value()) {
     int lowest = knob_->ValueInt("lowest_realtime_priority");
     int highest = knob_->ValueInt("highest_realtime_priority");
     min_priority_ = lowest;
@@ -952,7 +823,7 @@ int SchedulerCommon::MainThreadPriority() {
 
 int SchedulerCommon::NextNewThreadPriority() {
   int priority;
-  if (knob_->ValueBool("ordered_new_thread_prio")) {
+  if (ordered_new_thread_prio_knob_.Value()) {
     if (UseDecreasingPriorities()) {
       // decreasing priorities
       int cursor = ATOMIC_FETCH_AND_SUB(&new_thread_priorities_cursor_, 1);
@@ -971,7 +842,7 @@ int SchedulerCommon::NextNewThreadPriority() {
 
 void SchedulerCommon::InitNewThreadPriority() {
   // set new thread priorities cursor
-  if (knob_->ValueBool("ordered_new_thread_prio")) {
+  if (ordered_new_thread_prio_knob_.Value()) {
     if (UseDecreasingPriorities()) {
       // decreasing priorities
       DEBUG_FMT_PRINT_SAFE("decreasing priorities\n");
@@ -1012,7 +883,7 @@ void SchedulerCommon::SetPriority(int priority) {
   DEBUG_FMT_PRINT_SAFE("[T%" PRIx64 "] Set self priority=%d\n",
                        PIN_ThreadUid(), priority);
 
-  if (knob_->ValueBool("strict")) {
+  if (strict_knob_.Value()) {
     SetStrictPriority(priority);
   } else {
     SetRelaxPriority(priority);
@@ -1027,7 +898,7 @@ void SchedulerCommon::SetPriority(thread_id_t target, int priority) {
   priority_map_[target] = priority;
   UnlockMisc();
 
-  if (knob_->ValueBool("strict")) {
+  if (strict_knob_.Value()) {
     SetStrictPriority(target, priority);
   } else {
     SetRelaxPriority(target, priority);
@@ -2090,11 +1961,11 @@ bool SchedulerCommon::Idiom1CheckGiveup(int idx) {
                                      INVALID_THD_ID};
     static int time_delayed_each[] = {0, 0, 0};
     static int time_delayed_total = 0;
-    if (time_delayed_each[idx] <= knob_->ValueInt("yield_delay_min_each") ||
-        time_delayed_total <= knob_->ValueInt("yield_delay_max_total")) {
+    if (time_delayed_each[idx] <= yield_delay_min_each_knob_.Value() ||
+        time_delayed_total <= yield_delay_max_total_knob_.Value()) {
       if (s->state_ != last_state[idx] || curr_thd_id != last_thd[idx]) {
         DEBUG_FMT_PRINT_SAFE("[T%" PRIx64 "] time delay\n", curr_thd_id);
-        int time_unit = knob_->ValueInt("yield_delay_unit");
+        int time_unit = yield_delay_unit_knob_.Value();
         last_state[idx] = s->state_;
         last_thd[idx] = curr_thd_id;
         time_delayed_each[idx] += time_unit;
@@ -3583,11 +3454,11 @@ bool SchedulerCommon::Idiom2CheckGiveup(int idx) {
                                      INVALID_THD_ID};
     static int time_delayed_each[] = {0, 0, 0, 0};
     static int time_delayed_total = 0;
-    if (time_delayed_each[idx] <= knob_->ValueInt("yield_delay_min_each") ||
-        time_delayed_total <= knob_->ValueInt("yield_delay_max_total")) {
+    if (time_delayed_each[idx] <= yield_delay_min_each_knob_.Value() ||
+        time_delayed_total <= yield_delay_max_total_knob_.Value()) {
       if (s->state_ != last_state[idx] || curr_thd_id != last_thd[idx]) {
         DEBUG_FMT_PRINT_SAFE("[T%" PRIx64 "] time delay\n", curr_thd_id);
-        int time_unit = knob_->ValueInt("yield_delay_unit");
+        int time_unit = yield_delay_unit_knob_.Value();
         last_state[idx] = s->state_;
         last_thd[idx] = curr_thd_id;
         time_delayed_each[idx] += time_unit;
@@ -5094,7 +4965,7 @@ void SchedulerCommon::Idiom3BeforeEvent2(address_t addr, size_t size) {
 
 void SchedulerCommon::Idiom3BeforeEvent3(address_t addr, size_t size) {
   Idiom3SchedStatus *s = idiom3_sched_status_;
-  thread_id_t curr_thd_id = PIN_ThreadUid();
+  thread_id_t curr_thd_id = PIN_ThreadUid();
 
   DEBUG_STAT_INC("event3", 1);
 
@@ -5912,11 +5783,11 @@ bool SchedulerCommon::Idiom3CheckGiveup(int idx) {
                                      INVALID_THD_ID};
     static int time_delayed_each[] = {0, 0, 0, 0, 0};
     static int time_delayed_total = 0;
-    if (time_delayed_each[idx] <= knob_->ValueInt("yield_delay_min_each") ||
-        time_delayed_total <= knob_->ValueInt("yield_delay_max_total")) {
+    if (time_delayed_each[idx] <= yield_delay_min_each_knob_.Value() ||
+        time_delayed_total <= yield_delay_max_total_knob_.Value()) {
       if (s->state_ != last_state[idx] || curr_thd_id != last_thd[idx]) {
         DEBUG_FMT_PRINT_SAFE("[T%" PRIx64 "] time delay\n", curr_thd_id);
-        int time_unit = knob_->ValueInt("yield_delay_unit");
+        int time_unit = yield_delay_unit_knob_.Value();
         last_state[idx] = s->state_;
         last_thd[idx] = curr_thd_id;
         time_delayed_each[idx] += time_unit;
@@ -8443,11 +8314,11 @@ bool SchedulerCommon::Idiom4CheckGiveup(int idx) {
                                      INVALID_THD_ID};
     static int time_delayed_each[] = {0, 0, 0, 0, 0};
     static int time_delayed_total = 0;
-    if (time_delayed_each[idx] <= knob_->ValueInt("yield_delay_min_each") ||
-        time_delayed_total <= knob_->ValueInt("yield_delay_max_total")) {
+    if (time_delayed_each[idx] <= yield_delay_min_each_knob_.Value() ||
+        time_delayed_total <= yield_delay_max_total_knob_.Value()) {
       if (s->state_ != last_state[idx] || curr_thd_id != last_thd[idx]) {
         DEBUG_FMT_PRINT_SAFE("[T%" PRIx64 "] time delay\n", curr_thd_id);
-        int time_unit = knob_->ValueInt("yield_delay_unit");
+        int time_unit = yield_delay_unit_knob_.Value();
         last_state[idx] = s->state_;
         last_thd[idx] = curr_thd_id;
         time_delayed_each[idx] += time_unit;
@@ -13540,11 +13411,11 @@ bool SchedulerCommon::Idiom5CheckGiveup(int idx) {
                                      INVALID_THD_ID};
     static int time_delayed_each[] = {0, 0, 0, 0, 0};
     static int time_delayed_total = 0;
-    if (time_delayed_each[idx] <= knob_->ValueInt("yield_delay_min_each") ||
-        time_delayed_total <= knob_->ValueInt("yield_delay_max_total")) {
+    if (time_delayed_each[idx] <= yield_delay_min_each_knob_.Value() ||
+        time_delayed_total <= yield_delay_max_total_knob_.Value()) {
       if (s->state_ != last_state[idx] || curr_thd_id != last_thd[idx]) {
         DEBUG_FMT_PRINT_SAFE("[T%" PRIx64 "] time delay\n", curr_thd_id);
-        int time_unit = knob_->ValueInt("yield_delay_unit");
+        int time_unit = yield_delay_unit_knob_.Value();
         last_state[idx] = s->state_;
         last_thd[idx] = curr_thd_id;
         time_delayed_each[idx] += time_unit;
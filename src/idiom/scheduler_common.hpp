@@ -32,6 +32,11 @@ namespace idiom {
 
 class SchedulerCommon;
 
+// the trace groups of the traces instrumented in watch states and in
+// other states (see ExecutionControl::AddTraceToGroup)
+#define WATCH_TRACE_GROUP    0
+#define NO_WATCH_TRACE_GROUP 1
+
 // a set of thread that have been delayed
 typedef std::set<thread_id_t> DelaySet;
 
@@ -441,22 +446,14 @@ class SchedulerCommon : public ExecutionControl {
   void CheckiRootAfterMutexUnlock(Inst *inst, address_t addr);
 
   // instrument to watch memeory accesses and maintain inst count
-  void InstrumentWatchMem(TRACE trace);
-  void InstrumentWatchInstCount(TRACE trace);
-  void Idiom1InstrumentWatchMem(TRACE trace);
-  void Idiom1InstrumentWatchInstCount(TRACE trace);
-  void Idiom2InstrumentWatchMem(TRACE trace);
-  void Idiom2InstrumentWatchInstCount(TRACE trace);
-  void Idiom3InstrumentWatchMem(TRACE trace);
-  void Idiom3InstrumentWatchInstCount(TRACE trace);
-  void Idiom4InstrumentWatchMem(TRACE trace);
-  void Idiom4InstrumentWatchInstCount(TRACE trace);
-  void Idiom5InstrumentWatchMem(TRACE trace);
-  void Idiom5InstrumentWatchInstCount(TRACE trace);
+  // (watch tells whether the current state is a watch state)
+  void InstrumentWatchMem(TRACE trace, bool watch);
+  void InstrumentWatchInstCount(TRACE trace, bool watch);
   void __InstrumentWatchInstCount(TRACE trace);
   void __InstrumentWatchMem(TRACE trace, bool cand);
   bool ContainCandidates(TRACE trace);
   bool IsCandidate(TRACE trace, INS ins);
+  bool InWatchState();
   void FlushWatch();
 
   // utility functions
@@ -683,6 +680,14 @@ class SchedulerCommon : public ExecutionControl {
   std::map<thread_id_t, OS_THREAD_ID> thd_id_os_tid_map_;
   bool volatile start_schedule_; // start scheduling when 2 threads are started
   bool volatile test_success_;
+  // cached knobs (read in the analysis routines)
+  BoolKnob strict_knob_;
+  IntKnob target_iroot_knob_;
+  BoolKnob yield_with_delay_knob_;
+  IntKnob yield_delay_unit_knob_;
+  IntKnob yield_delay_min_each_knob_;
+  IntKnob yield_delay_max_total_knob_;
+  BoolKnob ordered_new_thread_prio_knob_;
 
  private:
   DISALLOW_COPY_CONSTRUCTORS(SchedulerCommon);
@@ -31,6 +31,7 @@ namespace pct {
 Scheduler::Scheduler()
     : history_(NULL),
       depth_(1),
+      count_mem_(false),
       change_points_cursor_(0),
       change_priorities_cursor_(0),
       new_thread_priorities_cursor_(0),
@@ -62,8 +63,13 @@ void Scheduler::HandlePreSetup() {
 void Scheduler::HandlePostSetup() {
   ExecutionControl::HandlePostSetup();
 
+  // bind cached knobs
+  strict_knob_.Bind(knob_, "strict");
+  lowest_realtime_priority_knob_.Bind(knob_, "lowest_realtime_priority");
+  count_mem_ = knob_->ValueBool("count_mem");
+
   // set analysis desc
-  if (knob_->ValueBool("strict")) {
+  if (strict_knob_.Value()) {
     desc_.SetHookSyscall();
   }
 
@@ -83,7 +89,7 @@ void Scheduler::HandlePostSetup() {
 void Scheduler::HandlePostInstrumentTrace(TRACE trace) {
   ExecutionControl::HandlePostInstrumentTrace(trace);
 
-  if (knob_->ValueBool("count_mem")) {
+  if (count_mem_) {
     for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
       for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
         if (INS_IsMemoryRead(ins) || INS_IsMemoryWrite(ins)) {
@@ -109,11 +115,11 @@ void Scheduler::HandleSyscallEntry(THREADID tid, CONTEXT *ctxt,
                                    SYSCALL_STANDARD std) {
   ExecutionControl::HandleSyscallEntry(tid, ctxt, std);
 
-  int syscall_num = tls_syscall_num_[tid];
+  int syscall_num = GetThreadContext(tid)->syscall_num;
   switch (syscall_num) {
     case SYS_sched_yield:
-      if (knob_->ValueBool("strict"))
-        SetStrictPriority(knob_->ValueInt("lowest_realtime_priority"));
+      if (strict_knob_.Value())
+        SetStrictPriority(lowest_realtime_priority_knob_.Value());
       break;
     default:
       break;
@@ -188,7 +194,7 @@ int Scheduler::NextChangePriority() {
 void Scheduler::Randomize() {
   srand(unsigned(time(NULL)));
 
-  if (knob_->ValueBool("strict")) {
+  if (strict_knob_.Value()) {
     // fill change priorities
     int low = knob_->ValueInt("lowest_realtime_priority");
     int high = knob_->ValueInt("highest_realtime_priority");
@@ -229,7 +235,7 @@ void Scheduler::Randomize() {
 void Scheduler::SetPriority(int priority) {
   // PIN_THREAD_UID is a UInt64
   DEBUG_FMT_PRINT_SAFE("[T%" PRIx64 "] set priority = %d\n", PIN_ThreadUid(), priority);
-  if (knob_->ValueBool("strict")) {
+  if (strict_knob_.Value()) {
     SetStrictPriority(priority);
   } else {
     SetRelaxPriority(priority);
@@ -69,6 +69,9 @@ class Scheduler : public ExecutionControl {
   int curr_num_threads_;
   volatile bool start_inst_count_; // start counting inst when at least
                                    // 2 threads are started
+  // cached knobs (read in the analysis routines)
+  BoolKnob strict_knob_;
+  IntKnob lowest_realtime_priority_knob_;
 
  private:
   static void __PriorityChange(UINT32 c);
@@ -19,7 +19,13 @@
 
 #include "race/detector.h"
 
+#include "core/atomic.h"
 #include "core/logging.h"
+#include "core/stat.h"
+
+// the meta data of the addresses in the same 64 bytes block are
+// protected by the same stripe.
+#define STRIPE_BLOCK_SHIFT 6
 
 namespace race {
 
@@ -27,32 +33,93 @@ Detector::Detector()
     : internal_lock_(NULL),
       race_db_(NULL),
       unit_size_(4),
-      filter_(NULL) {
+      num_stripes_(0),
+      filter_(NULL),
+      access_cache_(false),
+      sampling_(false),
+      sample_burst_(0),
+      sample_decay_(0),
+      sample_max_period_(0),
+      meta_table_(NULL),
+      stripes_(NULL),
+      thd_ctx_table_(NULL),
+      free_gen_(0) {
   // do nothing
 }
 
 Detector::~Detector() {
   delete internal_lock_;
   delete filter_;
+  delete meta_table_;
+  delete [] stripes_;
+  delete thd_ctx_table_;
 }
 
 void Detector::Register() {
   knob_->RegisterInt("unit_size", "the monitoring granularity in bytes", "4");
+  knob_->RegisterInt("num_stripes", "the number of lock stripes for the meta data", "256");
+  knob_->RegisterBool("access_cache", "whether skip accesses already checked in the current epoch", "1");
+  knob_->RegisterBool("sampling", "whether sample memory accesses adaptively per instruction", "0");
+  knob_->RegisterInt("sample_burst", "the number of consecutive executions sampled in each burst", "10");
+  knob_->RegisterInt("sample_decay", "the factor by which the period between bursts grows", "10");
+  knob_->RegisterInt("sample_max_period", "the maximum period between bursts (in executions)", "10000");
 }
 
 void Detector::Setup(Mutex *lock, RaceDB *race_db) {
   internal_lock_ = lock;
   race_db_ = race_db;
   unit_size_ = knob_->ValueInt("unit_size");
+  // clamp the knob values before they are stored as unsigned
+  int num_stripes = knob_->ValueInt("num_stripes");
+  num_stripes_ = num_stripes < 1 ? 1 : num_stripes;
+  access_cache_ = knob_->ValueBool("access_cache");
+  sampling_ = knob_->ValueBool("sampling");
+  int sample_burst = knob_->ValueInt("sample_burst");
+  int sample_decay = knob_->ValueInt("sample_decay");
+  int sample_max_period = knob_->ValueInt("sample_max_period");
+  sample_burst_ = sample_burst < 1 ? 1 : sample_burst;
+  sample_decay_ = sample_decay < 1 ? 1 : sample_decay;
+  sample_max_period_ = sample_max_period < 1 ? 1 : sample_max_period;
+  if (sample_max_period_ < sample_burst_)
+    sample_max_period_ = sample_burst_;
   filter_ = new RegionFilter(internal_lock_->Clone());
+  meta_table_ = new Meta::Table(unit_size_);
+  stripes_ = new Stripe[num_stripes_];
+  for (size_t i = 0; i < num_stripes_; i++)
+    stripes_[i].lock = internal_lock_->Clone();
+  thd_ctx_table_ = new ThreadIndexTable<ThreadContext *>;
 
   // set analyzer descriptor
   desc_.SetHookBeforeMem();
+  desc_.SetPublishMemRegion();
   desc_.SetHookPthreadFunc();
   desc_.SetHookMallocFunc();
   desc_.SetHookAtomicInst();
 }
 
+void Detector::ProgramExit() {
+  if (!sampling_)
+    return;
+
+  // report the sampling statistics
+  uint64 num_sampled = 0;
+  uint64 num_skipped = 0;
+  uint64 num_insts = 0;
+  for (size_t i = 0; i < ThreadIndex::Size(); i++) {
+    ThreadContext **slot = thd_ctx_table_->Find(i);
+    if (!slot || !*slot)
+      continue;
+    ThreadContext *ctx = *slot;
+    SampleTable *table = ctx->sample_table;
+    num_sampled += table->num_sampled;
+    num_skipped += table->num_skipped;
+    num_insts += table->info_map.size();
+  }
+  STAT_INC_SAFE("race_sampled", num_sampled);
+  STAT_INC_SAFE("race_skipped", num_skipped);
+  STAT_INC_SAFE("race_sample_insts", num_insts);
+}
+
 void Detector::ImageLoad(Image *image, address_t low_addr, address_t high_addr,
                          address_t data_start, size_t data_size,
                          address_t bss_start, size_t bss_size) {
@@ -78,64 +145,113 @@ void Detector::ImageUnload(Image *image,address_t low_addr, address_t high_addr,
 }
 
 void Detector::ThreadStart(thread_id_t curr_thd_id, thread_id_t parent_thd_id) {
-  // create thread local vector clock and lockset
-  VectorClock *curr_vc = new VectorClock;
-
-  ScopedLock locker(internal_lock_);
+  // create thread local context
+  ThreadContext *ctx = new ThreadContext;
+  ctx->vc = new VectorClock;
+  ctx->vc_lock = internal_lock_->Clone();
   // init vector clock
-  curr_vc->Increment(curr_thd_id);
+  ctx->vc->Increment(curr_thd_id);
   if (parent_thd_id != INVALID_THD_ID) {
-    // this is not the main thread
-    VectorClock *parent_vc = curr_vc_map_[parent_thd_id];
-    DEBUG_ASSERT(parent_vc);
-    curr_vc->Join(parent_vc);
-    parent_vc->Increment(parent_thd_id);
+    // this is not the main thread. the parent saved its vector clock
+    // before creating the child (see BeforePthreadCreate), so that we
+    // never touch the vector clock of a running parent thread. the
+    // parent waits in pthread_create until this returns, so the front
+    // of its list is the vector clock saved for this thread.
+    ScopedLock locker(internal_lock_);
+    std::list<VectorClock> &fork_vc_list = fork_vc_map_[parent_thd_id];
+    if (!fork_vc_list.empty()) {
+      ctx->vc->Join(&fork_vc_list.front());
+      fork_vc_list.pop_front();
+    } else {
+      // the thread is not created by pthread_create. the parent may be
+      // running, so update its vector clock under its vc lock.
+      ThreadContext *parent_ctx = GetThreadContext(parent_thd_id);
+      DEBUG_ASSERT(parent_ctx);
+      ScopedLock vc_locker(parent_ctx->vc_lock);
+      ctx->vc->Join(parent_ctx->vc);
+      parent_ctx->vc->Increment(parent_thd_id);
+    }
   }
-  curr_vc_map_[curr_thd_id] = curr_vc;
-  // init atomic map
-  atomic_map_[curr_thd_id] = false;
+  // init sampling states
+  if (sampling_)
+    ctx->sample_table = new SampleTable;
+  // init access cache
+  if (access_cache_)
+    ctx->access_cache = new AccessCache;
+  // publish the context after it is fully initialized
+  MEMORY_BARRIER();
+  *thd_ctx_table_->Get(ThreadIndex::Get(curr_thd_id)) = ctx;
 }
 
 void Detector::BeforeMemRead(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
                              Inst *inst, address_t addr, size_t size) {
-  ScopedLock locker(internal_lock_);
   if (FilterAccess(addr))
     return;
-  if (atomic_map_[curr_thd_id])
+  ThreadContext *ctx = GetThreadContext(curr_thd_id);
+  DEBUG_ASSERT(ctx);
+  if (sampling_ && !SampleAccess(ctx, inst))
+    return;
+  if (ctx->in_atomic)
     return;
+  // the vector clock of a thread is only modified by the thread itself
+  VectorClock *curr_vc = ctx->vc;
+  AccessCache *cache = GetAccessCache(ctx, curr_thd_id);
   // normalize accesses
   address_t start_addr = UNIT_DOWN_ALIGN(addr, unit_size_);
   address_t end_addr = UNIT_UP_ALIGN(addr + size, unit_size_);
   for (address_t iaddr = start_addr; iaddr < end_addr; iaddr += unit_size_) {
+    AccessCache::Entry *entry = NULL;
+    if (cache) {
+      entry = &cache->read_entries[AccessCacheIndex(iaddr)];
+      if (cache->Lookup(entry, iaddr, inst))
+        continue;
+    }
+    ScopedLock locker(GetStripe(iaddr)->lock);
     Meta *meta = GetMeta(iaddr);
     DEBUG_ASSERT(meta);
-    ProcessRead(curr_thd_id, meta, inst);
+    ProcessRead(curr_thd_id, curr_vc, meta, inst);
+    if (cache)
+      cache->Insert(entry, iaddr, inst);
   } // end of for each iaddr
 }
 
 void Detector::BeforeMemWrite(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
                               Inst *inst, address_t addr, size_t size) {
-  ScopedLock locker(internal_lock_);
   if (FilterAccess(addr))
     return;
-  if (atomic_map_[curr_thd_id])
+  ThreadContext *ctx = GetThreadContext(curr_thd_id);
+  DEBUG_ASSERT(ctx);
+  if (sampling_ && !SampleAccess(ctx, inst))
     return;
+  if (ctx->in_atomic)
+    return;
+  // the vector clock of a thread is only modified by the thread itself
+  VectorClock *curr_vc = ctx->vc;
+  AccessCache *cache = GetAccessCache(ctx, curr_thd_id);
   // normalize accesses
   address_t start_addr = UNIT_DOWN_ALIGN(addr, unit_size_);
   address_t end_addr = UNIT_UP_ALIGN(addr + size, unit_size_);
   for (address_t iaddr = start_addr; iaddr < end_addr; iaddr += unit_size_) {
+    AccessCache::Entry *entry = NULL;
+    if (cache) {
+      entry = &cache->write_entries[AccessCacheIndex(iaddr)];
+      if (cache->Lookup(entry, iaddr, inst))
+        continue;
+    }
+    ScopedLock locker(GetStripe(iaddr)->lock);
     Meta *meta = GetMeta(iaddr);
     DEBUG_ASSERT(meta);
-    ProcessWrite(curr_thd_id, meta, inst);
+    ProcessWrite(curr_thd_id, curr_vc, meta, inst);
+    if (cache)
+      cache->Insert(entry, iaddr, inst);
   } // end of for each iaddr
 }
 
 void Detector::BeforeAtomicInst(thread_id_t curr_thd_id,
                                 timestamp_t curr_thd_clk, Inst *inst,
-                                std::string type, address_t addr) {
-  ScopedLock locker(internal_lock_);
-  // set atomic map
-  atomic_map_[curr_thd_id] = true;
+                                opcode_type opcode, address_t addr) {
+  // the flag is only accessed by the thread itself
+  GetThreadContext(curr_thd_id)->in_atomic = true;
   // special care for lock prefix instructions
   //address_t aligned_addr = UNIT_DOWN_ALIGN(addr, unit_size_);
   //MutexMeta *guard_meta = GetMutexMeta(aligned_addr);
@@ -146,26 +262,39 @@ void Detector::BeforeAtomicInst(thread_id_t curr_thd_id,
 
 void Detector::AfterAtomicInst(thread_id_t curr_thd_id,
                                timestamp_t curr_thd_clk, Inst *inst,
-                               std::string type, address_t addr) {
-  ScopedLock locker(internal_lock_);
-  // clear atomic map
-  atomic_map_[curr_thd_id] = false;
+                               opcode_type opcode, address_t addr) {
+  GetThreadContext(curr_thd_id)->in_atomic = false;
+}
+
+void Detector::BeforePthreadCreate(thread_id_t curr_thd_id,
+                                   timestamp_t curr_thd_clk, Inst *inst) {
+  ThreadContext *ctx = GetThreadContext(curr_thd_id);
+  VectorClock *curr_vc = ctx->vc;
+  DEBUG_ASSERT(curr_vc);
+  // save the vector clock for the child thread
+  {
+    ScopedLock locker(internal_lock_);
+    fork_vc_map_[curr_thd_id].push_back(*curr_vc);
+  }
+  ScopedLock vc_locker(ctx->vc_lock);
+  curr_vc->Increment(curr_thd_id);
 }
 
 void Detector::AfterPthreadJoin(thread_id_t curr_thd_id,
                                 timestamp_t curr_thd_clk, Inst *inst,
                                 thread_id_t child_thd_id) {
-  ScopedLock locker(internal_lock_);
-  VectorClock *curr_vc = curr_vc_map_[curr_thd_id];
-  VectorClock *child_vc = curr_vc_map_[child_thd_id];
-  curr_vc->Join(child_vc);
+  // the child thread has exited, so its vector clock is stable
+  ThreadContext *ctx = GetThreadContext(curr_thd_id);
+  VectorClock *child_vc = GetVectorClock(child_thd_id);
+  ScopedLock vc_locker(ctx->vc_lock);
+  ctx->vc->Join(child_vc);
 }
 
 void Detector::AfterPthreadMutexLock(thread_id_t curr_thd_id,
                                      timestamp_t curr_thd_clk, Inst *inst,
                                      address_t addr) {
-  ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(addr, unit_size_) == addr);
+  ScopedLock locker(GetStripe(addr)->lock);
   MutexMeta *meta = GetMutexMeta(addr);
   DEBUG_ASSERT(meta);
   ProcessLock(curr_thd_id, meta);
@@ -174,8 +303,8 @@ void Detector::AfterPthreadMutexLock(thread_id_t curr_thd_id,
 void Detector::BeforePthreadMutexUnlock(thread_id_t curr_thd_id,
                                         timestamp_t curr_thd_clk, Inst *inst,
                                         address_t addr) {
-  ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(addr, unit_size_) == addr);
+  ScopedLock locker(GetStripe(addr)->lock);
   MutexMeta *meta = GetMutexMeta(addr);
   DEBUG_ASSERT(meta);
   ProcessUnlock(curr_thd_id, meta);
@@ -184,8 +313,8 @@ void Detector::BeforePthreadMutexUnlock(thread_id_t curr_thd_id,
 void Detector::BeforePthreadCondSignal(thread_id_t curr_thd_id,
                                        timestamp_t curr_thd_clk, Inst *inst,
                                        address_t addr) {
-  ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(addr, unit_size_) == addr);
+  ScopedLock locker(GetStripe(addr)->lock);
   CondMeta *meta = GetCondMeta(addr);
   DEBUG_ASSERT(meta);
   ProcessNotify(curr_thd_id, meta);
@@ -194,8 +323,8 @@ void Detector::BeforePthreadCondSignal(thread_id_t curr_thd_id,
 void Detector::BeforePthreadCondBroadcast(thread_id_t curr_thd_id,
                                           timestamp_t curr_thd_clk, Inst *inst,
                                           address_t addr) {
-  ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(addr, unit_size_) == addr);
+  ScopedLock locker(GetStripe(addr)->lock);
   CondMeta *meta = GetCondMeta(addr);
   DEBUG_ASSERT(meta);
   ProcessNotify(curr_thd_id, meta);
@@ -205,75 +334,95 @@ void Detector::BeforePthreadCondWait(thread_id_t curr_thd_id,
                                      timestamp_t curr_thd_clk, Inst *inst,
                                      address_t cond_addr,
                                      address_t mutex_addr) {
-  ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(mutex_addr, unit_size_) == mutex_addr);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(cond_addr, unit_size_) == cond_addr);
   // unlock
-  MutexMeta *mutex_meta = GetMutexMeta(mutex_addr);
-  DEBUG_ASSERT(mutex_meta);
-  ProcessUnlock(curr_thd_id, mutex_meta);
+  {
+    ScopedLock locker(GetStripe(mutex_addr)->lock);
+    MutexMeta *mutex_meta = GetMutexMeta(mutex_addr);
+    DEBUG_ASSERT(mutex_meta);
+    ProcessUnlock(curr_thd_id, mutex_meta);
+  }
   // wait
-  CondMeta *cond_meta = GetCondMeta(cond_addr);
-  DEBUG_ASSERT(cond_meta);
-  ProcessPreWait(curr_thd_id, cond_meta);
+  {
+    ScopedLock locker(GetStripe(cond_addr)->lock);
+    CondMeta *cond_meta = GetCondMeta(cond_addr);
+    DEBUG_ASSERT(cond_meta);
+    ProcessPreWait(curr_thd_id, cond_meta);
+  }
 }
 
 void Detector::AfterPthreadCondWait(thread_id_t curr_thd_id,
                                     timestamp_t curr_thd_clk, Inst *inst,
                                     address_t cond_addr,
                                     address_t mutex_addr) {
-  ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(mutex_addr, unit_size_) == mutex_addr);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(cond_addr, unit_size_) == cond_addr);
   // wait
-  CondMeta *cond_meta = GetCondMeta(cond_addr);
-  DEBUG_ASSERT(cond_meta);
-  ProcessPostWait(curr_thd_id, cond_meta);
+  {
+    ScopedLock locker(GetStripe(cond_addr)->lock);
+    CondMeta *cond_meta = GetCondMeta(cond_addr);
+    DEBUG_ASSERT(cond_meta);
+    ProcessPostWait(curr_thd_id, cond_meta);
+  }
   // lock
-  MutexMeta *mutex_meta = GetMutexMeta(mutex_addr);
-  DEBUG_ASSERT(mutex_meta);
-  ProcessLock(curr_thd_id, mutex_meta);
+  {
+    ScopedLock locker(GetStripe(mutex_addr)->lock);
+    MutexMeta *mutex_meta = GetMutexMeta(mutex_addr);
+    DEBUG_ASSERT(mutex_meta);
+    ProcessLock(curr_thd_id, mutex_meta);
+  }
 }
 
 void Detector::BeforePthreadCondTimedwait(thread_id_t curr_thd_id,
                                           timestamp_t curr_thd_clk, Inst *inst,
                                           address_t cond_addr,
                                           address_t mutex_addr) {
-  ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(mutex_addr, unit_size_) == mutex_addr);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(cond_addr, unit_size_) == cond_addr);
   // unlock
-  MutexMeta *mutex_meta = GetMutexMeta(mutex_addr);
-  DEBUG_ASSERT(mutex_meta);
-  ProcessUnlock(curr_thd_id, mutex_meta);
+  {
+    ScopedLock locker(GetStripe(mutex_addr)->lock);
+    MutexMeta *mutex_meta = GetMutexMeta(mutex_addr);
+    DEBUG_ASSERT(mutex_meta);
+    ProcessUnlock(curr_thd_id, mutex_meta);
+  }
   // wait
-  CondMeta *cond_meta = GetCondMeta(cond_addr);
-  DEBUG_ASSERT(cond_meta);
-  ProcessPreWait(curr_thd_id, cond_meta);
+  {
+    ScopedLock locker(GetStripe(cond_addr)->lock);
+    CondMeta *cond_meta = GetCondMeta(cond_addr);
+    DEBUG_ASSERT(cond_meta);
+    ProcessPreWait(curr_thd_id, cond_meta);
+  }
 }
 
 void Detector::AfterPthreadCondTimedwait(thread_id_t curr_thd_id,
                                          timestamp_t curr_thd_clk, Inst *inst,
                                          address_t cond_addr,
                                          address_t mutex_addr) {
-  ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(mutex_addr, unit_size_) == mutex_addr);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(cond_addr, unit_size_) == cond_addr);
   // wait
-  CondMeta *cond_meta = GetCondMeta(cond_addr);
-  DEBUG_ASSERT(cond_meta);
-  ProcessPostWait(curr_thd_id, cond_meta);
+  {
+    ScopedLock locker(GetStripe(cond_addr)->lock);
+    CondMeta *cond_meta = GetCondMeta(cond_addr);
+    DEBUG_ASSERT(cond_meta);
+    ProcessPostWait(curr_thd_id, cond_meta);
+  }
   // lock
-  MutexMeta *mutex_meta = GetMutexMeta(mutex_addr);
-  DEBUG_ASSERT(mutex_meta);
-  ProcessLock(curr_thd_id, mutex_meta);
+  {
+    ScopedLock locker(GetStripe(mutex_addr)->lock);
+    MutexMeta *mutex_meta = GetMutexMeta(mutex_addr);
+    DEBUG_ASSERT(mutex_meta);
+    ProcessLock(curr_thd_id, mutex_meta);
+  }
 }
 
 void Detector::BeforePthreadBarrierWait(thread_id_t curr_thd_id,
                                         timestamp_t curr_thd_clk, Inst *inst,
                                         address_t addr) {
-  ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(addr, unit_size_) == addr);
+  ScopedLock locker(GetStripe(addr)->lock);
   BarrierMeta *meta = GetBarrierMeta(addr);
   DEBUG_ASSERT(meta);
   ProcessPreBarrier(curr_thd_id, meta);
@@ -282,8 +431,8 @@ void Detector::BeforePthreadBarrierWait(thread_id_t curr_thd_id,
 void Detector::AfterPthreadBarrierWait(thread_id_t curr_thd_id,
                                        timestamp_t curr_thd_clk, Inst *inst,
                                        address_t addr) {
-  ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(UNIT_DOWN_ALIGN(addr, unit_size_) == addr);
+  ScopedLock locker(GetStripe(addr)->lock);
   BarrierMeta *meta = GetBarrierMeta(addr);
   DEBUG_ASSERT(meta);
   ProcessPostBarrier(curr_thd_id, meta);
@@ -323,52 +472,135 @@ void Detector::AfterValloc(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
 
 // helper functions
 void Detector::AllocAddrRegion(address_t addr, size_t size) {
-  ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(addr && size);
-  filter_->AddRegion(addr, size, false);
+  filter_->AddRegion(addr, size);
+  if (access_predicate_)
+    access_predicate_->AddRegion(addr, size);
 }
 
 void Detector::FreeAddrRegion(address_t addr) {
-  ScopedLock locker(internal_lock_);
   if (!addr) return;
-  size_t size = filter_->RemoveRegion(addr, false);
+  size_t size = filter_->RemoveRegion(addr);
   address_t start_addr = UNIT_DOWN_ALIGN(addr, unit_size_);
   address_t end_addr = UNIT_UP_ALIGN(addr + size, unit_size_);
-  for (address_t iaddr = start_addr; iaddr < end_addr; iaddr += unit_size_) {
-    Meta::Table::iterator it = meta_table_.find(iaddr);
-    if (it != meta_table_.end()) {
-      ProcessFree(it->second);
-      meta_table_.erase(it);
+  // release the access meta data (only visit the existing ones)
+  bool freed = false;
+  address_t iaddr = start_addr;
+  for (Meta **slot = meta_table_->FindNext(iaddr, end_addr, &iaddr); slot;
+       slot = meta_table_->FindNext(iaddr + unit_size_, end_addr, &iaddr)) {
+    ScopedLock locker(GetStripe(iaddr)->lock);
+    if (*slot) {
+      ProcessFree(*slot);
+      *slot = NULL;
+      freed = true;
     }
   }
-  for (address_t iaddr = start_addr; iaddr < end_addr; iaddr += unit_size_) {
-    MutexMeta::Table::iterator it = mutex_meta_table_.find(iaddr);
-    if (it != mutex_meta_table_.end()) {
-      ProcessFree(it->second);
-      mutex_meta_table_.erase(it);
-    }
+  // invalidate the access caches of all threads
+  if (freed)
+    ATOMIC_ADD_AND_FETCH(&free_gen_, 1);
+  // release the sync meta data
+  std::vector<address_t> sync_addr_vec;
+  {
+    ScopedLock locker(internal_lock_);
+    std::set<address_t>::iterator begin_it =
+        sync_addr_set_.lower_bound(start_addr);
+    std::set<address_t>::iterator end_it =
+        sync_addr_set_.lower_bound(end_addr);
+    sync_addr_vec.assign(begin_it, end_it);
+    sync_addr_set_.erase(begin_it, end_it);
   }
-  for (address_t iaddr = start_addr; iaddr < end_addr; iaddr += unit_size_) {
-    CondMeta::Table::iterator it = cond_meta_table_.find(iaddr);
-    if (it != cond_meta_table_.end()) {
-      ProcessFree(it->second);
-      cond_meta_table_.erase(it);
+  for (std::vector<address_t>::iterator it = sync_addr_vec.begin();
+       it != sync_addr_vec.end(); ++it) {
+    Stripe *stripe = GetStripe(*it);
+    ScopedLock locker(stripe->lock);
+    MutexMeta::Table::iterator mit = stripe->mutex_meta_table.find(*it);
+    if (mit != stripe->mutex_meta_table.end()) {
+      ProcessFree(mit->second);
+      stripe->mutex_meta_table.erase(mit);
+    }
+    CondMeta::Table::iterator cit = stripe->cond_meta_table.find(*it);
+    if (cit != stripe->cond_meta_table.end()) {
+      ProcessFree(cit->second);
+      stripe->cond_meta_table.erase(cit);
+    }
+    BarrierMeta::Table::iterator bit = stripe->barrier_meta_table.find(*it);
+    if (bit != stripe->barrier_meta_table.end()) {
+      ProcessFree(bit->second);
+      stripe->barrier_meta_table.erase(bit);
     }
   }
-  for (address_t iaddr = start_addr; iaddr < end_addr; iaddr += unit_size_) {
-    BarrierMeta::Table::iterator it = barrier_meta_table_.find(iaddr);
-    if (it != barrier_meta_table_.end()) {
-      ProcessFree(it->second);
-      barrier_meta_table_.erase(it);
+  // reclaim the shadow pages covered by the region
+  meta_table_->Release(addr, size);
+}
+
+Detector::Stripe *Detector::GetStripe(address_t iaddr) {
+  return &stripes_[(iaddr >> STRIPE_BLOCK_SHIFT) % num_stripes_];
+}
+
+void Detector::AddSyncAddr(address_t iaddr) {
+  ScopedLock locker(internal_lock_);
+  sync_addr_set_.insert(iaddr);
+}
+
+bool Detector::SampleAccess(ThreadContext *ctx, Inst *inst) {
+  SampleTable *table = ctx->sample_table;
+  DEBUG_ASSERT(table);
+  // the table is only accessed by its own thread
+  SampleInfo &info = table->info_map[inst];
+  if (!info.period) {
+    // first execution, start with a burst
+    info.period = sample_burst_;
+    info.left = sample_burst_;
+  }
+  if (!info.left) {
+    if (info.sampling) {
+      // end of a burst, decay the sampling rate
+      info.period = MIN(info.period * sample_decay_, sample_max_period_);
+      if (info.period > sample_burst_) {
+        info.sampling = false;
+        info.left = info.period - sample_burst_;
+      } else {
+        info.left = sample_burst_;
+      }
+    } else {
+      // end of a gap, start a new burst
+      info.sampling = true;
+      info.left = sample_burst_;
     }
   }
+  info.left--;
+  if (info.sampling)
+    table->num_sampled++;
+  else
+    table->num_skipped++;
+  return info.sampling;
+}
+
+Detector::AccessCache *Detector::GetAccessCache(ThreadContext *ctx,
+                                               thread_id_t thd_id) {
+  AccessCache *cache = ctx->access_cache;
+  if (!cache)
+    return NULL;
+
+  // the cache is only accessed by its own thread. flush it if the
+  // thread has entered a new epoch or some meta data has been freed.
+  timestamp_t clk = ctx->vc->GetClock(thd_id);
+  uint64 free_gen = free_gen_;
+  if (cache->clk != clk || cache->free_gen != free_gen) {
+    cache->Flush();
+    cache->clk = clk;
+    cache->free_gen = free_gen;
+  }
+  return cache;
 }
 
 Detector::MutexMeta *Detector::GetMutexMeta(address_t iaddr) {
-  MutexMeta::Table::iterator it = mutex_meta_table_.find(iaddr);
-  if (it == mutex_meta_table_.end()) {
+  MutexMeta::Table &table = GetStripe(iaddr)->mutex_meta_table;
+  MutexMeta::Table::iterator it = table.find(iaddr);
+  if (it == table.end()) {
     MutexMeta *meta = new MutexMeta;
-    mutex_meta_table_[iaddr] = meta;
+    table[iaddr] = meta;
+    AddSyncAddr(iaddr);
     return meta;
   } else {
     return it->second;
@@ -376,10 +608,12 @@ Detector::MutexMeta *Detector::GetMutexMeta(address_t iaddr) {
 }
 
 Detector::CondMeta *Detector::GetCondMeta(address_t iaddr) {
-  CondMeta::Table::iterator it = cond_meta_table_.find(iaddr);
-  if (it == cond_meta_table_.end()) {
+  CondMeta::Table &table = GetStripe(iaddr)->cond_meta_table;
+  CondMeta::Table::iterator it = table.find(iaddr);
+  if (it == table.end()) {
     CondMeta *meta = new CondMeta;
-    cond_meta_table_[iaddr] = meta;
+    table[iaddr] = meta;
+    AddSyncAddr(iaddr);
     return meta;
   } else {
     return it->second;
@@ -387,10 +621,12 @@ Detector::CondMeta *Detector::GetCondMeta(address_t iaddr) {
 }
 
 Detector::BarrierMeta *Detector::GetBarrierMeta(address_t iaddr) {
-  BarrierMeta::Table::iterator it = barrier_meta_table_.find(iaddr);
-  if (it == barrier_meta_table_.end()) {
+  BarrierMeta::Table &table = GetStripe(iaddr)->barrier_meta_table;
+  BarrierMeta::Table::iterator it = table.find(iaddr);
+  if (it == table.end()) {
     BarrierMeta *meta = new BarrierMeta;
-    barrier_meta_table_[iaddr] = meta;
+    table[iaddr] = meta;
+    AddSyncAddr(iaddr);
     return meta;
   } else {
     return it->second;
@@ -400,27 +636,36 @@ Detector::BarrierMeta *Detector::GetBarrierMeta(address_t iaddr) {
 void Detector::ReportRace(Meta *meta, thread_id_t t0, Inst *i0,
                           RaceEventType p0, thread_id_t t1, Inst *i1,
                           RaceEventType p1) {
-  race_db_->CreateRace(meta->addr, t0, i0, p0, t1, i1, p1, false);
+  // avoid locking the race db for races that are already saturated
+  if (race_db_->KnownRace(i0, p0, i1, p1))
+    return;
+  race_db_->CreateRace(meta->addr, t0, i0, p0, t1, i1, p1, true);
 }
 
 // main processing functions
 void Detector::ProcessLock(thread_id_t curr_thd_id, MutexMeta *meta) {
-  VectorClock *curr_vc = curr_vc_map_[curr_thd_id];
+  ThreadContext *ctx = GetThreadContext(curr_thd_id);
+  VectorClock *curr_vc = ctx->vc;
   DEBUG_ASSERT(curr_vc);
   // join the vector clock
+  ScopedLock vc_locker(ctx->vc_lock);
   curr_vc->Join(&meta->vc);
 }
 
 void Detector::ProcessUnlock(thread_id_t curr_thd_id, MutexMeta *meta) {
-  VectorClock *curr_vc = curr_vc_map_[curr_thd_id];
+  ThreadContext *ctx = GetThreadContext(curr_thd_id);
+  VectorClock *curr_vc = ctx->vc;
   meta->vc = *curr_vc;
   // increment the vector clock
+  ScopedLock vc_locker(ctx->vc_lock);
   curr_vc->Increment(curr_thd_id);
 }
 
 void Detector::ProcessNotify(thread_id_t curr_thd_id, CondMeta *meta) {
-  VectorClock *curr_vc = curr_vc_map_[curr_thd_id];
+  ThreadContext *ctx = GetThreadContext(curr_thd_id);
+  VectorClock *curr_vc = ctx->vc;
   DEBUG_ASSERT(curr_vc);
+  ScopedLock vc_locker(ctx->vc_lock);
   // iterate the wait table, join vector clock
   for (CondMeta::VectorClockMap::iterator it = meta->wait_table.begin();
        it != meta->wait_table.end(); ++it) {
@@ -435,14 +680,17 @@ void Detector::ProcessNotify(thread_id_t curr_thd_id, CondMeta *meta) {
 }
 
 void Detector::ProcessPreWait(thread_id_t curr_thd_id, CondMeta *meta) {
-  VectorClock *curr_vc = curr_vc_map_[curr_thd_id];
+  ThreadContext *ctx = GetThreadContext(curr_thd_id);
+  VectorClock *curr_vc = ctx->vc;
   DEBUG_ASSERT(curr_vc);
   meta->wait_table[curr_thd_id] = *curr_vc;
+  ScopedLock vc_locker(ctx->vc_lock);
   curr_vc->Increment(curr_thd_id);
 }
 
 void Detector::ProcessPostWait(thread_id_t curr_thd_id, CondMeta *meta) {
-  VectorClock *curr_vc = curr_vc_map_[curr_thd_id];
+  ThreadContext *ctx = GetThreadContext(curr_thd_id);
+  VectorClock *curr_vc = ctx->vc;
   // it is possible that wait_post does not depend on a signal
   // or broadcast. this is because there exist wait_timeout
   // sync functions
@@ -452,13 +700,16 @@ void Detector::ProcessPostWait(thread_id_t curr_thd_id, CondMeta *meta) {
   CondMeta::VectorClockMap::iterator sit = meta->signal_table.find(curr_thd_id);
   if (sit != meta->signal_table.end()) {
     // join vector clock
-    curr_vc->Join(&sit->second);
+    {
+      ScopedLock vc_locker(ctx->vc_lock);
+      curr_vc->Join(&sit->second);
+    }
     meta->signal_table.erase(sit);
   }
 }
 
 void Detector::ProcessPreBarrier(thread_id_t curr_thd_id, BarrierMeta *meta) {
-  VectorClock *curr_vc = curr_vc_map_[curr_thd_id];
+  VectorClock *curr_vc = GetVectorClock(curr_thd_id);
   DEBUG_ASSERT(curr_vc);
   // choose which table to use
   BarrierMeta::VectorClockMap *wait_table = NULL;
@@ -470,8 +721,10 @@ void Detector::ProcessPreBarrier(thread_id_t curr_thd_id, BarrierMeta *meta) {
 }
 
 void Detector::ProcessPostBarrier(thread_id_t curr_thd_id, BarrierMeta *meta) {
-  VectorClock *curr_vc = curr_vc_map_[curr_thd_id];
+  ThreadContext *ctx = GetThreadContext(curr_thd_id);
+  VectorClock *curr_vc = ctx->vc;
   DEBUG_ASSERT(curr_vc);
+  ScopedLock vc_locker(ctx->vc_lock);
   // choose which table to use
   BarrierMeta::VectorClockMap *wait_table = NULL;
   if (meta->post_using_table1)
@@ -19,14 +19,23 @@
 #ifndef RACE_DETECTOR_H_
 #define RACE_DETECTOR_H_
 
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
 #include <tr1/unordered_map>
 
 #include "core/basictypes.h"
 #include "core/analyzer.h"
 #include "core/vector_clock.h"
 #include "core/filter.h"
+#include "core/shadow_memory.h"
+#include "core/thread_index.h"
 #include "race/race.h"
 
+// the number of entries in the per thread access cache
+#define ACCESS_CACHE_SIZE 256
+
 namespace race {
 
 class Detector : public Analyzer {
@@ -37,6 +46,7 @@ class Detector : public Analyzer {
   virtual void Register();
   virtual bool Enabled() = 0;
   virtual void Setup(Mutex *lock, RaceDB *race_db);
+  virtual void ProgramExit();
   virtual void ImageLoad(Image *image,
                          address_t low_addr, address_t high_addr,
                          address_t data_start, size_t data_size,
@@ -52,10 +62,12 @@ class Detector : public Analyzer {
                               Inst *inst, address_t addr, size_t size);
   virtual void BeforeAtomicInst(thread_id_t curr_thd_id,
                                 timestamp_t curr_thd_clk, Inst *inst,
-                                std::string type, address_t addr);
+                                opcode_type opcode, address_t addr);
   virtual void AfterAtomicInst(thread_id_t curr_thd_id,
                                timestamp_t curr_thd_clk, Inst *inst,
-                               std::string type, address_t addr);
+                               opcode_type opcode, address_t addr);
+  virtual void BeforePthreadCreate(thread_id_t curr_thd_id,
+                                   timestamp_t curr_thd_clk, Inst *inst);
   virtual void AfterPthreadJoin(thread_id_t curr_thd_id,
                                 timestamp_t curr_thd_clk, Inst *inst,
                                 thread_id_t child_thd_id);
@@ -110,7 +122,7 @@ class Detector : public Analyzer {
   // the abstract meta data for the memory access
   class Meta {
    public:
-    typedef std::tr1::unordered_map<address_t, Meta *> Table;
+    typedef ShadowMemory<Meta *> Table;
 
     explicit Meta(address_t a) : addr(a) {}
     virtual ~Meta() {}
@@ -160,17 +172,131 @@ class Detector : public Analyzer {
     VectorClockMap barrier_wait_table2;
   };
 
+  // a partition of the meta data. the meta data for an address is
+  // always stored in the same stripe, and is only accessed while
+  // holding the lock of that stripe.
+  class Stripe {
+   public:
+    Stripe() : lock(NULL) {}
+    ~Stripe() { delete lock; }
+
+    Mutex *lock;
+    MutexMeta::Table mutex_meta_table;
+    CondMeta::Table cond_meta_table;
+    BarrierMeta::Table barrier_meta_table;
+  };
+
+  // the sampling state of a static instruction in a thread. the
+  // instruction is sampled in bursts. after each burst, the period
+  // between two bursts grows, so that hot instructions are sampled
+  // less often (LiteRace style adaptive sampling).
+  class SampleInfo {
+   public:
+    SampleInfo() : sampling(true), left(0), period(0) {}
+    ~SampleInfo() {}
+
+    bool sampling; // whether in a burst
+    size_t left; // the number of executions left in the burst or gap
+    size_t period; // the number of executions between two bursts
+  };
+
+  // the sampling states of a thread
+  class SampleTable {
+   public:
+    typedef std::tr1::unordered_map<Inst *, SampleInfo> InfoMap;
+
+    SampleTable() : num_sampled(0), num_skipped(0) {}
+    ~SampleTable() {}
+
+    InfoMap info_map;
+    uint64 num_sampled;
+    uint64 num_skipped;
+  };
+
+  // a per thread direct-mapped cache of the accesses that have been
+  // checked in the current epoch of the thread (i.e. since the last
+  // time the thread incremented its own clock). checking such an
+  // access again would not change the meta data.
+  class AccessCache {
+   public:
+    class Entry {
+     public:
+      Entry() : addr(0), inst(NULL), tag(0) {}
+      ~Entry() {}
+
+      address_t addr;
+      Inst *inst;
+      uint64 tag;
+    };
+
+    AccessCache() : tag(1), clk(0), free_gen(0) {}
+    ~AccessCache() {}
+
+    bool Lookup(Entry *entry, address_t iaddr, Inst *inst) {
+      return entry->tag == tag && entry->addr == iaddr && entry->inst == inst;
+    }
+    void Insert(Entry *entry, address_t iaddr, Inst *inst) {
+      entry->addr = iaddr;
+      entry->inst = inst;
+      entry->tag = tag;
+    }
+    void Flush() { tag++; }
+
+    Entry read_entries[ACCESS_CACHE_SIZE];
+    Entry write_entries[ACCESS_CACHE_SIZE];
+    uint64 tag; // entries with a different tag are invalid
+    timestamp_t clk; // the clock of the thread the entries belong to
+    uint64 free_gen; // the free generation the entries belong to
+  };
+
+  // the per thread analysis state. it is created when the thread
+  // starts, and is only modified by the thread itself afterwards.
+  class ThreadContext {
+   public:
+    ThreadContext()
+        : vc(NULL),
+          vc_lock(NULL),
+          in_atomic(false),
+          sample_table(NULL),
+          access_cache(NULL) {}
+
+    ~ThreadContext() {}
+
+    VectorClock *vc;
+    // the thread updates vc while holding vc_lock, so that the other
+    // threads can read vc under vc_lock. the thread itself reads vc
+    // without locking.
+    Mutex *vc_lock;
+    bool in_atomic; // whether executing atomic inst.
+    SampleTable *sample_table; // NULL if sampling is disabled
+    AccessCache *access_cache; // NULL if the access cache is disabled
+  };
+
   // helper functions
   void AllocAddrRegion(address_t addr, size_t size);
   void FreeAddrRegion(address_t addr);
-  bool FilterAccess(address_t addr) { return filter_->Filter(addr, false); }
+  bool FilterAccess(address_t addr) { return filter_->Filter(addr); }
+  Stripe *GetStripe(address_t iaddr);
+  ThreadContext *GetThreadContext(thread_id_t thd_id) {
+    return *thd_ctx_table_->Get(ThreadIndex::Get(thd_id));
+  }
+  VectorClock *GetVectorClock(thread_id_t thd_id) {
+    return GetThreadContext(thd_id)->vc;
+  }
+  bool SampleAccess(ThreadContext *ctx, Inst *inst);
+  AccessCache *GetAccessCache(ThreadContext *ctx, thread_id_t thd_id);
+  size_t AccessCacheIndex(address_t iaddr) {
+    return (iaddr / unit_size_) % ACCESS_CACHE_SIZE;
+  }
+  void AddSyncAddr(address_t iaddr);
   MutexMeta *GetMutexMeta(address_t iaddr);
   CondMeta *GetCondMeta(address_t iaddr);
   BarrierMeta *GetBarrierMeta(address_t iaddr);
   void ReportRace(Meta *meta, thread_id_t t0, Inst *i0, RaceEventType p0,
                   thread_id_t t1, Inst *i1, RaceEventType p1);
 
-  // main processing functions
+  // main processing functions (the caller should hold the lock of
+  // the stripe that the meta belongs to)
   void ProcessLock(thread_id_t curr_thd_id, MutexMeta *meta);
   void ProcessUnlock(thread_id_t curr_thd_id, MutexMeta *meta);
   void ProcessNotify(thread_id_t curr_thd_id, CondMeta *meta);
@@ -184,27 +310,37 @@ class Detector : public Analyzer {
 
   // virtual functions to override
   virtual Meta *GetMeta(address_t iaddr) = 0;
-  virtual void ProcessRead(thread_id_t curr_thd_id, Meta *meta, Inst *inst) = 0;
-  virtual void ProcessWrite(thread_id_t curr_thd_id, Meta *meta, Inst *inst)= 0;
+  virtual void ProcessRead(thread_id_t curr_thd_id, VectorClock *curr_vc,
+                           Meta *meta, Inst *inst) = 0;
+  virtual void ProcessWrite(thread_id_t curr_thd_id, VectorClock *curr_vc,
+                            Meta *meta, Inst *inst) = 0;
   virtual void ProcessFree(Meta *meta) = 0;
 
   // common databases
-  Mutex *internal_lock_;
+  Mutex *internal_lock_; // protects the global analysis state
   RaceDB *race_db_;
 
   // settings and flasg
   address_t unit_size_;
+  size_t num_stripes_;
   RegionFilter *filter_;
+  bool access_cache_;
+  bool sampling_;
+  size_t sample_burst_;
+  size_t sample_decay_;
+  size_t sample_max_period_;
 
   // meta data
-  MutexMeta::Table mutex_meta_table_;
-  CondMeta::Table cond_meta_table_;
-  BarrierMeta::Table barrier_meta_table_;
-  Meta::Table meta_table_;
+  Meta::Table *meta_table_; // the shadow memory of the access meta data
+  Stripe *stripes_;
+
+  // per thread analysis state (indexed by the compact thread index)
+  ThreadIndexTable<ThreadContext *> *thd_ctx_table_;
 
   // global analysis state
-  std::map<thread_id_t, VectorClock *> curr_vc_map_;
-  std::map<thread_id_t, bool> atomic_map_; // whether executing atomic inst.
+  std::map<thread_id_t, std::list<VectorClock> > fork_vc_map_;
+  std::set<address_t> sync_addr_set_; // addresses with sync meta data
+  volatile uint64 free_gen_; // incremented when meta data is freed
 
  private:
   DISALLOW_COPY_CONSTRUCTORS(Detector);
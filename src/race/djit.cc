@@ -53,22 +53,17 @@ void Djit::Setup(Mutex *lock, RaceDB *race_db) {
 }
 
 Djit::Meta *Djit::GetMeta(address_t iaddr) {
-  Meta::Table::iterator it = meta_table_.find(iaddr);
-  if (it == meta_table_.end()) {
-    Meta *meta = new DjitMeta(iaddr);
-    meta_table_[iaddr] = meta;
-    return meta;
-  } else {
-    return it->second;
-  }
+  Meta **slot = meta_table_->Get(iaddr);
+  if (!*slot)
+    *slot = new DjitMeta(iaddr);
+  return *slot;
 }
 
-void Djit::ProcessRead(thread_id_t curr_thd_id, Meta *meta, Inst *inst) {
+void Djit::ProcessRead(thread_id_t curr_thd_id, VectorClock *curr_vc,
+                       Meta *meta, Inst *inst) {
   // cast the meta
   DjitMeta *djit_meta = dynamic_cast<DjitMeta *>(meta);
   DEBUG_ASSERT(djit_meta);
-  // get the current vector clock
-  VectorClock *curr_vc = curr_vc_map_[curr_thd_id];
   // check writers
   VectorClock &writer_vc = djit_meta->writer_vc;
   if (!writer_vc.HappensBefore(curr_vc)) {
@@ -102,12 +97,11 @@ void Djit::ProcessRead(thread_id_t curr_thd_id, Meta *meta, Inst *inst) {
   }
 }
 
-void Djit::ProcessWrite(thread_id_t curr_thd_id, Meta *meta, Inst *inst) {
+void Djit::ProcessWrite(thread_id_t curr_thd_id, VectorClock *curr_vc,
+                        Meta *meta, Inst *inst) {
   // cast the meta
   DjitMeta *djit_meta = dynamic_cast<DjitMeta *>(meta);
   DEBUG_ASSERT(djit_meta);
-  // get the current vector clock
-  VectorClock *curr_vc = curr_vc_map_[curr_thd_id];
   VectorClock &writer_vc = djit_meta->writer_vc;
   VectorClock &reader_vc = djit_meta->reader_vc;
   // check writers
@@ -59,8 +59,10 @@ class Djit : public Detector {
 
   // overrided virtual functions
   Meta *GetMeta(address_t iaddr);
-  void ProcessRead(thread_id_t curr_thd_id, Meta *meta, Inst *inst);
-  void ProcessWrite(thread_id_t curr_thd_id, Meta *meta, Inst *inst);
+  void ProcessRead(thread_id_t curr_thd_id, VectorClock *curr_vc, Meta *meta,
+                   Inst *inst);
+  void ProcessWrite(thread_id_t curr_thd_id, VectorClock *curr_vc, Meta *meta,
+                    Inst *inst);
   void ProcessFree(Meta *meta);
 
   // settings and flasg
@@ -17,3 +17,214 @@
 // File: race/fasttrack.cc - Implementation of the data race detector
 // using the FastTrack algorithm.
 
+#include "race/fasttrack.h"
+
+#include "core/logging.h"
+
+// Used to properly print on 32 and 64 bit systems 
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+namespace race {
+
+FastTrack::FastTrack() : track_racy_inst_(false) {
+  // do nothing
+}
+
+FastTrack::~FastTrack() {
+  // empty
+}
+
+void FastTrack::Register() {
+  Detector::Register();
+
+  knob_->RegisterBool("enable_fasttrack", "whether enable the fasttrack data race detector", "0");
+  knob_->RegisterBool("track_racy_inst", "whether track potential racy instructions", "0");
+}
+
+bool FastTrack::Enabled() {
+  return knob_->ValueBool("enable_fasttrack");
+}
+
+void FastTrack::Setup(Mutex *lock, RaceDB *race_db) {
+  Detector::Setup(lock, race_db);
+
+  track_racy_inst_ = knob_->ValueBool("track_racy_inst");
+}
+
+FastTrack::Meta *FastTrack::GetMeta(address_t iaddr) {
+  Meta **slot = meta_table_->Get(iaddr);
+  if (!*slot)
+    *slot = new FastTrackMeta(iaddr);
+  return *slot;
+}
+
+void FastTrack::ProcessRead(thread_id_t curr_thd_id, VectorClock *curr_vc,
+                            Meta *meta, Inst *inst) {
+  // cast the meta
+  FastTrackMeta *ft_meta = dynamic_cast<FastTrackMeta *>(meta);
+  DEBUG_ASSERT(ft_meta);
+  timestamp_t curr_clk = curr_vc->GetClock(curr_thd_id);
+  // update race inst set if needed
+  if (track_racy_inst_) {
+    ft_meta->race_inst_set.insert(inst);
+  }
+  // same epoch, no need to check again
+  if (!ft_meta->shared) {
+    if (ft_meta->reader_thd_id == curr_thd_id &&
+        ft_meta->reader_clk == curr_clk) {
+      ft_meta->reader_inst = inst;
+      return;
+    }
+  } else {
+    if (ft_meta->reader_vc.GetClock(curr_thd_id) == curr_clk) {
+      ft_meta->reader_inst_table[curr_thd_id] = inst;
+      return;
+    }
+  }
+  // check writer
+  if (!EpochHappensBefore(ft_meta->writer_thd_id, ft_meta->writer_clk,
+                          curr_vc)) {
+    // thread_id_t is of type uint64. PRIx64 should print this out correctly
+    // on 64 and 32 bit systems
+    DEBUG_FMT_PRINT_SAFE("RAW race detcted [T%" PRIx64 "]\n", curr_thd_id);
+    DEBUG_FMT_PRINT_SAFE("  addr = 0x%lx\n", ft_meta->addr);
+    DEBUG_FMT_PRINT_SAFE("  inst = [%s]\n", inst->ToString().c_str());
+    // mark the meta as racy
+    ft_meta->racy = true;
+    // RAW race detected, report it
+    ReportRace(ft_meta, ft_meta->writer_thd_id, ft_meta->writer_inst,
+               RACE_EVENT_WRITE, curr_thd_id, inst, RACE_EVENT_READ);
+  }
+  // update meta data
+  if (!ft_meta->shared) {
+    if (EpochHappensBefore(ft_meta->reader_thd_id, ft_meta->reader_clk,
+                           curr_vc)) {
+      // exclusive read, keep using the epoch
+      ft_meta->reader_thd_id = curr_thd_id;
+      ft_meta->reader_clk = curr_clk;
+      ft_meta->reader_inst = inst;
+    } else {
+      // concurrent reads, inflate to a vector clock
+      ft_meta->reader_vc.SetClock(ft_meta->reader_thd_id,
+                                  ft_meta->reader_clk);
+      ft_meta->reader_inst_table[ft_meta->reader_thd_id] =
+          ft_meta->reader_inst;
+      ft_meta->reader_vc.SetClock(curr_thd_id, curr_clk);
+      ft_meta->reader_inst_table[curr_thd_id] = inst;
+      ft_meta->reader_thd_id = INVALID_THD_ID;
+      ft_meta->reader_clk = 0;
+      ft_meta->reader_inst = NULL;
+      ft_meta->shared = true;
+    }
+  } else {
+    ft_meta->reader_vc.SetClock(curr_thd_id, curr_clk);
+    ft_meta->reader_inst_table[curr_thd_id] = inst;
+  }
+}
+
+void FastTrack::ProcessWrite(thread_id_t curr_thd_id, VectorClock *curr_vc,
+                             Meta *meta, Inst *inst) {
+  // cast the meta
+  FastTrackMeta *ft_meta = dynamic_cast<FastTrackMeta *>(meta);
+  DEBUG_ASSERT(ft_meta);
+  timestamp_t curr_clk = curr_vc->GetClock(curr_thd_id);
+  // update race inst set if needed
+  if (track_racy_inst_) {
+    ft_meta->race_inst_set.insert(inst);
+  }
+  // same epoch, no need to check again
+  if (ft_meta->writer_thd_id == curr_thd_id &&
+      ft_meta->writer_clk == curr_clk) {
+    ft_meta->writer_inst = inst;
+    return;
+  }
+  // check writer
+  if (!EpochHappensBefore(ft_meta->writer_thd_id, ft_meta->writer_clk,
+                          curr_vc)) {
+    DEBUG_FMT_PRINT_SAFE("WAW race detcted [T%" PRIx64 "]\n", curr_thd_id);
+    DEBUG_FMT_PRINT_SAFE("  addr = 0x%lx\n", ft_meta->addr);
+    DEBUG_FMT_PRINT_SAFE("  inst = [%s]\n", inst->ToString().c_str());
+    // mark the meta as racy
+    ft_meta->racy = true;
+    // WAW race detected, report it
+    ReportRace(ft_meta, ft_meta->writer_thd_id, ft_meta->writer_inst,
+               RACE_EVENT_WRITE, curr_thd_id, inst, RACE_EVENT_WRITE);
+  }
+  // check readers
+  if (!ft_meta->shared) {
+    if (!EpochHappensBefore(ft_meta->reader_thd_id, ft_meta->reader_clk,
+                            curr_vc)) {
+      DEBUG_FMT_PRINT_SAFE("WAR race detcted [T%" PRIx64 "]\n", curr_thd_id);
+      DEBUG_FMT_PRINT_SAFE("  addr = 0x%lx\n", ft_meta->addr);
+      DEBUG_FMT_PRINT_SAFE("  inst = [%s]\n", inst->ToString().c_str());
+      // mark the meta as racy
+      ft_meta->racy = true;
+      // WAR race detected, report it
+      ReportRace(ft_meta, ft_meta->reader_thd_id, ft_meta->reader_inst,
+                 RACE_EVENT_READ, curr_thd_id, inst, RACE_EVENT_WRITE);
+    }
+  } else {
+    VectorClock &reader_vc = ft_meta->reader_vc;
+    if (!reader_vc.HappensBefore(curr_vc)) {
+      DEBUG_FMT_PRINT_SAFE("WAR race detcted [T%" PRIx64 "]\n", curr_thd_id);
+      DEBUG_FMT_PRINT_SAFE("  addr = 0x%lx\n", ft_meta->addr);
+      DEBUG_FMT_PRINT_SAFE("  inst = [%s]\n", inst->ToString().c_str());
+      // mark the meta as racy
+      ft_meta->racy = true;
+      // WAR race detected, report them
+      for (reader_vc.IterBegin(); !reader_vc.IterEnd(); reader_vc.IterNext()) {
+        thread_id_t thd_id = reader_vc.IterCurrThd();
+        timestamp_t clk = reader_vc.IterCurrClk();
+        if (curr_thd_id != thd_id && clk > curr_vc->GetClock(thd_id)) {
+          DEBUG_ASSERT(ft_meta->reader_inst_table.find(thd_id) !=
+                       ft_meta->reader_inst_table.end());
+          Inst *reader_inst = ft_meta->reader_inst_table[thd_id];
+          // report the race
+          ReportRace(ft_meta, thd_id, reader_inst, RACE_EVENT_READ,
+                     curr_thd_id, inst, RACE_EVENT_WRITE);
+        }
+      }
+    }
+    // all the reads are checked against this write, so future accesses
+    // only need to be checked against this write
+    ClearReaders(ft_meta);
+  }
+  // update meta data
+  ft_meta->writer_thd_id = curr_thd_id;
+  ft_meta->writer_clk = curr_clk;
+  ft_meta->writer_inst = inst;
+}
+
+void FastTrack::ProcessFree(Meta *meta) {
+  // cast the meta
+  FastTrackMeta *ft_meta = dynamic_cast<FastTrackMeta *>(meta);
+  DEBUG_ASSERT(ft_meta);
+  // update racy inst set if needed
+  if (track_racy_inst_ && ft_meta->racy) {
+    for (FastTrackMeta::InstSet::iterator it = ft_meta->race_inst_set.begin();
+         it != ft_meta->race_inst_set.end(); ++it) {
+      race_db_->SetRacyInst(*it, true);
+    }
+  }
+  delete ft_meta;
+}
+
+bool FastTrack::EpochHappensBefore(thread_id_t thd_id, timestamp_t clk,
+                                   VectorClock *vc) {
+  // an invalid epoch represents no access at all
+  if (thd_id == INVALID_THD_ID)
+    return true;
+  return clk <= vc->GetClock(thd_id);
+}
+
+void FastTrack::ClearReaders(FastTrackMeta *meta) {
+  meta->shared = false;
+  meta->reader_thd_id = INVALID_THD_ID;
+  meta->reader_clk = 0;
+  meta->reader_inst = NULL;
+  meta->reader_vc = VectorClock();
+  meta->reader_inst_table.clear();
+}
+
+} // namespace race
@@ -20,4 +20,81 @@
 #ifndef RACE_FASTTRACK_H_
 #define RACE_FASTTRACK_H_
 
+#include <tr1/unordered_map>
+
+#include "core/basictypes.h"
+#include "core/vector_clock.h"
+#include "core/filter.h"
+#include "race/detector.h"
+#include "race/race.h"
+
+namespace race {
+
+class FastTrack : public Detector {
+ public:
+  FastTrack();
+  ~FastTrack();
+
+  void Register();
+  bool Enabled();
+  void Setup(Mutex *lock, RaceDB *race_db);
+
+ protected:
+  // the meta data for the memory access. the last write is always
+  // represented by an epoch (thread id and clock). the reads are
+  // represented by an epoch as long as they are totally ordered, and
+  // are inflated to a vector clock only when concurrent reads exist.
+  class FastTrackMeta : public Meta {
+   public:
+    typedef std::map<thread_id_t, Inst *> InstMap;
+    typedef std::set<Inst *> InstSet;
+
+    explicit FastTrackMeta(address_t a)
+        : Meta(a),
+          racy(false),
+          shared(false),
+          writer_thd_id(INVALID_THD_ID),
+          writer_clk(0),
+          writer_inst(NULL),
+          reader_thd_id(INVALID_THD_ID),
+          reader_clk(0),
+          reader_inst(NULL) {}
+
+    ~FastTrackMeta() {}
+
+    bool racy; // whether this meta is involved in any race
+    bool shared; // whether the reads are tracked using reader_vc
+    thread_id_t writer_thd_id;
+    timestamp_t writer_clk;
+    Inst *writer_inst;
+    thread_id_t reader_thd_id;
+    timestamp_t reader_clk;
+    Inst *reader_inst;
+    VectorClock reader_vc;
+    InstMap reader_inst_table;
+    InstSet race_inst_set;
+  };
+
+  // overrided virtual functions
+  Meta *GetMeta(address_t iaddr);
+  void ProcessRead(thread_id_t curr_thd_id, VectorClock *curr_vc, Meta *meta,
+                   Inst *inst);
+  void ProcessWrite(thread_id_t curr_thd_id, VectorClock *curr_vc, Meta *meta,
+                    Inst *inst);
+  void ProcessFree(Meta *meta);
+
+  // helper functions
+  bool EpochHappensBefore(thread_id_t thd_id, timestamp_t clk,
+                          VectorClock *vc);
+  void ClearReaders(FastTrackMeta *meta);
+
+  // settings and flasg
+  bool track_racy_inst_;
+
+ private:
+  DISALLOW_COPY_CONSTRUCTORS(FastTrack);
+};
+
+} // namespace race
+
 #endif
@@ -26,6 +26,8 @@ race_profiler_objs := \
   race/profiler_main.o \
   race/race.o \
   race/race.pb.o \
+  sinst/sinst.o \
+  sinst/sinst.pb.o \
   $(core_objs)
 
 race_pct_profiler_objs := \
@@ -36,6 +38,8 @@ race_pct_profiler_objs := \
   race/pct_profiler_main.o \
   race/race.o \
   race/race.pb.o \
+  sinst/sinst.o \
+  sinst/sinst.pb.o \
   $(pct_objs) \
   $(core_objs)
 
@@ -27,27 +27,35 @@ void PctProfiler::HandlePreSetup() {
   knob_->RegisterBool("ignore_lib", "whether ignore accesses from common libraries", "0");
   knob_->RegisterStr("race_in", "the input race database path", "race.db");
   knob_->RegisterStr("race_out", "the output race database path", "race.db");
+  knob_->RegisterInt("max_races", "the maximum number of dynamic races recorded for each static race in an execution (0 means no limit)", "0");
 
   djit_analyzer_ = new Djit;
   djit_analyzer_->Register();
+  fasttrack_analyzer_ = new FastTrack;
+  fasttrack_analyzer_->Register();
 }
 
 void PctProfiler::HandlePostSetup() {
   pct::Scheduler::HandlePostSetup();
 
   // load race db
-  race_db_ = new RaceDB(CreateMutex());
+  race_db_ = new RaceDB(CreateRWMutex());
   race_db_->Load(knob_->ValueStr("race_in"), sinfo_);
+  race_db_->set_max_races(knob_->ValueInt("max_races"));
+
+  // make sure that we use one data race detector
+  if (djit_analyzer_->Enabled() && fasttrack_analyzer_->Enabled())
+    Abort("please choose only one data race detector\n");
 
   // add data race detector
   if (djit_analyzer_->Enabled()) {
     djit_analyzer_->Setup(CreateMutex(), race_db_);
     AddAnalyzer(djit_analyzer_);
   }
-
-  // make sure that we use one data race detector
-  if (!djit_analyzer_)
-    Abort("please choose a data race detector\n");
+  if (fasttrack_analyzer_->Enabled()) {
+    fasttrack_analyzer_->Setup(CreateMutex(), race_db_);
+    AddAnalyzer(fasttrack_analyzer_);
+  }
 }
 
 bool PctProfiler::HandleIgnoreMemAccess(IMG img) {
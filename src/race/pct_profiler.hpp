@@ -23,16 +23,25 @@
 #include "core/basictypes.h"
 #include "pct/scheduler.hpp"
 #include "race/race.h"
+#include "sinst/sinst.h"
 #include "race/djit.h"
+#include "race/fasttrack.h"
 
 namespace race {
 
 class PctProfiler : public pct::Scheduler {
  public:
-  PctProfiler() : race_db_(NULL), djit_analyzer_(NULL) {}
+  PctProfiler()
+      : race_db_(NULL),
+        djit_analyzer_(NULL),
+        fasttrack_analyzer_(NULL) {}
+
   ~PctProfiler() {}
 
  protected:
+  InstSharingDB *CreateInstSharingDB() {
+    return new sinst::SharedInstDB(CreateMutex());
+  }
   void HandlePreSetup();
   void HandlePostSetup();
   bool HandleIgnoreMemAccess(IMG img);
@@ -40,6 +49,7 @@ class PctProfiler : public pct::Scheduler {
 
   RaceDB *race_db_;
   Djit *djit_analyzer_;
+  FastTrack *fasttrack_analyzer_;
 
  private:
   DISALLOW_COPY_CONSTRUCTORS(PctProfiler);
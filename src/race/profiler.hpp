@@ -22,16 +22,25 @@
 #include "core/basictypes.h"
 #include "core/execution_control.hpp"
 #include "race/race.h"
+#include "sinst/sinst.h"
 #include "race/djit.h"
+#include "race/fasttrack.h"
 
 namespace race {
 
 class Profiler : public ExecutionControl {
  public:
-  Profiler() : race_db_(NULL), djit_analyzer_(NULL) {}
+  Profiler()
+      : race_db_(NULL),
+        djit_analyzer_(NULL),
+        fasttrack_analyzer_(NULL) {}
+
   ~Profiler() {}
 
  protected:
+  InstSharingDB *CreateInstSharingDB() {
+    return new sinst::SharedInstDB(CreateMutex());
+  }
   void HandlePreSetup();
   void HandlePostSetup();
   bool HandleIgnoreMemAccess(IMG img);
@@ -39,6 +48,7 @@ class Profiler : public ExecutionControl {
 
   RaceDB *race_db_;
   Djit *djit_analyzer_;
+  FastTrack *fasttrack_analyzer_;
 
  private:
   DISALLOW_COPY_CONSTRUCTORS(Profiler);
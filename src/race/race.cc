@@ -18,12 +18,29 @@
 
 #include "race/race.h"
 
+#include <cstring>
+
+#include "core/atomic.h"
 #include "core/logging.h"
 
+// the number of proto entries written at a time when saving
+#define RACE_SAVE_BATCH_SIZE 1024
+
 namespace race {
 
+static size_t HashCombine(size_t hash_val, size_t val) {
+  return hash_val ^ (val + 0x9e3779b9 + (hash_val << 6) + (hash_val >> 2));
+}
+
+static void FlushProto(RaceDBProto *proto, std::fstream *out) {
+  // concatenated messages are merged when parsed, so the output file
+  // is still a single RaceDBProto
+  proto->SerializeToOstream(out);
+  proto->Clear();
+}
+
 size_t StaticRaceEvent::Hash() {
-  return (size_t)inst_ + (size_t)type_;
+  return HashCombine((size_t)inst_ >> 2, (size_t)type_);
 }
 
 bool StaticRaceEvent::Match(StaticRaceEvent *e) {
@@ -33,7 +50,7 @@ bool StaticRaceEvent::Match(StaticRaceEvent *e) {
 size_t StaticRace::Hash() {
   size_t hash_val = 0;
   for (size_t i = 0; i < event_vec_.size(); i++)
-    hash_val += (size_t)event_vec_[i];
+    hash_val = HashCombine(hash_val, event_vec_[i]->Hash());
   return hash_val;
 }
 
@@ -47,12 +64,13 @@ bool StaticRace::Match(StaticRace *r) {
   return true;
 }
 
-RaceDB::RaceDB(Mutex *lock)
+RaceDB::RaceDB(RWMutex *lock)
     : internal_lock_(lock),
       curr_static_event_id_(0),
       curr_static_race_id_(0),
-      curr_exec_id_(0) {
-  // empty
+      curr_exec_id_(0),
+      max_races_(0) {
+  memset(race_cache_, 0, sizeof(race_cache_));
 }
 
 RaceDB::~RaceDB() {
@@ -62,7 +80,17 @@ RaceDB::~RaceDB() {
 Race *RaceDB::CreateRace(address_t addr, thread_id_t t0, Inst *i0,
                          RaceEventType p0, thread_id_t t1, Inst *i1,
                          RaceEventType p1, bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedWriteLock locker(internal_lock_, locking);
+
+  // get static race
+  StaticRaceEvent *static_e0 = GetStaticRaceEvent(i0, p0, false);
+  StaticRaceEvent *static_e1 = GetStaticRaceEvent(i1, p1, false);
+  StaticRace *static_race = GetStaticRace(static_e0, static_e1, false);
+  ATOMIC_ADD_AND_FETCH(&static_race->count_, 1);
+  if (max_races_ && static_race->num_races_ >= max_races_) {
+    CacheStaticRace(static_race);
+    return NULL;
+  }
 
   Race *race = new Race;
   race->exec_id_ = curr_exec_id_;
@@ -72,27 +100,49 @@ Race *RaceDB::CreateRace(address_t addr, thread_id_t t0, Inst *i0,
   RaceEvent *e1 = new RaceEvent;
   e0->thd_id_ = t0;
   e1->thd_id_ = t1;
-  e0->static_event_ = GetStaticRaceEvent(i0, p0, false);
-  e1->static_event_ = GetStaticRaceEvent(i1, p1, false);
+  e0->static_event_ = static_e0;
+  e1->static_event_ = static_e1;
   race->event_vec_.push_back(e0);
   race->event_vec_.push_back(e1);
-  // get static race
-  race->static_race_ = GetStaticRace(e0->static_event_,
-                                     e1->static_event_,
-                                     false);
+  race->static_race_ = static_race;
+  static_race->num_races_++;
   // put self into race vector
   race_vec_.push_back(race);
   return race;
 }
 
+bool RaceDB::KnownRace(Inst *i0, RaceEventType p0, Inst *i1,
+                       RaceEventType p1) {
+  if (!max_races_)
+    return false;
+
+  StaticRaceEvent e0;
+  StaticRaceEvent e1;
+  e0.inst_ = i0;
+  e0.type_ = p0;
+  e1.inst_ = i1;
+  e1.type_ = p1;
+  size_t hash_val = HashCombine(HashCombine(0, e0.Hash()), e1.Hash());
+  for (size_t i = 0; i < RACE_CACHE_PROBES; i++) {
+    StaticRace *r = race_cache_[(hash_val + i) % RACE_CACHE_SIZE];
+    if (!r)
+      return false;
+    if (e0.Match(r->event_vec_[0]) && e1.Match(r->event_vec_[1])) {
+      ATOMIC_ADD_AND_FETCH(&r->count_, 1);
+      return true;
+    }
+  }
+  return false;
+}
+
 void RaceDB::SetRacyInst(Inst *inst, bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedWriteLock locker(internal_lock_, locking);
 
   racy_inst_set_.insert(inst);
 }
 
 bool RaceDB::RacyInst(Inst *inst, bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedReadLock locker(internal_lock_, locking);
 
   return racy_inst_set_.find(inst) != racy_inst_set_.end();
 }
@@ -118,6 +168,7 @@ void RaceDB::Load(const std::string &db_name, StaticInfo *sinfo) {
       curr_static_event_id_ = e->id_;
   }
   // load static races
+  std::tr1::unordered_set<StaticRace *> uncounted_set;
   for (int i = 0; i < proto.static_race_size(); i++) {
     StaticRaceProto *r_proto = proto.mutable_static_race(i);
     StaticRace *r = new StaticRace;
@@ -127,6 +178,10 @@ void RaceDB::Load(const std::string &db_name, StaticInfo *sinfo) {
       DEBUG_ASSERT(e);
       r->event_vec_.push_back(e);
     }
+    if (r_proto->has_count())
+      r->count_ = r_proto->count();
+    else
+      uncounted_set.insert(r);
     static_race_table_[r->id_] = r;
     static_race_index_[r->Hash()].push_back(r);
     if (curr_static_race_id_ < r->id_)
@@ -148,6 +203,11 @@ void RaceDB::Load(const std::string &db_name, StaticInfo *sinfo) {
     }
     r->static_race_ = FindStaticRace(r_proto->static_id(), false);
     DEBUG_ASSERT(r->static_race_);
+    // the races of the previous executions do not count toward
+    // max_races. the old databases do not have the counters, so count
+    // the recorded races instead.
+    if (uncounted_set.find(r->static_race_) != uncounted_set.end())
+      r->static_race_->count_++;
     race_vec_.push_back(r);
     if (curr_exec_id_ < r->exec_id_)
       curr_exec_id_ = r->exec_id_;
@@ -162,6 +222,10 @@ void RaceDB::Load(const std::string &db_name, StaticInfo *sinfo) {
 }
 
 void RaceDB::Save(const std::string &db_name, StaticInfo *sinfo) {
+  // the proto is written in batches so that the whole database is
+  // never held in memory
+  std::fstream out(db_name.c_str(),
+                   std::ios::out | std::ios::trunc | std::ios::binary);
   RaceDBProto proto;
   // save static events
   for (StaticRaceEvent::Map::iterator it = static_event_table_.begin();
@@ -171,7 +235,10 @@ void RaceDB::Save(const std::string &db_name, StaticInfo *sinfo) {
     e_proto->set_id(e->id_);
     e_proto->set_inst_id(e->inst_->id());
     e_proto->set_type(e->type_);
+    if (proto.static_event_size() >= RACE_SAVE_BATCH_SIZE)
+      FlushProto(&proto, &out);
   }
+  FlushProto(&proto, &out);
   // save static races
   for (StaticRace::Map::iterator it = static_race_table_.begin();
        it != static_race_table_.end(); ++it) {
@@ -183,7 +250,11 @@ void RaceDB::Save(const std::string &db_name, StaticInfo *sinfo) {
       StaticRaceEvent *e = *vit;
       r_proto->add_event_id(e->id_);
     }
+    r_proto->set_count(r->count_);
+    if (proto.static_race_size() >= RACE_SAVE_BATCH_SIZE)
+      FlushProto(&proto, &out);
   }
+  FlushProto(&proto, &out);
   // save races
   for (Race::Vec::iterator it = race_vec_.begin();
        it != race_vec_.end(); ++it) {
@@ -199,17 +270,17 @@ void RaceDB::Save(const std::string &db_name, StaticInfo *sinfo) {
       e_proto->set_static_id(e->static_event_->id_);
     }
     r_proto->set_static_id(r->static_race_->id_);
+    if (proto.race_size() >= RACE_SAVE_BATCH_SIZE)
+      FlushProto(&proto, &out);
   }
+  FlushProto(&proto, &out);
   // save racy insts
   for (RacyInstSet::iterator it = racy_inst_set_.begin();
        it != racy_inst_set_.end(); ++it) {
     Inst *inst = *it;
     proto.add_racy_inst_id(inst->id());
   }
-  // save to file
-  std::fstream out(db_name.c_str(),
-                   std::ios::out | std::ios::trunc | std::ios::binary);
-  proto.SerializeToOstream(&out);
+  FlushProto(&proto, &out);
   out.close();
 }
 
@@ -217,7 +288,7 @@ void RaceDB::Save(const std::string &db_name, StaticInfo *sinfo) {
 StaticRaceEvent *RaceDB::CreateStaticRaceEvent(Inst *inst,
                                                RaceEventType type,
                                                bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedWriteLock locker(internal_lock_, locking);
 
   StaticRaceEvent *static_event = new StaticRaceEvent;
   static_event->id_ = ++curr_static_event_id_;
@@ -231,7 +302,7 @@ StaticRaceEvent *RaceDB::CreateStaticRaceEvent(Inst *inst,
 StaticRaceEvent *RaceDB::FindStaticRaceEvent(Inst *inst,
                                              RaceEventType type,
                                              bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedReadLock locker(internal_lock_, locking);
 
   StaticRaceEvent static_event;
   static_event.inst_ = inst;
@@ -251,7 +322,7 @@ StaticRaceEvent *RaceDB::FindStaticRaceEvent(Inst *inst,
 
 StaticRaceEvent *RaceDB::FindStaticRaceEvent(StaticRaceEvent::id_t id,
                                              bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedReadLock locker(internal_lock_, locking);
 
   StaticRaceEvent::Map::iterator it = static_event_table_.find(id);
   if (it == static_event_table_.end())
@@ -263,9 +334,14 @@ StaticRaceEvent *RaceDB::FindStaticRaceEvent(StaticRaceEvent::id_t id,
 StaticRaceEvent *RaceDB::GetStaticRaceEvent(Inst *inst,
                                             RaceEventType type,
                                             bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  // most static events exist already, look them up with the read lock
+  StaticRaceEvent *static_event = FindStaticRaceEvent(inst, type, locking);
+  if (static_event)
+    return static_event;
+
+  ScopedWriteLock locker(internal_lock_, locking);
 
-  StaticRaceEvent *static_event = FindStaticRaceEvent(inst, type, false);
+  static_event = FindStaticRaceEvent(inst, type, false);
   if (!static_event)
     static_event = CreateStaticRaceEvent(inst, type, false);
   return static_event;
@@ -274,7 +350,7 @@ StaticRaceEvent *RaceDB::GetStaticRaceEvent(Inst *inst,
 StaticRace *RaceDB::CreateStaticRace(StaticRaceEvent *e0,
                                      StaticRaceEvent *e1,
                                      bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedWriteLock locker(internal_lock_, locking);
 
   StaticRace *static_race = new StaticRace;
   static_race->id_ = ++curr_static_race_id_;
@@ -288,7 +364,7 @@ StaticRace *RaceDB::CreateStaticRace(StaticRaceEvent *e0,
 StaticRace *RaceDB::FindStaticRace(StaticRaceEvent *e0,
                                    StaticRaceEvent *e1,
                                    bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedReadLock locker(internal_lock_, locking);
 
   StaticRace static_race;
   static_race.event_vec_.push_back(e0);
@@ -308,7 +384,7 @@ StaticRace *RaceDB::FindStaticRace(StaticRaceEvent *e0,
 
 StaticRace *RaceDB::FindStaticRace(StaticRace::id_t id,
                                    bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  ScopedReadLock locker(internal_lock_, locking);
 
   StaticRace::Map::iterator it = static_race_table_.find(id);
   if (it == static_race_table_.end())
@@ -320,13 +396,33 @@ StaticRace *RaceDB::FindStaticRace(StaticRace::id_t id,
 StaticRace *RaceDB::GetStaticRace(StaticRaceEvent *e0,
                                   StaticRaceEvent *e1,
                                   bool locking) {
-  ScopedLock locker(internal_lock_, locking);
+  StaticRace *static_race = FindStaticRace(e0, e1, locking);
+  if (static_race)
+    return static_race;
 
-  StaticRace *static_race = FindStaticRace(e0, e1, false);
+  ScopedWriteLock locker(internal_lock_, locking);
+
+  static_race = FindStaticRace(e0, e1, false);
   if (!static_race)
     static_race = CreateStaticRace(e0, e1, false);
   return static_race;
 }
 
+void RaceDB::CacheStaticRace(StaticRace *r) {
+  // the caller should hold the internal lock
+  size_t hash_val = r->Hash();
+  for (size_t i = 0; i < RACE_CACHE_PROBES; i++) {
+    StaticRace **slot = &race_cache_[(hash_val + i) % RACE_CACHE_SIZE];
+    if (*slot == r)
+      return;
+    if (!*slot) {
+      // the static race is fully constructed before being published
+      MEMORY_BARRIER();
+      *slot = r;
+      return;
+    }
+  }
+}
+
 } // namespace race
 
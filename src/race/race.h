@@ -27,6 +27,11 @@
 #include "core/static_info.h"
 #include "race/race.pb.h"
 
+// the size of the lock free cache of saturated static races
+#define RACE_CACHE_SIZE 4096
+// the maximum number of probes in the static race cache
+#define RACE_CACHE_PROBES 8
+
 namespace race {
 
 // forward declarations
@@ -73,13 +78,16 @@ class StaticRace {
   bool Match(StaticRace *r);
 
   id_t id() { return id_; }
+  uint64 count() { return count_; }
 
  protected:
-  StaticRace() : id_(0) {}
+  StaticRace() : id_(0), count_(0), num_races_(0) {}
   ~StaticRace() {}
 
   id_t id_;
   StaticRaceEvent::Vec event_vec_;
+  uint64 count_; // the number of dynamic instances (recorded or not)
+  size_t num_races_; // the number of dynamic races recorded in this execution
 
  private:
   friend class RaceDB;
@@ -135,15 +143,23 @@ class Race {
 // the race database
 class RaceDB {
  public:
-  explicit RaceDB(Mutex *lock);
+  explicit RaceDB(RWMutex *lock);
   ~RaceDB();
 
+  // record a dynamic race. return NULL if the static race already has
+  // max_races dynamic races recorded in the current execution, in which
+  // case only its counter is incremented.
   Race *CreateRace(address_t addr, thread_id_t t0, Inst *i0, RaceEventType p0,
                    thread_id_t t1, Inst *i1, RaceEventType p1, bool locking);
+  // lock free check of whether the static race is known and already
+  // has max_races dynamic races recorded. if so, increment its counter
+  // and return true, and the caller does not need to call CreateRace.
+  bool KnownRace(Inst *i0, RaceEventType p0, Inst *i1, RaceEventType p1);
   void SetRacyInst(Inst *inst, bool locking);
   bool RacyInst(Inst *inst, bool locking);
   void Load(const std::string &db_name, StaticInfo *sinfo);
   void Save(const std::string &db_name, StaticInfo *sinfo);
+  void set_max_races(size_t max_races) { max_races_ = max_races; }
 
  protected:
   typedef std::tr1::unordered_set<Inst *> RacyInstSet;
@@ -170,8 +186,9 @@ class RaceDB {
   StaticRace *GetStaticRace(StaticRaceEvent *e0,
                             StaticRaceEvent *e1,
                             bool locking);
+  void CacheStaticRace(StaticRace *r);
 
-  Mutex *internal_lock_;
+  RWMutex *internal_lock_;
   StaticRaceEvent::id_t curr_static_event_id_;
   StaticRace::id_t curr_static_race_id_;
   int curr_exec_id_;
@@ -181,6 +198,8 @@ class RaceDB {
   StaticRace::HashIndex static_race_index_;
   Race::Vec race_vec_;
   RacyInstSet racy_inst_set_;
+  size_t max_races_; // per static race per execution (0 means no limit)
+  StaticRace *race_cache_[RACE_CACHE_SIZE]; // saturated static races
 
  private:
   DISALLOW_COPY_CONSTRUCTORS(RaceDB);
@@ -88,6 +88,9 @@ void Scheduler::HandlePostSetup() {
   delay_ = knob_->ValueBool("delay");
   float_ = knob_->ValueBool("float");
 
+  // bind cached knobs
+  strict_knob_.Bind(knob_, "strict");
+
   Randomize();
 }
 
@@ -193,7 +196,7 @@ void Scheduler::Randomize() {
   seed_random_number(unsigned(time(NULL)));
 
   if (!delay_) {
-    if (knob_->ValueBool("strict")) {
+    if (strict_knob_.Value()) {
       int low = knob_->ValueInt("lowest_realtime_priority");
       int high = knob_->ValueInt("highest_realtime_priority");
       for (int prio = low; prio <= high; prio++) {
@@ -237,7 +240,7 @@ void Scheduler::Randomize() {
 void Scheduler::SetPriority(int priority) {
   DEBUG_FMT_PRINT_SAFE("[T%" PRIx64 "] set priority = %d\n",
                        PIN_ThreadUid(), priority);
-  if (knob_->ValueBool("strict")) {
+  if (strict_knob_.Value()) {
     SetStrictPriority(priority);
   } else {
     SetRelaxPriority(priority);
@@ -65,6 +65,8 @@ class Scheduler : public ExecutionControl {
   int curr_num_threads_;
   volatile bool start_sched_; // start scheduling when at least two
                               // threads are created
+  // cached knobs (read in the analysis routines)
+  BoolKnob strict_knob_;
 
  private:
   static void __Change(UINT32 c);
@@ -27,18 +27,21 @@ SharedInstAnalyzer::SharedInstAnalyzer()
     : internal_lock_(NULL),
       sinst_db_(NULL),
       unit_size_(4),
-      filter_(NULL) {
+      filter_(NULL),
+      meta_table_(NULL) {
   // do nothing
 }
 
 SharedInstAnalyzer::~SharedInstAnalyzer() {
   delete internal_lock_;
   delete filter_;
+  delete meta_table_;
 }
 
 void SharedInstAnalyzer::Register() {
   knob_->RegisterBool("enable_sinst", "whether enable the shared inst analyzer", "0");
   knob_->RegisterInt("unit_size", "the monitoring granularity in bytes", "4");
+  knob_->RegisterBool("sinst_batch", "whether process memory accesses in batches", "0");
 }
 
 bool SharedInstAnalyzer::Enabled() {
@@ -50,8 +53,13 @@ void SharedInstAnalyzer::Setup(Mutex *lock, SharedInstDB *sinst_db) {
   sinst_db_ = sinst_db;
   unit_size_ = knob_->ValueInt("unit_size");
   filter_ = new RegionFilter(internal_lock_->Clone());
+  meta_table_ = new Meta::Table(unit_size_);
   // set analyzer descriptor
-  desc_.SetHookBeforeMem();
+  if (knob_->ValueBool("sinst_batch"))
+    desc_.SetHookMemBatch();
+  else
+    desc_.SetHookBeforeMem();
+  desc_.SetPublishMemRegion();
   desc_.SetHookMallocFunc();
 }
 
@@ -85,6 +93,34 @@ void SharedInstAnalyzer::BeforeMemRead(thread_id_t curr_thd_id,
                                        timestamp_t curr_thd_clk, Inst *inst,
                                        address_t addr, size_t size) {
   ScopedLock locker(internal_lock_);
+  ProcessRead(curr_thd_id, inst, addr, size);
+}
+
+void SharedInstAnalyzer::BeforeMemWrite(thread_id_t curr_thd_id,
+                                        timestamp_t curr_thd_clk, Inst *inst,
+                                        address_t addr, size_t size) {
+  ScopedLock locker(internal_lock_);
+  ProcessWrite(curr_thd_id, inst, addr, size);
+}
+
+void SharedInstAnalyzer::MemAccessBatch(thread_id_t curr_thd_id,
+                                        MemAccess *accesses,
+                                        size_t num_accesses) {
+  // only lock once for the whole batch
+  ScopedLock locker(internal_lock_);
+  for (size_t i = 0; i < num_accesses; i++) {
+    MemAccess *access = &accesses[i];
+    if (access->is_write)
+      ProcessWrite(curr_thd_id, access->inst, access->addr, access->size);
+    else
+      ProcessRead(curr_thd_id, access->inst, access->addr, access->size);
+  }
+}
+
+void SharedInstAnalyzer::ProcessRead(thread_id_t curr_thd_id, Inst *inst,
+                                     address_t addr, size_t size) {
+  // the caller should hold the internal lock
+  sinst_db_->SetProfiled(inst);
   if (FilterAccess(addr))
     return;
   // normalize accesses
@@ -92,14 +128,15 @@ void SharedInstAnalyzer::BeforeMemRead(thread_id_t curr_thd_id,
   address_t end_addr = UNIT_UP_ALIGN(addr + size, unit_size_);
   for (address_t iaddr = start_addr; iaddr < end_addr; iaddr += unit_size_) {
     // check shared for iaddr
-    Meta::Table::iterator mit = meta_table_.find(iaddr);
-    if (mit == meta_table_.end()) {
-      Meta &meta = meta_table_[iaddr];
+    Meta **slot = meta_table_->Get(iaddr);
+    if (!*slot) {
+      *slot = new Meta;
+      Meta &meta = **slot;
       meta.last_thd_id = curr_thd_id;
       meta.inst_set.insert(inst);
     } else {
       // shared info exists
-      Meta &meta = mit->second;
+      Meta &meta = **slot;
       if (meta.shared) {
         // meta is shared
         sinst_db_->SetShared(inst);
@@ -125,10 +162,10 @@ void SharedInstAnalyzer::BeforeMemRead(thread_id_t curr_thd_id,
   } // end of for each iaddr
 }
 
-void SharedInstAnalyzer::BeforeMemWrite(thread_id_t curr_thd_id,
-                                        timestamp_t curr_thd_clk, Inst *inst,
-                                        address_t addr, size_t size) {
-  ScopedLock locker(internal_lock_);
+void SharedInstAnalyzer::ProcessWrite(thread_id_t curr_thd_id, Inst *inst,
+                                      address_t addr, size_t size) {
+  // the caller should hold the internal lock
+  sinst_db_->SetProfiled(inst);
   if (FilterAccess(addr))
     return;
   // normalize accesses
@@ -136,15 +173,16 @@ void SharedInstAnalyzer::BeforeMemWrite(thread_id_t curr_thd_id,
   address_t end_addr = UNIT_UP_ALIGN(addr + size, unit_size_);
   for (address_t iaddr = start_addr; iaddr < end_addr; iaddr += unit_size_) {
     // check shared for iaddr
-    Meta::Table::iterator mit = meta_table_.find(iaddr);
-    if (mit == meta_table_.end()) {
-      Meta &meta = meta_table_[iaddr];
+    Meta **slot = meta_table_->Get(iaddr);
+    if (!*slot) {
+      *slot = new Meta;
+      Meta &meta = **slot;
       meta.has_write = true;
       meta.last_thd_id = curr_thd_id;
       meta.inst_set.insert(inst);
     } else {
       // shared info exists
-      Meta &meta = mit->second;
+      Meta &meta = **slot;
       if (meta.shared) {
         // meta is shared
         sinst_db_->SetShared(inst);
@@ -208,6 +246,8 @@ void SharedInstAnalyzer::AllocAddrRegion(address_t addr, size_t size) {
   ScopedLock locker(internal_lock_);
   DEBUG_ASSERT(addr && size);
   filter_->AddRegion(addr, size, false);
+  if (access_predicate_)
+    access_predicate_->AddRegion(addr, size);
 }
 
 void SharedInstAnalyzer::FreeAddrRegion(address_t addr) {
@@ -216,12 +256,14 @@ void SharedInstAnalyzer::FreeAddrRegion(address_t addr) {
   size_t size = filter_->RemoveRegion(addr, false);
   address_t start_addr = UNIT_DOWN_ALIGN(addr, unit_size_);
   address_t end_addr = UNIT_UP_ALIGN(addr + size, unit_size_);
-  for (address_t iaddr = start_addr; iaddr < end_addr; iaddr += unit_size_) {
-    Meta::Table::iterator it = meta_table_.find(iaddr);
-    if (it != meta_table_.end()) {
-      meta_table_.erase(it);
-    }
+  // only visit the existing meta data
+  address_t iaddr = start_addr;
+  for (Meta **slot = meta_table_->FindNext(iaddr, end_addr, &iaddr); slot;
+       slot = meta_table_->FindNext(iaddr + unit_size_, end_addr, &iaddr)) {
+    delete *slot;
+    *slot = NULL;
   }
+  meta_table_->Release(addr, size);
 }
 
 } // namespace sinst
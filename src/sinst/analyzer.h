@@ -27,6 +27,7 @@
 #include "core/analyzer.h"
 #include "core/sync.h"
 #include "core/filter.h"
+#include "core/shadow_memory.h"
 #include "sinst/sinst.h"
 
 namespace sinst {
@@ -50,6 +51,8 @@ class SharedInstAnalyzer : public Analyzer {
                      Inst *inst, address_t addr, size_t size);
   void BeforeMemWrite(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
                       Inst *inst, address_t addr, size_t size);
+  void MemAccessBatch(thread_id_t curr_thd_id, MemAccess *accesses,
+                      size_t num_accesses);
   void AfterMalloc(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
                    Inst *inst, size_t size, address_t addr);
   void AfterCalloc(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
@@ -68,7 +71,7 @@ class SharedInstAnalyzer : public Analyzer {
   class Meta {
    public:
     typedef std::set<Inst *> InstSet;
-    typedef std::tr1::unordered_map<address_t, Meta> Table;
+    typedef ShadowMemory<Meta *> Table;
 
     Meta()
         : shared(false),
@@ -85,6 +88,10 @@ class SharedInstAnalyzer : public Analyzer {
     InstSet inst_set;
   };
 
+  void ProcessRead(thread_id_t curr_thd_id, Inst *inst, address_t addr,
+                   size_t size);
+  void ProcessWrite(thread_id_t curr_thd_id, Inst *inst, address_t addr,
+                    size_t size);
   void AllocAddrRegion(address_t addr, size_t size);
   void FreeAddrRegion(address_t addr);
   bool FilterAccess(address_t addr) { return filter_->Filter(addr, false); }
@@ -93,7 +100,7 @@ class SharedInstAnalyzer : public Analyzer {
   SharedInstDB *sinst_db_;
   address_t unit_size_;
   RegionFilter *filter_;
-  Meta::Table meta_table_;
+  Meta::Table *meta_table_;
 
  private:
   DISALLOW_COPY_CONSTRUCTORS(SharedInstAnalyzer);
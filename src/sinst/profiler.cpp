@@ -34,9 +34,14 @@ void Profiler::HandlePreSetup() {
 void Profiler::HandlePostSetup() {
   ExecutionControl::HandlePostSetup();
 
-  // load shared inst db
-  sinst_db_ = new SharedInstDB(CreateMutex());
-  sinst_db_->Load(knob_->ValueStr("sinst_in"), sinfo_);
+  // load shared inst db (reuse the one loaded for pruning if any, which
+  // is created by CreateInstSharingDB)
+  if (prune_db_) {
+    sinst_db_ = static_cast<SharedInstDB *>(prune_db_);
+  } else {
+    sinst_db_ = new SharedInstDB(CreateMutex());
+    sinst_db_->Load(knob_->ValueStr("sinst_in"), sinfo_);
+  }
   // add sinst analyzer
   sinst_analyzer_->Setup(CreateMutex(), sinst_db_);
   AddAnalyzer(sinst_analyzer_);
@@ -45,8 +50,8 @@ void Profiler::HandlePostSetup() {
 void Profiler::HandleProgramExit() {
   ExecutionControl::HandleProgramExit();
 
-  if (sinst_analyzer_->Enabled()) {
-    // save shared inst db
+  // save shared inst db (saved by the controller if pruning)
+  if (sinst_analyzer_->Enabled() && sinst_db_ != prune_db_) {
     sinst_db_->Save(knob_->ValueStr("sinst_out"), sinfo_);
   }
 }
@@ -34,6 +34,9 @@ class Profiler : public ExecutionControl {
   ~Profiler() {}
 
  private:
+  InstSharingDB *CreateInstSharingDB() {
+    return new SharedInstDB(CreateMutex());
+  }
   void HandlePreSetup();
   void HandlePostSetup();
   void HandleProgramExit();
@@ -24,22 +24,33 @@
 
 namespace sinst {
 
-bool SharedInstDB::Shared(Inst *inst, bool locking) {
+bool SharedInstDB::Profiled(Inst *inst, bool locking) {
+  // no need to lock, the set can be read while being updated
+  return profiled_inst_set_.Contains(inst);
+}
+
+void SharedInstDB::SetProfiled(Inst *inst, bool locking) {
+  if (profiled_inst_set_.Contains(inst))
+    return;
+
   ScopedLock locker(internal_lock_, locking);
 
-  SharedInstSet::iterator it = shared_inst_set_.find(inst);
-  if (it == shared_inst_set_.end())
-    return false;
-  else
-    return true;
+  if (profiled_inst_set_.Insert(inst))
+    table_proto_.add_profiled_inst_id(inst->id());
+}
+
+bool SharedInstDB::Shared(Inst *inst, bool locking) {
+  // no need to lock, the set can be read while being updated
+  return shared_inst_set_.Contains(inst);
 }
 
 void SharedInstDB::SetShared(Inst *inst, bool locking) {
+  if (shared_inst_set_.Contains(inst))
+    return;
+
   ScopedLock locker(internal_lock_, locking);
 
-  SharedInstSet::iterator it = shared_inst_set_.find(inst);
-  if (it == shared_inst_set_.end()) {
-    shared_inst_set_.insert(inst);
+  if (shared_inst_set_.Insert(inst)) {
     SharedInstProto *proto = table_proto_.add_shared_inst();
     proto->set_inst_id(inst->id());
   }
@@ -54,7 +65,13 @@ void SharedInstDB::Load(const std::string &db_name, StaticInfo *sinfo) {
     const SharedInstProto &proto = table_proto_.shared_inst(i);
     Inst *inst = sinfo->FindInst(proto.inst_id());
     DEBUG_ASSERT(inst);
-    shared_inst_set_.insert(inst);
+    shared_inst_set_.Insert(inst);
+  }
+  // setup profiled inst set
+  for (int i = 0; i < table_proto_.profiled_inst_id_size(); i++) {
+    Inst *inst = sinfo->FindInst(table_proto_.profiled_inst_id(i));
+    DEBUG_ASSERT(inst);
+    profiled_inst_set_.Insert(inst);
   }
 }
 
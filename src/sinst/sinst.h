@@ -19,33 +19,42 @@
 #ifndef SINST_SINST_H_
 #define SINST_SINST_H_
 
-#include <tr1/unordered_set>
-
 #include "core/basictypes.h"
 #include "core/sync.h"
+#include "core/inst_sharing_db.h"
+#include "core/read_mostly_set.h"
 #include "core/static_info.h"
 #include "sinst/sinst.pb.h" // protobuf head file
 
 namespace sinst {
 
-// Shared instruction database
-class SharedInstDB {
+// Shared instruction database. It also records the insts that have
+// been seen by the profiler, so that the insts that are not shared can
+// be told from those that are unknown. Queries are lock free (they are
+// much more frequent than updates), the internal lock serializes
+// updates.
+class SharedInstDB : public InstSharingDB {
  public:
   SharedInstDB(Mutex *lock) : internal_lock_(lock) {}
   ~SharedInstDB() { delete internal_lock_; }
 
+  bool Profiled(Inst *inst) { return Profiled(inst, true); }
+  void SetProfiled(Inst *inst) { SetProfiled(inst, true); }
   bool Shared(Inst *inst) { return Shared(inst, true); }
   void SetShared(Inst *inst) { SetShared(inst, true); }
+  bool Profiled(Inst *inst, bool locking);
+  void SetProfiled(Inst *inst, bool locking);
   bool Shared(Inst *inst, bool locking);
   void SetShared(Inst *inst, bool locking);
   void Load(const std::string &db_name, StaticInfo *sinfo);
   void Save(const std::string &db_name, StaticInfo *sinfo);
 
  private:
-  typedef std::tr1::unordered_set<Inst *> SharedInstSet;
+  typedef ReadMostlySet<Inst> InstSet;
 
   Mutex *internal_lock_;
-  SharedInstSet shared_inst_set_;
+  InstSet profiled_inst_set_;
+  InstSet shared_inst_set_;
   SharedInstTableProto table_proto_;
 
   DISALLOW_COPY_CONSTRUCTORS(SharedInstDB);
@@ -46,7 +46,8 @@ Controller::Controller()
       scheduler_thd_uid_(INVALID_PIN_THREAD_UID),
       program_exiting_(false),
       next_state_ready_(false),
-      next_state_sem_(NULL) {
+      next_state_sem_(NULL),
+      race_ctx_(NULL) {
   // empty
 }
 
@@ -86,7 +87,8 @@ void Controller::HandlePostSetup() {
   program_->Load(knob_->ValueStr("program_in"), sinfo_);
   execution_ = new Execution;
   if (sched_race_) {
-    race_db_ = new race::RaceDB(CreateMutex());
+    race_ctx_ = (RaceContext *)AllocThreadContexts(sizeof(RaceContext));
+    race_db_ = new race::RaceDB(CreateRWMutex());
     race_db_->Load(knob_->ValueStr("race_in"), sinfo_);
   }
   next_state_sem_ = CreateSemaphore(0);
@@ -1089,39 +1091,39 @@ void Controller::__SchedulerThreadReclaim(INT32 code, VOID *v) {
 void Controller::__BeforeRaceRead(THREADID tid, Inst *inst, ADDRINT addr,
                                   UINT32 size) {
   ((Controller *)ctrl_)->HandleBeforeRaceRead(tid, inst, addr, size);
-  ((Controller *)ctrl_)->tls_race_read_addr_[tid] = addr;
-  ((Controller *)ctrl_)->tls_race_read_size_[tid] = size;
+  ((Controller *)ctrl_)->race_ctx_[tid].read_addr = addr;
+  ((Controller *)ctrl_)->race_ctx_[tid].read_size = size;
 }
 
 void Controller::__AfterRaceRead(THREADID tid, Inst *inst) {
-  address_t addr = ((Controller *)ctrl_)->tls_race_read_addr_[tid];
-  address_t size = ((Controller *)ctrl_)->tls_race_read_size_[tid];
+  address_t addr = ((Controller *)ctrl_)->race_ctx_[tid].read_addr;
+  address_t size = ((Controller *)ctrl_)->race_ctx_[tid].read_size;
   ((Controller *)ctrl_)->HandleAfterRaceRead(tid, inst, addr, size);
 }
 
 void Controller::__BeforeRaceWrite(THREADID tid, Inst *inst, ADDRINT addr,
                                    UINT32 size) {
   ((Controller *)ctrl_)->HandleBeforeRaceWrite(tid, inst, addr, size);
-  ((Controller *)ctrl_)->tls_race_write_addr_[tid] = addr;
-  ((Controller *)ctrl_)->tls_race_write_size_[tid] = size;
+  ((Controller *)ctrl_)->race_ctx_[tid].write_addr = addr;
+  ((Controller *)ctrl_)->race_ctx_[tid].write_size = size;
 }
 
 void Controller::__AfterRaceWrite(THREADID tid, Inst *inst) {
-  address_t addr = ((Controller *)ctrl_)->tls_race_write_addr_[tid];
-  size_t size = ((Controller *)ctrl_)->tls_race_write_size_[tid];
+  address_t addr = ((Controller *)ctrl_)->race_ctx_[tid].write_addr;
+  size_t size = ((Controller *)ctrl_)->race_ctx_[tid].write_size;
   ((Controller *)ctrl_)->HandleAfterRaceWrite(tid, inst, addr, size);
 }
 
 void Controller::__BeforeRaceRead2(THREADID tid, Inst *inst, ADDRINT addr,
                                    UINT32 size) {
   ((Controller *)ctrl_)->HandleBeforeRaceRead(tid, inst, addr, size);
-  ((Controller *)ctrl_)->tls_race_read2_addr_[tid] = addr;
-  ((Controller *)ctrl_)->tls_race_read_size_[tid] = size;
+  ((Controller *)ctrl_)->race_ctx_[tid].read2_addr = addr;
+  ((Controller *)ctrl_)->race_ctx_[tid].read_size = size;
 }
 
 void Controller::__AfterRaceRead2(THREADID tid, Inst *inst) {
-  address_t addr = ((Controller *)ctrl_)->tls_race_read2_addr_[tid];
-  address_t size = ((Controller *)ctrl_)->tls_race_read_size_[tid];
+  address_t addr = ((Controller *)ctrl_)->race_ctx_[tid].read2_addr;
+  address_t size = ((Controller *)ctrl_)->race_ctx_[tid].read_size;
   ((Controller *)ctrl_)->HandleAfterRaceRead(tid, inst, addr, size);
 }
 
@@ -23,6 +23,7 @@
 #include "core/basictypes.h"
 #include "core/execution_control.hpp"
 #include "race/race.h"
+#include "sinst/sinst.h"
 #include "systematic/scheduler.h"
 #include "systematic/random.h"
 #include "systematic/chess.h"
@@ -159,6 +160,9 @@ class Controller : public ExecutionControl, public ControllerInterface {
   };
 
   // overrided virtual functions
+  virtual InstSharingDB *CreateInstSharingDB() {
+    return new sinst::SharedInstDB(CreateMutex());
+  }
   virtual void HandlePreSetup();
   virtual void HandlePostSetup();
   virtual void HandlePreInstrumentTrace(TRACE trace);
@@ -252,12 +256,17 @@ class Controller : public ExecutionControl, public ControllerInterface {
   JoinInfo::Map join_info_table_;
 
   // racy memory op related
+  class RaceContext {
+   public:
+    address_t read_addr;
+    size_t read_size;
+    address_t write_addr;
+    size_t write_size;
+    address_t read2_addr;
+  } CACHE_LINE_ALIGNED;
+
   std::map<thread_id_t, bool> race_active_table_;
-  address_t tls_race_read_addr_[PIN_MAX_THREADS];
-  size_t tls_race_read_size_[PIN_MAX_THREADS];
-  address_t tls_race_write_addr_[PIN_MAX_THREADS];
-  size_t tls_race_write_size_[PIN_MAX_THREADS];
-  address_t tls_race_read2_addr_[PIN_MAX_THREADS];
+  RaceContext *race_ctx_; // PIN_MAX_THREADS contexts (indexed by pin tid)
 
  private:
   static void __SchedulerThread(VOID *arg);
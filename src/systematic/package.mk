@@ -33,6 +33,8 @@ systematic_controller_objs := \
   systematic/scheduler.o \
   systematic/search.o \
   systematic/search.pb.o \
+  sinst/sinst.o \
+  sinst/sinst.pb.o \
   $(race_objs) \
   $(core_objs)
 
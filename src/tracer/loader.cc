@@ -84,6 +84,16 @@ void Loader::AddAnalyzer(Analyzer *analyzer) {
   desc_.Merge(analyzer->desc());
 }
 
+opcode_type Loader::GetAtomicOpcode(LogEntry *e, Inst *inst) {
+  // old traces only record the opcode name
+  opcode_type opcode = e->arg(1);
+  if (opcode == INVALID_OPCODE)
+    opcode = inst->opcode();
+  if (!*OpcodeName(opcode))
+    RegisterOpcodeName(opcode, e->str_arg(0));
+  return opcode;
+}
+
 void Loader::HandleEvent(LogEntry *e) {
   switch (e->type()) {
     case LOG_ENTRY_PROGRAM_START:
@@ -370,10 +380,10 @@ void Loader::HandleBeforeAtomicInst(LogEntry *e) {
   timestamp_t curr_thd_clk = e->thd_clk();
   Inst *inst = sinfo_->FindInst(e->inst_id());
   DEBUG_ASSERT(inst);
-  std::string type = e->str_arg(0);
   address_t addr = e->arg(0);
+  opcode_type opcode = GetAtomicOpcode(e, inst);
   CALL_ANALYSIS_FUNC2(AtomicInst, BeforeAtomicInst, self, curr_thd_clk,
-                      inst, type, addr);
+                      inst, opcode, addr);
 }
 
 void Loader::HandleAfterAtomicInst(LogEntry *e) {
@@ -381,10 +391,10 @@ void Loader::HandleAfterAtomicInst(LogEntry *e) {
   timestamp_t curr_thd_clk = e->thd_clk();
   Inst *inst = sinfo_->FindInst(e->inst_id());
   DEBUG_ASSERT(inst);
-  std::string type = e->str_arg(0);
   address_t addr = e->arg(0);
+  opcode_type opcode = GetAtomicOpcode(e, inst);
   CALL_ANALYSIS_FUNC2(AtomicInst, AfterAtomicInst, self, curr_thd_clk,
-                      inst, type, addr);
+                      inst, opcode, addr);
 }
 
 void Loader::HandleBeforePthreadCreate(LogEntry *e) {
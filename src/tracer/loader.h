@@ -97,6 +97,7 @@ class Loader : public OfflineTool {
   void EventLoop();
   void HandleEvent(LogEntry *e);
   void AddAnalyzer(Analyzer *analyzer);
+  opcode_type GetAtomicOpcode(LogEntry *e, Inst *inst);
 
   TraceLog *trace_log_;
   AnalyzerContainer analyzers_;
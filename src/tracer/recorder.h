@@ -188,7 +188,7 @@ class RecorderAnalyzer : public Analyzer {
   }
 
   void BeforeAtomicInst(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
-                        Inst *inst, std::string type, address_t addr) {
+                        Inst *inst, opcode_type opcode, address_t addr) {
     ScopedLock locker(internal_lock_);
     LogEntry entry = trace_log_->NewEntry();
     entry.set_type(LOG_ENTRY_BEFORE_ATOMIC_INST);
@@ -196,11 +196,14 @@ class RecorderAnalyzer : public Analyzer {
     entry.set_thd_clk(curr_thd_clk);
     entry.set_inst_id(inst->id());
     entry.add_arg(addr);
-    entry.add_str_arg(type);
+    entry.add_arg(opcode);
+    // the opcode name is needed to interpret the opcode offline
+    std::string name = OpcodeName(opcode);
+    entry.add_str_arg(name);
   }
 
   void AfterAtomicInst(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
-                       Inst *inst, std::string type, address_t addr) {
+                       Inst *inst, opcode_type opcode, address_t addr) {
     ScopedLock locker(internal_lock_);
     LogEntry entry = trace_log_->NewEntry();
     entry.set_type(LOG_ENTRY_AFTER_ATOMIC_INST);
@@ -208,7 +211,10 @@ class RecorderAnalyzer : public Analyzer {
     entry.set_thd_clk(curr_thd_clk);
     entry.set_inst_id(inst->id());
     entry.add_arg(addr);
-    entry.add_str_arg(type);
+    entry.add_arg(opcode);
+    // the opcode name is needed to interpret the opcode offline
+    std::string name = OpcodeName(opcode);
+    entry.add_str_arg(name);
   }
 
   void BeforePthreadCreate(thread_id_t curr_thd_id, timestamp_t curr_thd_clk,
@@ -0,0 +1,66 @@
+"""Copyright 2011 The University of Michigan
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Authors - Jie Yu (jieyu@umich.edu)
+"""
+
+from maple.core import logging
+from maple.core import static_info
+from maple.race import race
+from maple.regression import common
+
+"""
+Expected Results (static races)
+-------------------------------
+Static Race 0
+	e0: WRITE   [racy.cc +25]
+	e1: READ    [racy.cc +25]
+Static Race 1
+	e0: WRITE   [racy.cc +25]
+	e1: WRITE   [racy.cc +25]
+"""
+
+def source_name():
+    return __name__ + common.cxx_ext()
+
+def race_is_expected(r):
+    has_write = False
+    for idx in range(r.num_events()):
+        e = r.event(idx)
+        if e.inst().debug_info() != source_name() + ' +25':
+            return False
+        if e.type_name() == 'WRITE':
+            has_write = True
+    return has_write
+
+def setup_profiler(profiler):
+    profiler.knobs['ignore_lib'] = True
+
+def setup_testcase(testcase):
+    testcase.threshold = 1
+
+def verify(profiler, testcase):
+    sinfo = static_info.StaticInfo()
+    sinfo.load(profiler.knobs['sinfo_out'])
+    race_db = race.RaceDB(sinfo)
+    race_db.load(profiler.knobs['race_out'])
+    if race_db.num_static_races() == 0:
+        logging.msg('no static race reported\n')
+        return False
+    for r in race_db.static_race_map.itervalues():
+        if not race_is_expected(r):
+            logging.msg('static race mismatch\n')
+            return False
+    return True
+